@@ -0,0 +1,46 @@
+% json_benchmark_arena (n)
+%
+%   Measure the time of many jsondecode calls on small and medium sized
+%   documents, and how often they needed memory beyond the arena that
+%   jsondecode keeps between calls.
+%
+%   `n` is the number of calls per test case, default 1e4.
+%
+% Returned is a Mx4 cell array, where each row contains:
+%
+%    test case name, time per call in microseconds, number of calls,
+%    number of calls that allocated memory beyond the arena ("spills")
+%
+% After the first call of a test case, the arena has grown to the size of
+% the document, so the number of spills should stay at one or zero.
+%
+
+% Copyright (C) 2021 The Octave Project Developers
+
+function result = json_benchmark_arena (n)
+
+  if (nargin < 1)
+    n = 1e4;
+  end
+
+  cases = { ...
+    'small object',  '{"id":1,"name":"abc","tags":["x","y"],"ok":true}'; ...
+    'medium array',  jsonencode (struct ('a', num2cell (1:1000), 'b', 'x')); ...
+    'large array',   jsonencode (rand (1, 1e5))};
+
+  result = cell (size (cases, 1), 4);
+  for i = 1:size (cases, 1)
+    __jsondecode_arena__ ('clear');
+    before = __jsondecode_arena__ ();
+    tic ();
+      for k = 1:n
+        jsondecode (cases{i,2});
+      end
+    t = toc ();
+    after = __jsondecode_arena__ ();
+    result(i,:) = {cases{i,1}, t / n * 1e6, after.calls - before.calls, ...
+                   after.spills - before.spills};
+    fprintf ('%15s  %10.2f us/call  calls: %d  spills: %d\n', result{i,:});
+  end
+
+end
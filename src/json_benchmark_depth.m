@@ -0,0 +1,55 @@
+% json_benchmark_depth (depths)
+%
+%   Decode and encode pathologically deep JSON text.
+%
+%   `depths` is a vector of nesting depths, default [1e2, 1e3, 1e4, 1e5].
+%
+% Returned is a Mx4 cell array, where each row contains:
+%
+%    test case name, nesting depth, time jsondecode, time jsonencode
+%
+% Both jsondecode and jsonencode use explicit stacks on the heap, so the
+% time should grow linearly with the depth.  Note that freeing the deeply
+% nested Octave values is done recursively by Octave itself.
+%
+
+% Copyright (C) 2021 The Octave Project Developers
+
+% This file is intentionally Matlab compatible.
+
+function result = json_benchmark_depth (depths)
+
+  if (nargin < 1)
+    depths = [1e2, 1e3, 1e4, 1e5];
+  end
+
+  % Nested objects decode into nested structs, nested mixed arrays into
+  % nested cell arrays.
+  cases = { ...
+    'objects', '{"a":', '}'; ...
+    'arrays',  '["x",', ']'};
+
+  result = cell (size (cases, 1) * numel (depths), 4);
+  row = 0;
+  for i = 1:size (cases, 1)
+    for n = depths
+      row = row + 1;
+      json_str = [repmat(cases{i,2}, 1, n), '1', repmat(cases{i,3}, 1, n)];
+      result{row,1} = cases{i,1};
+      result{row,2} = n;
+      fprintf ('%10s %8d ', cases{i,1}, n)
+      tic ();
+        octave_obj = jsondecode (json_str);
+      result{row,3} = toc ();
+      fprintf (' jsondecode: %f ', result{row,3});
+      tic ();
+        json_str2 = jsonencode (octave_obj);
+      result{row,4} = toc ();
+      fprintf (' jsonencode: %f\n', result{row,4});
+      if (~ strcmp (json_str, json_str2))
+        error ('json_benchmark_depth: round trip failed at depth %d', n);
+      end
+    end
+  end
+
+end
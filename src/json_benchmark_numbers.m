@@ -0,0 +1,44 @@
+% json_benchmark_numbers (n)
+%
+%   Compare the "NumberParsing" modes of jsondecode on JSON text with `n`
+%   random numbers (default 1e6) of different kinds.
+%
+% Returned is a Mx5 cell array, where each row contains:
+%
+%    test case name, size of the JSON text in MB,
+%    throughput in MB/s for "fast", "exact", and "raw"
+%
+% "exact" only costs extra time for numbers with many significant digits,
+% where the fast path of RapidJSON cannot guarantee correct rounding.
+%
+
+% Copyright (C) 2021 The Octave Project Developers
+
+function result = json_benchmark_numbers (n)
+
+  if (nargin < 1)
+    n = 1e6;
+  end
+
+  result = { ...
+    'integers',       jsonencode (randi (1e6, 1, n)); ...
+    'short decimals', jsonencode (round (rand (1, n) * 1e4) / 100); ...
+    'full doubles',   sprintf ('[%s]', strjoin (cellstr (num2str ( ...
+                                 rand (n, 1), '%.17g')), ','))};
+
+  modes = {'fast', 'exact', 'raw'};
+  for i = 1:size (result, 1)
+    json_str = result{i,2};
+    mbytes = numel (json_str) / 2^20;
+    result{i,2} = mbytes;
+    fprintf ('%15s %6.1f MB ', result{i,1}, mbytes)
+    for j = 1:numel (modes)
+      tic ();
+        jsondecode (json_str, 'NumberParsing', modes{j});
+      result{i,2+j} = mbytes / toc ();
+      fprintf (' %s: %7.1f MB/s', modes{j}, result{i,2+j});
+    end
+    fprintf ('\n');
+  end
+
+end
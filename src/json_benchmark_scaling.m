@@ -0,0 +1,87 @@
+% json_benchmark_scaling (n)
+%
+%   Check that jsondecode and jsonencode scale near-linearly on pathological
+%   input shapes.
+%
+%   `n` is the smallest input size, default 1e4.  Each case is run for the
+%   sizes n, 2*n, 4*n, and 8*n.
+%
+% Returned is a Mx5 cell array, where each row contains:
+%
+%    test case name, input size, time jsondecode, time jsonencode,
+%    bytes of the decoded value
+%
+% For every case, the growth exponent `log (t(8*n) / t(n)) / log (8)` of the
+% times and of the memory of the decoded value is computed.  An error is
+% raised if an exponent exceeds the limit, as super-linear behavior has
+% crept in.  Times are the minimum of three runs to reduce noise.  Cases
+% that run faster than 10 ms at the largest size are not checked.
+%
+
+% Copyright (C) 2021 The Octave Project Developers
+
+function result = json_benchmark_scaling (n)
+
+  if (nargin < 1)
+    n = 1e4;
+  end
+
+  max_time_exponent = 1.3;
+  max_memory_exponent = 1.1;
+
+  % Each case returns JSON text of size k and the jsondecode options.
+  cases = { ...
+    'wide object',    @(k) wide_object (k), {}; ...
+    'long key',       @(k) ['{"', repmat('a-', 1, k), '":1}'], ...
+                        {'ReplacementStyle', 'hex'}; ...
+    'deep nesting',   @(k) [repmat('{"a":', 1, k), '1', repmat('}', 1, k)], {}; ...
+    'tiny arrays',    @(k) ['[', strjoin(repmat ({'[1,2]'}, 1, k), ','), ']'], {}; ...
+    'object array',   @(k) ['[', strjoin(repmat ({'{"a":1,"b":"x"}'}, 1, k), ','), ']'], {}; ...
+    'mixed objects',  @(k) ['[', strjoin(repmat ({'{"a":1}', '{"b":2}'}, 1, k/2), ','), ']'], {}; ...
+    'N-D array',      @(k) jsonencode (reshape (1:8*k, 2, 2, 2, k)), {}};
+
+  sizes = n * [1, 2, 4, 8];
+  result = cell (size (cases, 1) * numel (sizes), 5);
+  row = 0;
+  for i = 1:size (cases, 1)
+    times = zeros (numel (sizes), 2);
+    bytes = zeros (numel (sizes), 1);
+    for j = 1:numel (sizes)
+      json_str = cases{i,2}(sizes(j));
+      times(j,:) = Inf;
+      for r = 1:3
+        tic ();
+          octave_obj = jsondecode (json_str, cases{i,3}{:});
+        times(j,1) = min (times(j,1), toc ());
+        tic ();
+          jsonencode (octave_obj);
+        times(j,2) = min (times(j,2), toc ());
+      end
+      info = whos ('octave_obj');
+      bytes(j) = info.bytes;
+      row = row + 1;
+      result(row,:) = {cases{i,1}, sizes(j), times(j,1), times(j,2), bytes(j)};
+      fprintf ('%15s %8d  jsondecode: %f  jsonencode: %f  bytes: %d\n', ...
+               result{row,:});
+    end
+
+    exponent = @(v) log (v(end) / v(1)) / log (sizes(end) / sizes(1));
+    names = {'jsondecode', 'jsonencode'};
+    for k = 1:2
+      if (times(end,k) > 0.01 && exponent (times(:,k)) > max_time_exponent)
+        error ('json_benchmark_scaling: %s of "%s" grows with exponent %.2f', ...
+               names{k}, cases{i,1}, exponent (times(:,k)));
+      end
+    end
+    if (bytes(1) > 0 && exponent (bytes) > max_memory_exponent)
+      error ('json_benchmark_scaling: memory of "%s" grows with exponent %.2f', ...
+             cases{i,1}, exponent (bytes));
+    end
+  end
+
+end
+
+function json_str = wide_object (k)
+  keys = strsplit (sprintf ('"k%d":1,', 1:k), ',');
+  json_str = ['{', strjoin(keys(1:end-1), ','), '}'];
+end
@@ -0,0 +1,533 @@
+////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2021 The Octave Project Developers
+//
+// See the file COPYRIGHT.md in the top-level directory of this
+// distribution or <https://octave.org/copyright/>.
+//
+// This file is part of Octave.
+//
+// Octave is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Octave is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Octave; see the file COPYING.  If not, see
+// <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////
+
+#ifndef JSON_STREAM_H__
+#define JSON_STREAM_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+#if defined (HAVE_ZSTD)
+#  include <zstd.h>
+#endif
+
+// The streams of this file do not call into Octave, so that they can be
+// used by worker threads.  Errors are kept as messages for the caller.
+// zstd is optional (HAVE_ZSTD, see the Makefile), without it zstd files
+// fail with an error.
+
+//! Compression of a JSON file.
+
+enum class json_compression
+{
+  none,
+  gzip,
+  zstd
+};
+
+//! Chooses the compression of a file by the extension of its name.
+//!
+//! @param filename name of the file.
+//!
+//! @return @c gzip for ".gz", @c zstd for ".zst", otherwise @c none.
+
+inline json_compression
+compression_by_extension (const std::string& filename)
+{
+  auto ends_with = [&filename] (const char *ext)
+  {
+    std::size_t n = std::strlen (ext);
+    return filename.size () > n
+           && filename.compare (filename.size () - n, n, ext) == 0;
+  };
+
+  if (ends_with (".gz"))
+    return json_compression::gzip;
+  if (ends_with (".zst"))
+    return json_compression::zstd;
+  return json_compression::none;
+}
+
+//! Sets the position of a file, also beyond 2 GiB.
+//!
+//! @param file open file.
+//! @param offset byte offset from the start of @p file.
+//!
+//! @return @c true on success.
+
+inline bool
+seek_file (std::FILE *file, uint64_t offset)
+{
+#if defined (_WIN32)
+  return _fseeki64 (file, offset, SEEK_SET) == 0;
+#else
+  return fseeko (file, offset, SEEK_SET) == 0;
+#endif
+}
+
+//! Determines the size of a file, also beyond 2 GiB.
+//!
+//! The position of @p file is moved to its end.
+//!
+//! @param file open file.
+//! @param[out] size number of bytes of @p file.
+//!
+//! @return @c true on success.
+
+inline bool
+file_size (std::FILE *file, uint64_t& size)
+{
+#if defined (_WIN32)
+  if (_fseeki64 (file, 0, SEEK_END) != 0)
+    return false;
+  auto pos = _ftelli64 (file);
+#else
+  if (fseeko (file, 0, SEEK_END) != 0)
+    return false;
+  auto pos = ftello (file);
+#endif
+  if (pos < 0)
+    return false;
+  size = pos;
+  return true;
+}
+
+//! RapidJSON input stream of a plain, gzip, or zstd compressed file.
+//!
+//! The compression is detected by the magic bytes of the file.  The text is
+//! decompressed chunk by chunk while the parser reads it, the whole text is
+//! never held in memory.  After an error, the stream ends and
+//! @ref error returns a message.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! json_file_reader file ("data.json.gz");
+//! rapidjson::Document d;
+//! d.ParseStream (file);
+//! @endcode
+
+class json_file_reader
+{
+public:
+
+  typedef char Ch;
+
+  explicit json_file_reader (const std::string& filename)
+    : m_filename (filename), m_buffer (buffer_size + 1)
+  {
+    open ();
+    read ();
+  }
+
+  // No copying!
+
+  json_file_reader (const json_file_reader&) = delete;
+
+  json_file_reader& operator = (const json_file_reader&) = delete;
+
+  ~json_file_reader (void)
+  {
+    if (m_gz)
+      gzclose (m_gz);
+#if defined (HAVE_ZSTD)
+    if (m_zstd)
+      ZSTD_freeDStream (m_zstd);
+#endif
+    if (m_file)
+      std::fclose (m_file);
+  }
+
+  //! @return empty string, or the message of the first error.
+
+  const std::string& error (void) const { return m_error; }
+
+  Ch Peek (void) const { return *m_current; }
+
+  Ch Take (void)
+  {
+    Ch c = *m_current;
+    if (m_current < m_last)
+      ++m_current;
+    else
+      read ();
+    return c;
+  }
+
+  //! @return number of decompressed bytes taken.
+
+  std::size_t Tell (void) const
+  { return m_count + (m_current - m_buffer.data ()); }
+
+  // Only required for in situ parsing, which is not supported.
+
+  Ch * PutBegin (void) { return nullptr; }
+  void Put (Ch) { }
+  void Flush (void) { }
+  std::size_t PutEnd (Ch *) { return 0; }
+
+private:
+
+  static const std::size_t buffer_size = 65536;
+
+  void open (void)
+  {
+    std::FILE *file = std::fopen (m_filename.c_str (), "rb");
+    if (! file)
+      {
+        fail ("unable to open file");
+        return;
+      }
+
+    unsigned char magic[4] = {0, 0, 0, 0};
+    std::size_t n = std::fread (magic, 1, sizeof (magic), file);
+
+    if (n == 4 && magic[0] == 0x28 && magic[1] == 0xB5 && magic[2] == 0x2F
+        && magic[3] == 0xFD)
+      {
+#if defined (HAVE_ZSTD)
+        std::rewind (file);
+        m_file = file;
+        m_zstd = ZSTD_createDStream ();
+        m_input.resize (ZSTD_DStreamInSize ());
+        m_in = {m_input.data (), 0, 0};
+#else
+        std::fclose (file);
+        fail ("zstd support not compiled in, unable to read");
+#endif
+      }
+    else
+      {
+        // zlib reads plain files as they are.
+        std::fclose (file);
+        m_gz = gzopen (m_filename.c_str (), "rb");
+        if (! m_gz)
+          {
+            fail ("unable to open file");
+            return;
+          }
+        gzbuffer (m_gz, buffer_size);
+      }
+  }
+
+  //! Refills the buffer.  At the end of the input, a null character is
+  //! appended, which RapidJSON takes as the end of the stream.
+
+  void read (void)
+  {
+    char *data = m_buffer.data ();
+    m_count += m_size;
+    m_size = 0;
+
+    if (! m_eof)
+#if defined (HAVE_ZSTD)
+      m_size = m_gz ? read_gzip (data) : read_zstd (data);
+#else
+      m_size = read_gzip (data);
+#endif
+
+    if (m_size < buffer_size)
+      {
+        data[m_size] = '\0';
+        m_eof = true;
+        m_current = data;
+        m_last = data + m_size;
+        ++m_size;
+        return;
+      }
+
+    m_current = data;
+    m_last = data + m_size - 1;
+  }
+
+  std::size_t read_gzip (char *data)
+  {
+    int n = gzread (m_gz, data, buffer_size);
+    if (n < 0)
+      {
+        int errnum;
+        fail (gzerror (m_gz, &errnum));
+        return 0;
+      }
+    return n;
+  }
+
+#if defined (HAVE_ZSTD)
+  std::size_t read_zstd (char *data)
+  {
+    ZSTD_outBuffer out = {data, buffer_size, 0};
+    while (out.pos < out.size)
+      {
+        if (m_in.pos == m_in.size)
+          {
+            m_in.size = std::fread (m_input.data (), 1, m_input.size (),
+                                    m_file);
+            m_in.pos = 0;
+            if (m_in.size == 0)
+              {
+                if (m_frame_open)
+                  fail ("truncated zstd data");
+                break;
+              }
+          }
+
+        std::size_t ret = ZSTD_decompressStream (m_zstd, &out, &m_in);
+        if (ZSTD_isError (ret))
+          {
+            fail (ZSTD_getErrorName (ret));
+            return 0;
+          }
+        m_frame_open = (ret != 0);
+      }
+    return out.pos;
+  }
+#endif
+
+  void fail (const std::string& msg)
+  {
+    if (m_error.empty ())
+      m_error = msg + " '" + m_filename + "'";
+    m_eof = true;
+  }
+
+  std::string m_filename;
+  std::string m_error;
+
+  gzFile m_gz = nullptr;
+
+  std::FILE *m_file = nullptr;
+#if defined (HAVE_ZSTD)
+  ZSTD_DStream *m_zstd = nullptr;
+  std::vector<char> m_input;
+  ZSTD_inBuffer m_in = {nullptr, 0, 0};
+  bool m_frame_open = false;
+#endif
+
+  //! Decompressed text, one byte more for the final null character.
+  std::vector<char> m_buffer;
+  char *m_current = nullptr;
+  char *m_last = nullptr;
+  //! Number of bytes in the buffer.
+  std::size_t m_size = 0;
+  //! Number of bytes of the previous buffers.
+  std::size_t m_count = 0;
+  bool m_eof = false;
+};
+
+//! RapidJSON output stream into a plain, gzip, or zstd compressed file.
+//!
+//! The text is compressed chunk by chunk while the writer produces it, the
+//! whole text is never held in memory.  @ref close must be called after
+//! the last value, errors are reported by it.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! json_file_writer file ("data.json.zst", json_compression::zstd);
+//! rapidjson::Writer<json_file_writer> writer (file);
+//! writer.Bool (true);
+//! bool ok = file.close ();
+//! @endcode
+
+class json_file_writer
+{
+public:
+
+  typedef char Ch;
+
+  json_file_writer (const std::string& filename, json_compression compression)
+    : m_filename (filename)
+  {
+    m_buffer.reserve (buffer_size);
+
+    if (compression == json_compression::gzip)
+      {
+        m_gz = gzopen (filename.c_str (), "wb");
+        if (! m_gz)
+          fail ("unable to open file");
+        else
+          gzbuffer (m_gz, buffer_size);
+        return;
+      }
+
+#if ! defined (HAVE_ZSTD)
+    if (compression == json_compression::zstd)
+      {
+        fail ("zstd support not compiled in, unable to write");
+        return;
+      }
+#endif
+
+    m_file = std::fopen (filename.c_str (), "wb");
+    if (! m_file)
+      fail ("unable to open file");
+#if defined (HAVE_ZSTD)
+    else if (compression == json_compression::zstd)
+      {
+        m_zstd = ZSTD_createCCtx ();
+        m_output.resize (ZSTD_CStreamOutSize ());
+      }
+#endif
+  }
+
+  // No copying!
+
+  json_file_writer (const json_file_writer&) = delete;
+
+  json_file_writer& operator = (const json_file_writer&) = delete;
+
+  ~json_file_writer (void)
+  {
+    close ();
+  }
+
+  void Put (Ch c)
+  {
+    m_buffer.push_back (c);
+    if (m_buffer.size () == buffer_size)
+      write (false);
+  }
+
+  //! Called by RapidJSON's writer after each top-level value.  The data is
+  //! only written when the buffer is full, to keep the compression
+  //! efficient.
+
+  void Flush (void) { }
+
+  //! Writes the remaining data and closes the file.
+  //!
+  //! @return @c true on success, otherwise @ref error returns a message.
+
+  bool close (void)
+  {
+    if (m_closed)
+      return m_error.empty ();
+    m_closed = true;
+
+    write (true);
+
+    if (m_gz && gzclose (m_gz) != Z_OK)
+      fail ("unable to write file");
+#if defined (HAVE_ZSTD)
+    if (m_zstd)
+      ZSTD_freeCCtx (m_zstd);
+    m_zstd = nullptr;
+#endif
+    if (m_file && std::fclose (m_file) != 0)
+      fail ("unable to write file");
+    m_gz = nullptr;
+    m_file = nullptr;
+
+    return m_error.empty ();
+  }
+
+  //! @return empty string, or the message of the first error.
+
+  const std::string& error (void) const { return m_error; }
+
+private:
+
+  static const std::size_t buffer_size = 65536;
+
+  void write (bool last)
+  {
+#if ! defined (HAVE_ZSTD)
+    // Only zstd ends its data differently.
+    (void) last;
+#endif
+
+    if (! m_error.empty ())
+      {
+        m_buffer.clear ();
+        return;
+      }
+
+    if (m_gz)
+      {
+        if (! m_buffer.empty ()
+            && gzwrite (m_gz, m_buffer.data (), m_buffer.size ()) == 0)
+          fail ("unable to write file");
+      }
+#if defined (HAVE_ZSTD)
+    else if (m_zstd)
+      {
+        ZSTD_inBuffer in = {m_buffer.data (), m_buffer.size (), 0};
+        ZSTD_EndDirective mode = last ? ZSTD_e_end : ZSTD_e_continue;
+        std::size_t remaining;
+        do
+          {
+            ZSTD_outBuffer out = {m_output.data (), m_output.size (), 0};
+            remaining = ZSTD_compressStream2 (m_zstd, &out, &in, mode);
+            if (ZSTD_isError (remaining))
+              {
+                fail (ZSTD_getErrorName (remaining));
+                break;
+              }
+            if (std::fwrite (m_output.data (), 1, out.pos, m_file) != out.pos)
+              {
+                fail ("unable to write file");
+                break;
+              }
+          }
+        while (last ? remaining != 0 : in.pos < in.size);
+      }
+#endif
+    else if (m_file)
+      {
+        if (std::fwrite (m_buffer.data (), 1, m_buffer.size (), m_file)
+            != m_buffer.size ())
+          fail ("unable to write file");
+      }
+
+    m_buffer.clear ();
+  }
+
+  void fail (const std::string& msg)
+  {
+    if (m_error.empty ())
+      m_error = msg + " '" + m_filename + "'";
+  }
+
+  std::string m_filename;
+  std::string m_error;
+
+  gzFile m_gz = nullptr;
+
+  std::FILE *m_file = nullptr;
+#if defined (HAVE_ZSTD)
+  ZSTD_CCtx *m_zstd = nullptr;
+  std::vector<char> m_output;
+#endif
+
+  std::vector<char> m_buffer;
+  bool m_closed = false;
+};
+
+#endif
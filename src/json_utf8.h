@@ -0,0 +1,152 @@
+////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2021 The Octave Project Developers
+//
+// See the file COPYRIGHT.md in the top-level directory of this
+// distribution or <https://octave.org/copyright/>.
+//
+// This file is part of Octave.
+//
+// Octave is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Octave is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Octave; see the file COPYING.  If not, see
+// <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////
+
+#ifndef JSON_UTF8_H__
+#define JSON_UTF8_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+//! Counts the leading ASCII characters of a string.
+//!
+//! The bytes are tested eight at a time in a 64-bit word (SWAR), which
+//! compilers turn into very few instructions on every platform.
+//!
+//! @param str string.
+//! @param len number of bytes of @p str.
+//!
+//! @return number of leading bytes of @p str that are below 0x80.
+
+inline std::size_t
+ascii_prefix (const char *str, std::size_t len)
+{
+  std::size_t i = 0;
+  for (; i + 8 <= len; i += 8)
+    {
+      uint64_t word;
+      std::memcpy (&word, str + i, 8);
+      if (word & UINT64_C (0x8080808080808080))
+        break;
+    }
+
+  while (i < len && ! (static_cast<unsigned char> (str[i]) & 0x80))
+    i++;
+
+  return i;
+}
+
+//! Decodes one multi-byte UTF-8 sequence according to RFC 3629.
+//!
+//! Overlong sequences, surrogates, and code points beyond U+10FFFF are
+//! invalid.
+//!
+//! @param str string that starts with a byte of at least 0x80.
+//! @param len number of bytes of @p str.
+//! @param[out] codepoint decoded code point.
+//!
+//! @return length of the sequence, or 0 if it is invalid.
+
+inline std::size_t
+decode_utf8 (const char *str, std::size_t len, uint32_t& codepoint)
+{
+  const unsigned char *s = reinterpret_cast<const unsigned char *> (str);
+
+  // Number of continuation bytes and the valid range of the first of them.
+  std::size_t n;
+  unsigned char lo = 0x80;
+  unsigned char hi = 0xBF;
+  if (s[0] >= 0xC2 && s[0] <= 0xDF)
+    n = 1;
+  else if (s[0] == 0xE0)
+    {
+      n = 2;
+      lo = 0xA0;
+    }
+  else if (s[0] == 0xED)
+    {
+      n = 2;
+      hi = 0x9F;
+    }
+  else if (s[0] >= 0xE1 && s[0] <= 0xEF)
+    n = 2;
+  else if (s[0] == 0xF0)
+    {
+      n = 3;
+      lo = 0x90;
+    }
+  else if (s[0] >= 0xF1 && s[0] <= 0xF3)
+    n = 3;
+  else if (s[0] == 0xF4)
+    {
+      n = 3;
+      hi = 0x8F;
+    }
+  else
+    return 0;
+
+  if (len <= n || s[1] < lo || s[1] > hi)
+    return 0;
+
+  codepoint = s[0] & (0x3F >> n);
+  for (std::size_t k = 1; k <= n; k++)
+    {
+      if ((s[k] & 0xC0) != 0x80)
+        return 0;
+      codepoint = (codepoint << 6) | (s[k] & 0x3F);
+    }
+
+  return n + 1;
+}
+
+//! Finds the first byte of a string that is not part of valid UTF-8.
+//!
+//! Runs of ASCII characters are skipped by @ref ascii_prefix, only the
+//! other characters are decoded one by one.
+//!
+//! @param str string.
+//! @param len number of bytes of @p str.
+//!
+//! @return offset of the first invalid byte, or @p len if @p str is valid.
+
+inline std::size_t
+find_invalid_utf8 (const char *str, std::size_t len)
+{
+  std::size_t i = 0;
+  while (true)
+    {
+      i += ascii_prefix (str + i, len - i);
+      if (i == len)
+        return len;
+
+      uint32_t codepoint;
+      std::size_t n = decode_utf8 (str + i, len - i, codepoint);
+      if (n == 0)
+        return i;
+      i += n;
+    }
+}
+
+#endif
@@ -23,11 +23,34 @@
 //
 ////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <future>
+#include <limits>
+#include <list>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
 #include <octave/oct.h>
+#include <octave/file-ops.h>
+#include <octave/interpreter.h>
+#include <octave/mach-info.h>
+#include <octave/uint64NDArray.h>
+#include <octave/uint8NDArray.h>
 
 // Include some features from Octave 7.
 #include "octave7.h"
 
+#include "json_stream.h"
+#include "json_utf8.h"
+
 #define HAVE_RAPIDJSON 1
 
 #if defined (HAVE_RAPIDJSON)
@@ -37,9 +60,121 @@
 
 #if defined (HAVE_RAPIDJSON)
 
+//! Decoded string values by their text, see @c "InternStrings".
+
+typedef std::unordered_map<std::string, octave_value> string_table;
+
+struct object_layout;
+
+//! Cache of object layouts by their ordered key set.
+//!
+//! Objects with the same ordered key set share one @c octave_fields
+//! instance.  This saves the field table of each object and the
+//! @c matlab.lang.makeValidName calls for each key.
+
+typedef std::unordered_map<std::string, object_layout> layout_cache;
+
+//! CBOR typed array (RFC 8746) whose elements are decoded straight from
+//! its payload in the input, see @ref decode_typed_array.
+
+struct typed_array
+{
+  //! First byte of the payload.
+  const uint8_t *bytes;
+
+  //! Number of elements.
+  std::size_t numel;
+
+  //! Tag of the typed array, which encodes the type of its elements.
+  uint8_t tag;
+};
+
+//! Typed arrays by the address of their payload.  The reader emits a
+//! string that points to the payload for each of them, see
+//! @ref cbor_reader.
+
+typedef std::unordered_map<const char *, typed_array> typed_array_table;
+
+//! Merging of arrays of objects into struct arrays (@c "MergeObjects"
+//! option).
+
+enum class object_merge
+{
+  ordered,    // objects with the same keys in the same order
+  unordered,  // objects with the same keys in any order
+  fill        // all objects, missing keys are filled with []
+};
+
+//! Options of a jsondecode call that affect the decode functions.
+
+struct decode_options
+{
+  //! Options for @c matlab.lang.makeValidName, @c nullptr if object keys
+  //! are used verbatim as field names.
+  const octave::make_valid_name_options *make_valid_name = nullptr;
+
+  //! Decode objects written with @c "NumericEncoding" @c "base64" into
+  //! numeric arrays.
+  bool base64_arrays = false;
+
+  //! Decode objects written with @c "SparseEncoding" @c "compact" into
+  //! sparse matrices.
+  bool compact_sparse = false;
+
+  //! Decode arrays of objects into a scalar struct of columns
+  //! (@c "ArrayOfObjects" @c "columns").
+  bool object_columns = false;
+
+  //! Objects of an array that are merged into a struct array.
+  object_merge merge = object_merge::ordered;
+
+  //! Table of the string values decoded so far, @c nullptr if every string
+  //! value is decoded into a new char array.
+  string_table *strings = nullptr;
+
+  //! Object layouts shared by several calls of @ref decode, @c nullptr if
+  //! each call uses its own.
+  layout_cache *layouts = nullptr;
+
+  //! Typed arrays of CBOR input that are decoded from their payload,
+  //! @c nullptr if all typed arrays are arrays of numbers in the DOM.
+  const typed_array_table *typed_arrays = nullptr;
+};
+
 octave_value
-decode (const rapidjson::Value& val,
-        const octave::make_valid_name_options* options);
+decode (const rapidjson::Value& val, const decode_options& options);
+
+//! Decodes a JSON string into a char array.
+//!
+//! With @c "InternStrings", identical strings share the same
+//! @ref octave_value.  Copy-on-write makes this invisible to the user.
+//!
+//! @param val JSON value that is guaranteed to be a string.
+//! @param options @ref decode_options of this jsondecode call.
+//!
+//! @return @ref octave_value that contains the char array of @p val.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! rapidjson::Document d;
+//! d.Parse ("\"abc\"");
+//! octave_value str = decode_string (d, decode_options ());
+//! @endcode
+
+octave_value
+decode_string (const rapidjson::Value& val, const decode_options& options)
+{
+  if (options.strings == nullptr)
+    return val.GetString ();
+
+  std::string key (val.GetString (), val.GetStringLength ());
+  auto it = options.strings->find (key);
+  if (it == options.strings->end ())
+    it = options.strings->emplace (std::move (key),
+                                   octave_value (val.GetString ())).first;
+  return it->second;
+}
 
 //! Decodes a numerical JSON value into a scalar number.
 //!
@@ -58,175 +193,686 @@ decode (const rapidjson::Value& val,
 octave_value
 decode_number (const rapidjson::Value& val)
 {
-  if (val.IsUint ())
-    return octave_value (val.GetUint ());
-  else if (val.IsInt ())
-    return octave_value (val.GetInt ());
-  else if (val.IsUint64 ())
-    return octave_value (val.GetUint64 ());
-  else if (val.IsInt64 ())
-    return octave_value (val.GetInt64 ());
-  else if (val.IsDouble ())
-    return octave_value (val.GetDouble ());
-  else
-    error ("jsondecode: unidentified type");
+  // All JSON numbers are decoded into doubles.  GetDouble converts any
+  // integer representation of RapidJSON directly.
+  return octave_value (val.GetDouble ());
 }
 
-//! Decodes a JSON object into a scalar struct.
+//! Flag bit of invalid characters in the base64 lookup table.
+
+const uint8_t base64_invalid = 0x80;
+
+//! Lookup table from base64 characters to their 6-bit values.  Invalid
+//! characters are marked by the flag bit @c base64_invalid.
+
+struct base64_lookup
+{
+  base64_lookup (void)
+  {
+    const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                            "abcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::fill (table, table + 256, base64_invalid);
+    for (uint8_t i = 0; i < 64; ++i)
+      table[static_cast<uint8_t> (alphabet[i])] = i;
+  }
+
+  uint8_t table[256];
+};
+
+//! @return the base64 lookup table, initialized on first use.
+
+const uint8_t *
+base64_table (void)
+{
+  static const base64_lookup lookup;
+  return lookup.table;
+}
+
+//! @return number of bytes encoded by the base64 text @p in, or zero if
+//! its length is not a multiple of four.
+
+std::size_t
+base64_decoded_size (const char *in, std::size_t len)
+{
+  if (len % 4)
+    return 0;
+  std::size_t size = len / 4 * 3;
+  if (len > 0 && in[len-1] == '=')
+    size--;
+  if (len > 1 && in[len-2] == '=')
+    size--;
+  return size;
+}
+
+//! Decodes base64 (RFC 4648) text with padding.
+//!
+//! Eight characters are combined into one 64-bit word and stored as six
+//! bytes per iteration.  Invalid characters are detected by accumulating
+//! the flag bits of the whole word, so the loop has a single branch.
+//!
+//! @param in base64 text.
+//! @param len number of characters of @p in.
+//! @param out buffer of @c base64_decoded_size (in, len) bytes.
+//!
+//! @return @c false if @p in is not valid base64.
+
+bool
+base64_decode (const char *in, std::size_t len, uint8_t *out)
+{
+  if (len % 4)
+    return false;
+
+  const uint8_t *table = base64_table ();
+  const uint8_t *src = reinterpret_cast<const uint8_t *> (in);
+
+  // The last quantum may contain padding and is decoded separately.
+  std::size_t body = (len >= 4 ? len - 4 : 0);
+  std::size_t i = 0;
+  for (; i + 8 <= body; i += 8)
+    {
+      uint64_t word = 0;
+      uint8_t flags = 0;
+      for (int k = 0; k < 8; ++k)
+        {
+          uint8_t v = table[src[i+k]];
+          flags |= v;
+          word = (word << 6) | v;
+        }
+      if (flags & base64_invalid)
+        return false;
+      for (int k = 0; k < 6; ++k)
+        *out++ = static_cast<uint8_t> (word >> (40 - 8 * k));
+    }
+
+  for (; i < len; i += 4)
+    {
+      int pad = 0;
+      if (i + 4 == len)
+        pad = (src[len-1] == '=') + (src[len-1] == '=' && src[len-2] == '=');
+
+      uint32_t word = 0;
+      uint8_t flags = 0;
+      for (int k = 0; k < 4; ++k)
+        {
+          uint8_t v = (k < 4 - pad) ? table[src[i+k]] : 0;
+          flags |= v;
+          word = (word << 6) | v;
+        }
+      if (flags & base64_invalid)
+        return false;
+      for (int k = 0; k < 3 - pad; ++k)
+        *out++ = static_cast<uint8_t> (word >> (16 - 8 * k));
+    }
+
+  return true;
+}
+
+//! Checks if a JSON object has been written by jsonencode with
+//! @c "NumericEncoding" @c "base64", i.e. if it has exactly the keys
+//! @c dtype, @c shape, and @c data.
 //!
 //! @param val JSON value that is guaranteed to be a JSON object.
-//! @param options @c ReplacementStyle and @c Prefix options with their values.
+
+bool
+is_base64_array (const rapidjson::Value& val)
+{
+  return (val.MemberCount () == 3 && val.HasMember ("dtype")
+          && val.HasMember ("shape") && val.HasMember ("data"));
+}
+
+//! Copies @p nbytes little-endian bytes into the elements of an array.
+
+template <typename T> octave_value
+base64_array (const dim_vector& dims, const char *data, std::size_t len)
+{
+  // "shape" is not trusted: check it against the length of "data" before
+  // anything is allocated.
+  std::size_t elem_size = sizeof (typename T::element_type);
+  std::size_t nbytes = elem_size;
+  for (int i = 0; i < dims.ndims (); ++i)
+    {
+      std::size_t dim = dims(i);
+      if (dim != 0 && nbytes > std::numeric_limits<std::size_t>::max () / dim)
+        error ("jsondecode: base64 array: size of \"data\" does not match "
+               "\"shape\"");
+      nbytes *= dim;
+    }
+  if (base64_decoded_size (data, len) != nbytes)
+    error ("jsondecode: base64 array: size of \"data\" does not match "
+           "\"shape\"");
+
+  T retval (dims);
+  uint8_t *bytes = reinterpret_cast<uint8_t *> (retval.fortran_vec ());
+  if (! base64_decode (data, len, bytes))
+    error ("jsondecode: base64 array: invalid base64 \"data\"");
+
+  static const bool big_endian = octave::mach_info::words_big_endian ();
+  if (big_endian && elem_size > 1)
+    for (std::size_t i = 0; i < nbytes; i += elem_size)
+      std::reverse (bytes + i, bytes + i + elem_size);
+
+  return retval;
+}
+
+//! Decodes a base64 encoded numeric array into an N-D array of its
+//! original class.
 //!
-//! @return @ref octave_value that contains the equivalent scalar struct of @p val.
+//! @param val JSON value that is guaranteed to pass @ref is_base64_array.
+//!
+//! @return @ref octave_value that contains the decoded array.
 //!
 //! @b Example:
 //!
 //! @code{.cc}
 //! rapidjson::Document d;
-//! d.Parse ("{\"a\": 1, \"b\": 2}");
-//! octave_value struct = decode_object (d, octave_value_list ());
+//! d.Parse ("{\"dtype\":\"uint8\",\"shape\":[1,3],\"data\":\"AQID\"}");
+//! octave_value array = decode_base64_array (d);
 //! @endcode
 
 octave_value
-decode_object (const rapidjson::Value& val,
-               const octave::make_valid_name_options* options)
+decode_base64_array (const rapidjson::Value& val)
 {
-  octave_scalar_map retval;
+  const rapidjson::Value& dtype = val["dtype"];
+  const rapidjson::Value& shape = val["shape"];
+  const rapidjson::Value& data = val["data"];
 
-  for (const auto& pair : val.GetObject ())
-  {
-    // Validator function "matlab.lang.makeValidName" to guarantee legitimate
-    // variable name.
-    std::string varname = pair.name.GetString ();
-    if (options != nullptr)
-      octave::make_valid_name (varname, *options);
-    retval.assign (varname, decode (pair.value, options));
-  }
+  if (! dtype.IsString () || ! shape.IsArray () || ! data.IsString ())
+    error ("jsondecode: base64 array: \"dtype\" and \"data\" must be strings "
+           "and \"shape\" an array");
+
+  const uint64_t dim_max = std::numeric_limits<octave_idx_type>::max ();
+  dim_vector dims (1, 1);
+  dims.resize (std::max (2u, shape.Size ()), 1);
+  for (rapidjson::SizeType i = 0; i < shape.Size (); ++i)
+    {
+      if (! shape[i].IsUint64 () || shape[i].GetUint64 () > dim_max)
+        error ("jsondecode: base64 array: \"shape\" must contain "
+               "non-negative integers");
+      dims(i) = shape[i].GetUint64 ();
+    }
+
+  std::string type = dtype.GetString ();
+  const char *str = data.GetString ();
+  std::size_t len = data.GetStringLength ();
+
+  if (type == "float64")
+    return base64_array<NDArray> (dims, str, len);
+  else if (type == "float32")
+    return base64_array<FloatNDArray> (dims, str, len);
+  else if (type == "int8")
+    return base64_array<int8NDArray> (dims, str, len);
+  else if (type == "int16")
+    return base64_array<int16NDArray> (dims, str, len);
+  else if (type == "int32")
+    return base64_array<int32NDArray> (dims, str, len);
+  else if (type == "int64")
+    return base64_array<int64NDArray> (dims, str, len);
+  else if (type == "uint8")
+    return base64_array<uint8NDArray> (dims, str, len);
+  else if (type == "uint16")
+    return base64_array<uint16NDArray> (dims, str, len);
+  else if (type == "uint32")
+    return base64_array<uint32NDArray> (dims, str, len);
+  else if (type == "uint64")
+    return base64_array<uint64NDArray> (dims, str, len);
+  else if (type == "bool")
+    return base64_array<boolNDArray> (dims, str, len);
+  else
+    error ("jsondecode: base64 array: unknown \"dtype\" '%s'", type.c_str ());
+}
+
+//! Converts an IEEE 754 half-precision float, see RFC 8949, Appendix D.
+
+double
+half_to_double (uint16_t half)
+{
+  int exp = (half >> 10) & 0x1f;
+  int mant = half & 0x3ff;
+  double val;
+  if (exp == 0)
+    val = std::ldexp (mant, -24);
+  else if (exp != 31)
+    val = std::ldexp (mant + 1024, exp - 25);
+  else
+    val = (mant == 0 ? octave_Inf : octave_NaN);
+  return (half & 0x8000) ? -val : val;
+}
+
+//! @return the typed array that @p val stands for, or @c nullptr if
+//! @p val is no such string.
+
+const typed_array *
+find_typed_array (const rapidjson::Value& val, const decode_options& options)
+{
+  if (! options.typed_arrays || ! val.IsString ())
+    return nullptr;
+
+  auto it = options.typed_arrays->find (val.GetString ());
+  return (it == options.typed_arrays->end () ? nullptr : &it->second);
+}
+
+//! @return type of @p val, where typed arrays count as arrays.
+
+rapidjson::Type
+element_type (const rapidjson::Value& val, const decode_options& options)
+{
+  return (find_typed_array (val, options) ? rapidjson::kArrayType
+                                          : val.GetType ());
+}
+
+//! Decodes a CBOR typed array into a column vector, like the equivalent
+//! array of numbers.
+//!
+//! The payload of float64 arrays is copied with a single @c memcpy and
+//! byte-swapped in place if its byte order differs from this machine.
+//! All other elements are assembled byte by byte.
+//!
+//! @param array typed array, see @ref typed_array.
+//!
+//! @return @ref octave_value that contains the NDArray of the elements.
+
+octave_value
+decode_typed_array (const typed_array& array)
+{
+  // The tag encodes (RFC 8746, Section 2.1) whether the elements are
+  // floats (f), signed (s), little endian (e), and their size (ll).
+  bool is_float = array.tag & 0x10;
+  bool is_signed = array.tag & 0x08;
+  int ll = array.tag & 0x03;
+  // For 8-bit integers the e bit means "clamped", not the byte order.
+  bool little_endian = (array.tag & 0x04) && (is_float || ll > 0);
+  std::size_t elem_size = is_float ? (2 << ll) : (1 << ll);
+
+  static const bool big_endian = octave::mach_info::words_big_endian ();
+
+  NDArray retval (dim_vector (array.numel, 1));
+  double *data = retval.fortran_vec ();
+
+  if (is_float && elem_size == sizeof (double))
+    {
+      std::memcpy (data, array.bytes, array.numel * sizeof (double));
+      if (little_endian == big_endian)
+        {
+          uint8_t *bytes = reinterpret_cast<uint8_t *> (data);
+          for (std::size_t i = 0; i < array.numel; ++i)
+            std::reverse (bytes + i * sizeof (double),
+                          bytes + (i + 1) * sizeof (double));
+        }
+      return retval;
+    }
+
+  for (std::size_t i = 0; i < array.numel; ++i)
+    {
+      const uint8_t *elem = array.bytes + i * elem_size;
+      uint64_t bits = 0;
+      for (std::size_t k = 0; k < elem_size; ++k)
+        bits = (bits << 8) | elem[little_endian ? elem_size - 1 - k : k];
+
+      if (is_float && elem_size == 2)
+        data[i] = half_to_double (bits);
+      else if (is_float)
+        {
+          uint32_t bits32 = bits;
+          float f;
+          std::memcpy (&f, &bits32, sizeof (f));
+          data[i] = f;
+        }
+      else if (is_signed)
+        {
+          // Sign-extend the element to 64 bits.
+          int shift = 64 - 8 * elem_size;
+          data[i] = static_cast<int64_t> (bits << shift) >> shift;
+        }
+      else
+        data[i] = bits;
+    }
 
   return retval;
 }
 
-//! Decodes a JSON array that contains only numerical or null values
-//! into an NDArray.
+//! Checks if a JSON object has been written by jsonencode with
+//! @c "SparseEncoding" @c "compact", i.e. if it has exactly the keys
+//! @c sparse (with value @c true), @c size, @c i, @c j, and @c v.
+//!
+//! @param val JSON value that is guaranteed to be a JSON object.
+
+bool
+is_sparse_object (const rapidjson::Value& val)
+{
+  if (val.MemberCount () != 5 || ! val.HasMember ("sparse")
+      || ! val.HasMember ("size") || ! val.HasMember ("i")
+      || ! val.HasMember ("j") || ! val.HasMember ("v"))
+    return false;
+
+  const rapidjson::Value& sparse = val["sparse"];
+  return sparse.IsBool () && sparse.GetBool ();
+}
+
+//! Decodes a compact sparse matrix object into a sparse matrix.
+//!
+//! The one-based indices and the values are passed to @c sparse, which
+//! also checks the indices and sums up duplicate elements.  The matrix is
+//! logical if all values are booleans.
 //!
-//! @param val JSON value that is guaranteed to be a numeric array.
+//! @param val JSON value that is guaranteed to pass @ref is_sparse_object.
 //!
-//! @return @ref octave_value that contains the equivalent NDArray of @p val.
+//! @return @ref octave_value that contains the sparse matrix.
 //!
 //! @b Example:
 //!
 //! @code{.cc}
 //! rapidjson::Document d;
-//! d.Parse ("[1, 2, 3, 4]");
-//! octave_value numeric_array = decode_numeric_array (d);
+//! d.Parse ("{\"sparse\":true,\"size\":[2,2],\"i\":[2],\"j\":[1],\"v\":[3]}");
+//! octave_value sm = decode_sparse (d);
 //! @endcode
 
 octave_value
-decode_numeric_array (const rapidjson::Value& val)
+decode_sparse (const rapidjson::Value& val)
 {
-  NDArray retval (dim_vector (val.Size (), 1));
-  octave_idx_type index = 0;
-  for (const auto& elem : val.GetArray ())
-    retval(index++) = elem.IsNull () ? octave_NaN
-                                     : decode_number (elem).double_value ();
-  return retval;
+  const rapidjson::Value& size = val["size"];
+  const rapidjson::Value& i = val["i"];
+  const rapidjson::Value& j = val["j"];
+  const rapidjson::Value& v = val["v"];
+
+  if (! size.IsArray () || size.Size () != 2 || ! size[0].IsUint64 ()
+      || ! size[1].IsUint64 ())
+    error ("jsondecode: sparse matrix: \"size\" must contain two "
+           "non-negative integers");
+  if (! i.IsArray () || ! j.IsArray () || ! v.IsArray ()
+      || i.Size () != v.Size () || j.Size () != v.Size ())
+    error ("jsondecode: sparse matrix: \"i\", \"j\", and \"v\" must be "
+           "arrays of the same length");
+
+  rapidjson::SizeType nnz = v.Size ();
+  ColumnVector rows (nnz);
+  ColumnVector cols (nnz);
+  for (rapidjson::SizeType k = 0; k < nnz; ++k)
+    {
+      if (! i[k].IsNumber () || ! j[k].IsNumber ())
+        error ("jsondecode: sparse matrix: \"i\" and \"j\" must contain "
+               "numbers");
+      rows(k) = i[k].GetDouble ();
+      cols(k) = j[k].GetDouble ();
+    }
+
+  bool is_bool = true;
+  for (rapidjson::SizeType k = 0; k < nnz && is_bool; ++k)
+    is_bool = v[k].IsBool ();
+
+  octave_value values;
+  if (is_bool && nnz > 0)
+    {
+      boolNDArray bool_values (dim_vector (nnz, 1));
+      for (rapidjson::SizeType k = 0; k < nnz; ++k)
+        bool_values(k) = v[k].GetBool ();
+      values = bool_values;
+    }
+  else
+    {
+      ColumnVector num_values (nnz);
+      for (rapidjson::SizeType k = 0; k < nnz; ++k)
+        {
+          if (v[k].IsNumber ())
+            num_values(k) = v[k].GetDouble ();
+          else if (v[k].IsNull ())
+            num_values(k) = octave_NaN;
+          else
+            error ("jsondecode: sparse matrix: \"v\" must contain numbers "
+                   "or booleans");
+        }
+      values = num_values;
+    }
+
+  return Fsparse (ovl (rows, cols, values,
+                       static_cast<double> (size[0].GetUint64 ()),
+                       static_cast<double> (size[1].GetUint64 ())))(0);
 }
 
-//! Decodes a JSON array that contains only boolean values into a boolNDArray.
+//! Field layout of JSON objects with the same ordered key set.
+
+struct object_layout
+{
+  //! Field names of the resulting struct, shared by all objects.
+  octave_fields fields;
+
+  //! Index into @c fields for each member of the JSON object.  Duplicate
+  //! keys map to the same field, so the last of them wins.
+  std::vector<octave_idx_type> positions;
+};
+
+//! Looks up or creates the field layout of a JSON object.
 //!
-//! @param val JSON value that is guaranteed to be a boolean array.
+//! @param val JSON value that is guaranteed to be a JSON object.
+//! @param options @ref decode_options of this jsondecode call.
+//! @param cache layouts of the objects decoded so far.
 //!
-//! @return @ref octave_value that contains the equivalent boolNDArray of @p val.
+//! @return @ref object_layout of the keys of @p val.
 //!
 //! @b Example:
 //!
 //! @code{.cc}
 //! rapidjson::Document d;
-//! d.Parse ("[true, false, true]");
-//! octave_value boolean_array = decode_boolean_array (d);
+//! d.Parse ("{\"a\": 1, \"b\": 2}");
+//! layout_cache cache;
+//! const object_layout& layout = get_layout (d, decode_options (), cache);
+//! @endcode
+
+const object_layout&
+get_layout (const rapidjson::Value& val, const decode_options& options,
+            layout_cache& cache)
+{
+  // Prefix each key with its length, as keys may contain any character.
+  std::string key;
+  for (const auto& pair : val.GetObject ())
+    {
+      key += std::to_string (pair.name.GetStringLength ());
+      key += ':';
+      key.append (pair.name.GetString (), pair.name.GetStringLength ());
+    }
+
+  auto it = cache.find (key);
+  if (it != cache.end ())
+    return it->second;
+
+  object_layout layout;
+  for (const auto& pair : val.GetObject ())
+    {
+      // Validator function "matlab.lang.makeValidName" to guarantee
+      // legitimate variable name.
+      std::string varname = pair.name.GetString ();
+      if (options.make_valid_name != nullptr)
+        octave::make_valid_name (varname, *options.make_valid_name);
+      // Adds the field if it is not present yet.
+      layout.positions.push_back (layout.fields.getfield (varname));
+    }
+
+  return cache.emplace (std::move (key), std::move (layout)).first->second;
+}
+
+//! Decodes a JSON object into a scalar struct.
+//!
+//! @param val JSON value that is guaranteed to be a JSON object.
+//! @param values decoded values of the members of @p val.
+//! @param options @ref decode_options of this jsondecode call.
+//! @param cache layouts of the objects decoded so far.
+//!
+//! @return @ref octave_value that contains the equivalent scalar struct of @p val.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! rapidjson::Document d;
+//! d.Parse ("{\"a\": 1, \"b\": 2}");
+//! Cell values (ovl (1, 2));
+//! layout_cache cache;
+//! octave_value struct = decode_object (d, values, decode_options (), cache);
 //! @endcode
 
 octave_value
-decode_boolean_array (const rapidjson::Value& val)
+decode_object (const rapidjson::Value& val, const Cell& values,
+               const decode_options& options, layout_cache& cache)
 {
-  boolNDArray retval (dim_vector (val.Size (), 1));
-  octave_idx_type index = 0;
-  for (const auto& elem : val.GetArray ())
-    retval(index++) = elem.GetBool ();
+  const object_layout& layout = get_layout (val, options, cache);
+
+  // Fill the fields by position instead of looking up each name.
+  octave_scalar_map retval (layout.fields);
+  for (octave_idx_type i = 0; i < values.numel (); i++)
+    retval.contents (layout.positions[i]) = values(i);
+
   return retval;
 }
 
-//! Decodes a JSON array that contains different types
-//! or string values only into a Cell.
+//! Decodes a JSON array of numerical or null values into an NDArray.
 //!
-//! @param val JSON value that is guaranteed to be a mixed or string array.
-//! @param options @c ReplacementStyle and @c Prefix options with their values.
+//! The types of the elements are checked while they are converted, so the
+//! array is read only once.  The conversion stops at the first element that
+//! is neither a number nor null.
 //!
-//! @return @ref octave_value that contains the equivalent Cell of @p val.
+//! @param val JSON value that is guaranteed to be a non-empty array.
+//! @param[out] retval equivalent NDArray of @p val if the return value is
+//! @c true.
 //!
-//! @b Example (decoding a string array):
+//! @return @c true if all elements of @p val are numbers or null.
+//!
+//! @b Example:
 //!
 //! @code{.cc}
 //! rapidjson::Document d;
-//! d.Parse ("[\"foo\", \"bar\", \"baz\"]");
-//! octave_value cell = decode_string_and_mixed_array (d, octave_value_list ());
+//! d.Parse ("[1, 2, 3, 4]");
+//! octave_value numeric_array;
+//! bool ok = decode_numeric_array (d, numeric_array);
 //! @endcode
+
+bool
+decode_numeric_array (const rapidjson::Value& val, octave_value& retval)
+{
+  const rapidjson::Value *elem = val.Begin ();
+  rapidjson::SizeType n = val.Size ();
+
+  NDArray array (dim_vector (n, 1));
+  double *data = array.fortran_vec ();
+  for (rapidjson::SizeType i = 0; i < n; ++i)
+    {
+      if (elem[i].IsNumber ())
+        data[i] = elem[i].GetDouble ();
+      else if (elem[i].IsNull ())
+        data[i] = octave_NaN;
+      else
+        return false;
+    }
+
+  retval = array;
+  return true;
+}
+
+//! Decodes a JSON array of boolean values into a boolNDArray.
 //!
-//! @b Example (decoding a mixed array):
+//! Like @ref decode_numeric_array, the types of the elements are checked
+//! while they are converted.
+//!
+//! @param val JSON value that is guaranteed to be a non-empty array.
+//! @param[out] retval equivalent boolNDArray of @p val if the return value
+//! is @c true.
+//!
+//! @return @c true if all elements of @p val are booleans.
+//!
+//! @b Example:
 //!
 //! @code{.cc}
 //! rapidjson::Document d;
-//! d.Parse ("[\"foo\", 123, true]");
-//! octave_value cell = decode_string_and_mixed_array (d, octave_value_list ());
+//! d.Parse ("[true, false, true]");
+//! octave_value boolean_array;
+//! bool ok = decode_boolean_array (d, boolean_array);
 //! @endcode
 
-octave_value
-decode_string_and_mixed_array (const rapidjson::Value& val,
-                               const octave::make_valid_name_options* options)
+bool
+decode_boolean_array (const rapidjson::Value& val, octave_value& retval)
 {
-  Cell retval (dim_vector (val.Size (), 1));
-  octave_idx_type index = 0;
-  for (const auto& elem : val.GetArray ())
-    retval(index++) = decode (elem, options);
-  return retval;
+  const rapidjson::Value *elem = val.Begin ();
+  rapidjson::SizeType n = val.Size ();
+
+  boolNDArray array (dim_vector (n, 1));
+  bool *data = array.fortran_vec ();
+  for (rapidjson::SizeType i = 0; i < n; ++i)
+    {
+      if (! elem[i].IsBool ())
+        return false;
+      data[i] = elem[i].GetBool ();
+    }
+
+  retval = array;
+  return true;
+}
+
+//! Compares two lists of field names including their order.
+//!
+//! Unlike comparing @c std_list copies, no memory is allocated and the
+//! comparison stops at the first difference.
+//!
+//! @return @c true if @p a and @p b are equal.
+
+bool
+equal_field_names (const string_vector& a, const string_vector& b)
+{
+  if (a.numel () != b.numel ())
+    return false;
+
+  for (octave_idx_type i = 0; i < a.numel (); ++i)
+    if (a(i) != b(i))
+      return false;
+
+  return true;
 }
 
 //! Decodes a JSON array that contains only objects into a Cell or struct array
 //! depending on the similarity of the objects' keys.
 //!
-//! @param val JSON value that is guaranteed to be an object array.
-//! @param options @c ReplacementStyle and @c Prefix options with their values.
+//! By default, the objects are merged into a struct array if all of them
+//! have the same keys in the same order.  With @c object_merge::unordered,
+//! the order of the keys may differ, and with @c object_merge::fill, all
+//! objects are merged and missing keys are filled with @c [].  The fields
+//! are ordered by the first appearance of their key.
+//!
+//! @param struct_cell decoded objects of the array.
+//! @param merge objects that are merged into a struct array.
 //!
 //! @return @ref octave_value that contains the equivalent Cell
-//! or struct array of @p val.
+//! or struct array of @p struct_cell.
 //!
 //! @b Example (returns a struct array):
 //!
 //! @code{.cc}
-//! rapidjson::Document d;
-//! d.Parse ("[{\"a\":1,\"b\":2},{\"a\":3,\"b\":4}]");
-//! octave_value object_array = decode_object_array (d, octave_value_list ());
+//! octave_scalar_map a, b;
+//! a.assign ("a", 1);
+//! b.assign ("a", 2);
+//! octave_value object_array = decode_object_array (Cell (ovl (a, b)));
 //! @endcode
 //!
 //! @b Example (returns a Cell):
 //!
 //! @code{.cc}
-//! rapidjson::Document d;
-//! d.Parse ("[{\"a\":1,\"b\":2},{\"b\":3,\"a\":4}]");
-//! octave_value object_array = decode_object_array (d, octave_value_list ());
+//! octave_scalar_map a, b;
+//! a.assign ("a", 1);
+//! b.assign ("b", 2);
+//! octave_value object_array = decode_object_array (Cell (ovl (a, b)));
 //! @endcode
 
 octave_value
-decode_object_array (const rapidjson::Value& val,
-                     const octave::make_valid_name_options* options)
+decode_object_array (const Cell& struct_cell,
+                     object_merge merge = object_merge::ordered)
 {
-  Cell struct_cell = decode_string_and_mixed_array (val, options).cell_value ();
+  // Objects that were decoded into other types (e.g. base64 encoded numeric
+  // arrays or sparse matrices) are never merged into a struct array.
+  for (octave_idx_type i = 0; i < struct_cell.numel (); ++i)
+    if (! struct_cell(i).isstruct ())
+      return struct_cell;
+
   string_vector field_names = struct_cell(0).scalar_map_value ().fieldnames ();
 
   bool same_field_names = true;
   for (octave_idx_type i = 1; i < struct_cell.numel (); ++i)
-    if (field_names.std_list ()
-        != struct_cell(i).scalar_map_value ().fieldnames ().std_list ())
+    if (! equal_field_names (field_names,
+                             struct_cell(i).scalar_map_value ().fieldnames ()))
       {
         same_field_names = false;
         break;
@@ -253,42 +899,125 @@ decode_object_array (const rapidjson::Value& val,
 
       return struct_array;
     }
-  else
+  else if (merge == object_merge::ordered)
     return struct_cell;
-}
 
-//! Decodes a JSON array that contains only arrays into a Cell or an NDArray
-//! depending on the dimensions and element types of the sub-arrays.
-//!
-//! @param val JSON value that is guaranteed to be an array of arrays.
-//! @param options @c ReplacementStyle and @c Prefix options with their values.
-//!
-//! @return @ref octave_value that contains the equivalent Cell
-//! or NDArray of @p val.
-//!
-//! @b Example (returns an NDArray):
-//!
-//! @code{.cc}
-//! rapidjson::Document d;
-//! d.Parse ("[[1, 2], [3, 4]]");
-//! octave_value array = decode_array_of_arrays (d, octave_value_list ());
+  // Column of each key in the order of its first appearance.  The key set
+  // of an object is compared through this hash table, no key is compared
+  // twice and nothing is sorted.
+  std::unordered_map<std::string, std::size_t> columns;
+  std::vector<std::string> keys;
+  for (octave_idx_type i = 0; i < field_names.numel (); ++i)
+    {
+      columns.emplace (field_names(i), keys.size ());
+      keys.push_back (field_names(i));
+    }
+
+  dim_vector struct_array_dims = dim_vector (struct_cell.numel (), 1);
+  std::vector<Cell> values (keys.size (), Cell (struct_array_dims));
+
+  for (octave_idx_type k = 0; k < struct_cell.numel (); ++k)
+    {
+      octave_scalar_map object = struct_cell(k).scalar_map_value ();
+      if (merge == object_merge::unordered
+          && object.nfields () != static_cast<octave_idx_type> (keys.size ()))
+        return struct_cell;
+
+      for (auto p = object.begin (); p != object.end (); ++p)
+        {
+          auto column = columns.find (object.key (p));
+          if (column == columns.end ())
+            {
+              if (merge == object_merge::unordered)
+                return struct_cell;
+
+              // Cell fills the rows of the previous objects with [].
+              column = columns.emplace (object.key (p), keys.size ()).first;
+              keys.push_back (object.key (p));
+              values.push_back (Cell (struct_array_dims));
+            }
+          values[column->second](k) = object.contents (p);
+        }
+    }
+
+  octave_map struct_array (struct_array_dims);
+  for (std::size_t i = 0; i < keys.size (); ++i)
+    struct_array.assign (keys[i], values[i]);
+
+  return struct_array;
+}
+
+//! Copies @p rows sub-arrays of @p cols elements each into the rows of a
+//! column-major array, i.e. @c dst[k + i * rows.size ()] = rows[k][i].
+//!
+//! A plain loop over the sub-arrays writes with a stride of the number of
+//! rows and misses the cache on nearly every element of large arrays.  The
+//! copy is therefore done in square tiles that fit into the L1 cache: each
+//! tile reads a few cache lines of every sub-array and writes contiguous
+//! runs of the destination.
+//!
+//! @param dst column-major destination with @c rows.size () rows and
+//! @p cols columns.
+//! @param rows pointers to the data of the sub-arrays.
+//! @param cols number of elements of each sub-array.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! double a[] = {1, 2, 3}, b[] = {4, 5, 6}, dst[6];
+//! blocked_transpose (dst, std::vector<const double *> {a, b}, 3);
+//! // dst = {1, 4, 2, 5, 3, 6}
+//! @endcode
+
+template <typename T> void
+blocked_transpose (T *dst, const std::vector<const T *>& rows,
+                   octave_idx_type cols)
+{
+  const octave_idx_type tile = 32;
+  octave_idx_type nrows = rows.size ();
+
+  for (octave_idx_type k0 = 0; k0 < nrows; k0 += tile)
+    {
+      octave_idx_type k1 = std::min (k0 + tile, nrows);
+      for (octave_idx_type i0 = 0; i0 < cols; i0 += tile)
+        {
+          octave_idx_type i1 = std::min (i0 + tile, cols);
+          for (octave_idx_type i = i0; i < i1; ++i)
+            {
+              T *out = dst + i * nrows;
+              for (octave_idx_type k = k0; k < k1; ++k)
+                out[k] = rows[k][i];
+            }
+        }
+    }
+}
+
+//! Decodes a JSON array that contains only arrays into a Cell or an NDArray
+//! depending on the dimensions and element types of the sub-arrays.
+//!
+//! @param cell decoded sub-arrays of the array.
+//!
+//! @return @ref octave_value that contains the equivalent Cell
+//! or NDArray of @p cell.
+//!
+//! @b Example (returns an NDArray):
+//!
+//! @code{.cc}
+//! Cell cell (ovl (ColumnVector (2, 1.0), ColumnVector (2, 2.0)));
+//! octave_value array = decode_array_of_arrays (cell);
 //! @endcode
 //!
 //! @b Example (returns a Cell):
 //!
 //! @code{.cc}
-//! rapidjson::Document d;
-//! d.Parse ("[[1, 2], [3, 4, 5]]");
-//! octave_value cell = decode_array_of_arrays (d, octave_value_list ());
+//! Cell cell (ovl (ColumnVector (2, 1.0), ColumnVector (3, 2.0)));
+//! octave_value cell = decode_array_of_arrays (cell);
 //! @endcode
 
 octave_value
-decode_array_of_arrays (const rapidjson::Value& val,
-                        const octave::make_valid_name_options* options)
+decode_array_of_arrays (const Cell& cell)
 {
   // Some arrays should be decoded as NDArrays and others as cell arrays
-  Cell cell = decode_string_and_mixed_array (val, options).cell_value ();
-
   // Only arrays with sub-arrays of booleans and numericals will return NDArray
   bool is_bool = cell(0).is_bool_matrix ();
   bool is_struct = cell(0).isstruct ();
@@ -314,8 +1043,8 @@ decode_array_of_arrays (const rapidjson::Value& val,
       if (cell(i).isstruct () != is_struct)
         return cell;
       // If struct arrays have different fields, return cell array
-      if (is_struct && (field_names.std_list ()
-                        != cell(i).map_value ().fieldnames ().std_list ()))
+      if (is_struct && ! equal_field_names (field_names,
+                                            cell(i).map_value ().fieldnames ()))
         return cell;
     }
 
@@ -333,20 +1062,27 @@ decode_array_of_arrays (const rapidjson::Value& val,
 
       if (field_names.numel ())
         {
-          Cell value (array_dims);
           octave_idx_type sub_array_numel = sub_array_dims.numel ();
 
+          std::vector<octave_map> sub_arrays (cell_numel);
+          for (octave_idx_type k = 0; k < cell_numel; ++k)
+            sub_arrays[k] = cell(k).map_value ();
+
+          std::vector<Cell> sub_array_values (cell_numel);
+          std::vector<const octave_value *> rows (cell_numel);
           for (octave_idx_type j = 0; j < field_names.numel (); ++j)
             {
-              // Populate the array with specific order to generate
-              // MATLAB-identical output.
               for (octave_idx_type k = 0; k < cell_numel; ++k)
                 {
-                  Cell sub_array_value = cell(k).map_value ()
-                                                .getfield (field_names(j));
-                  for (octave_idx_type i = 0; i < sub_array_numel; ++i)
-                    value(k + i * cell_numel) = sub_array_value(i);
+                  sub_array_values[k]
+                    = sub_arrays[k].contents (field_names(j));
+                  rows[k] = sub_array_values[k].data ();
                 }
+
+              // Populate the array with specific order to generate
+              // MATLAB-identical output.
+              Cell value (array_dims);
+              blocked_transpose (value.fortran_vec (), rows, sub_array_numel);
               struct_array.assign (field_names(j), value);
             }
         }
@@ -362,12 +1098,14 @@ decode_array_of_arrays (const rapidjson::Value& val,
       // Populate the array with specific order to generate MATLAB-identical
       // output.
       octave_idx_type sub_array_numel = array.numel () / cell_numel;
+      std::vector<NDArray> sub_array_values (cell_numel);
+      std::vector<const double *> rows (cell_numel);
       for (octave_idx_type k = 0; k < cell_numel; ++k)
         {
-          NDArray sub_array_value = cell(k).array_value ();
-          for (octave_idx_type i = 0; i < sub_array_numel; ++i)
-            array(k + i * cell_numel) = sub_array_value(i);
+          sub_array_values[k] = cell(k).array_value ();
+          rows[k] = sub_array_values[k].data ();
         }
+      blocked_transpose (array.fortran_vec (), rows, sub_array_numel);
 
       if (is_bool)
         return boolNDArray (array);
@@ -376,275 +1114,4909 @@ decode_array_of_arrays (const rapidjson::Value& val,
     }
 }
 
-//! Decodes any type of JSON arrays.  This function only serves as an interface
-//! by choosing which function to call from the previous functions.
+//! Decodes a JSON array of objects into a scalar struct of columns.
 //!
-//! @param val JSON value that is guaranteed to be an array.
-//! @param options @c ReplacementStyle and @c Prefix options with their values.
+//! Each field is an Nx1 column with one row per object.  Its type depends
+//! on the values of its key: numbers give a double column, Booleans a
+//! logical column, strings a cellstr, and anything else a Cell.  Missing
+//! keys and null are @c NaN in double columns and empty otherwise.  A
+//! logical column with missing values becomes a double column.  Numbers,
+//! Booleans, and strings are read directly from the JSON values, so there
+//! is no @ref octave_value per row and field.
 //!
-//! @return @ref octave_value that contains the output of decoding @p val.
+//! @param val JSON value that is guaranteed to be an array of objects.
+//! @param nested decoded values of all members that are objects or arrays,
+//! in the order of the members of the objects.
+//! @param options @ref decode_options of this jsondecode call.
+//! @param cache layouts of the objects decoded so far.
+//!
+//! @return @ref octave_value that contains the scalar struct of columns.
 //!
 //! @b Example:
 //!
 //! @code{.cc}
 //! rapidjson::Document d;
-//! d.Parse ("[[1, 2], [3, 4, 5]]");
-//! octave_value array = decode_array (d, octave_value_list ());
+//! d.Parse ("[{\"a\": 1, \"b\": \"x\"}, {\"a\": 2}]");
+//! layout_cache cache;
+//! octave_value columns = decode_columns (d, Cell (), decode_options (),
+//!                                       cache);
 //! @endcode
 
 octave_value
-decode_array (const rapidjson::Value& val,
-              const octave::make_valid_name_options* options)
-{
-  // Handle empty arrays
-  if (val.Empty ())
-    return NDArray ();
-
-  // Compare with other elements to know if the array has multiple types
-  rapidjson::Type array_type = val[0].GetType ();
-  // Check if the array is numeric and if it has multiple types
-  bool same_type = true;
-  bool is_numeric = true;
-  for (const auto& elem : val.GetArray ())
-    {
-      rapidjson::Type current_elem_type = elem.GetType ();
-      if (is_numeric && ! (current_elem_type == rapidjson::kNullType
-          || current_elem_type == rapidjson::kNumberType))
-        is_numeric = false;
-      if (same_type && (current_elem_type != array_type))
-        // RapidJSON doesn't have kBoolean Type it has kTrueType and kFalseType
-        if (! ((current_elem_type == rapidjson::kTrueType
-                && array_type == rapidjson::kFalseType)
-            || (current_elem_type == rapidjson::kFalseType
-                && array_type == rapidjson::kTrueType)))
-          same_type = false;
+decode_columns (const rapidjson::Value& val, const Cell& nested,
+                const decode_options& options, layout_cache& cache)
+{
+  enum column_kind { none, number, boolean, string, other };
+
+  octave_idx_type n = val.Size ();
+  octave_fields fields;
+  std::vector<column_kind> kinds;
+  // Number of rows with a non-null value and the last of them.
+  std::vector<octave_idx_type> present;
+  std::vector<octave_idx_type> last_row;
+
+  // Columns of the members of each distinct object layout.
+  std::unordered_map<const object_layout *, std::vector<octave_idx_type>>
+    layout_columns;
+  std::vector<const std::vector<octave_idx_type> *> row_columns (n);
+
+  // First pass: collect the columns and their kinds.
+  octave_idx_type row = 0;
+  for (const auto& obj : val.GetArray ())
+    {
+      const object_layout& layout = get_layout (obj, options, cache);
+      auto it = layout_columns.find (&layout);
+      if (it == layout_columns.end ())
+        {
+          std::vector<octave_idx_type> columns;
+          string_vector names = layout.fields.fieldnames ();
+          for (octave_idx_type pos : layout.positions)
+            columns.push_back (fields.getfield (names(pos)));
+          kinds.resize (fields.nfields (), none);
+          present.resize (fields.nfields (), 0);
+          last_row.resize (fields.nfields (), -1);
+          it = layout_columns.emplace (&layout, std::move (columns)).first;
+        }
+      row_columns[row] = &it->second;
+
+      std::size_t m = 0;
+      for (const auto& pair : obj.GetObject ())
+        {
+          octave_idx_type col = it->second[m++];
+          const rapidjson::Value& v = pair.value;
+          if (v.IsNull ())
+            continue;
+
+          column_kind kind = v.IsNumber () ? number
+                             : v.IsBool () ? boolean
+                             : v.IsString () ? string : other;
+          if (kinds[col] == none)
+            kinds[col] = kind;
+          else if (kinds[col] != kind)
+            kinds[col] = other;
+
+          if (last_row[col] != row)
+            present[col]++;
+          last_row[col] = row;
+        }
+      row++;
     }
 
-  if (is_numeric)
-    return decode_numeric_array (val);
+  octave_idx_type nfields = fields.nfields ();
+  std::vector<NDArray> numbers (nfields);
+  std::vector<boolNDArray> bools (nfields);
+  std::vector<Cell> cells (nfields);
+  dim_vector dims (n, 1);
+  for (octave_idx_type col = 0; col < nfields; col++)
+    {
+      if (kinds[col] == boolean && present[col] < n)
+        kinds[col] = number;
+
+      switch (kinds[col])
+        {
+        case boolean:
+          bools[col] = boolNDArray (dims, false);
+          break;
+        case string:
+          cells[col] = Cell (dims, octave_value (""));
+          break;
+        case other:
+          cells[col] = Cell (dims, octave_value (NDArray ()));
+          break;
+        default:
+          numbers[col] = NDArray (dims, octave_NaN);
+          break;
+        }
+    }
 
-  if (same_type && (array_type != rapidjson::kStringType))
+  // Second pass: fill the columns.
+  octave_idx_type k = 0;
+  row = 0;
+  for (const auto& obj : val.GetArray ())
     {
-      if (array_type == rapidjson::kTrueType
-          || array_type == rapidjson::kFalseType)
-        return decode_boolean_array (val);
-      else if (array_type == rapidjson::kObjectType)
-        return decode_object_array (val, options);
-      else if (array_type == rapidjson::kArrayType)
-        return decode_array_of_arrays (val, options);
+      std::size_t m = 0;
+      for (const auto& pair : obj.GetObject ())
+        {
+          octave_idx_type col = (*row_columns[row])[m++];
+          const rapidjson::Value& v = pair.value;
+          octave_value elem;
+          if (v.IsObject () || v.IsArray ())
+            elem = nested(k++);
+
+          switch (kinds[col])
+            {
+            case boolean:
+              bools[col](row) = v.IsBool () && v.GetBool ();
+              break;
+            case string:
+              cells[col](row) = v.IsString () ? decode_string (v, options)
+                                              : octave_value ("");
+              break;
+            case other:
+              if (v.IsNull ())
+                cells[col](row) = NDArray ();
+              else if (v.IsBool ())
+                cells[col](row) = v.GetBool ();
+              else if (v.IsNumber ())
+                cells[col](row) = decode_number (v);
+              else if (v.IsString ())
+                cells[col](row) = decode_string (v, options);
+              else
+                cells[col](row) = elem;
+              break;
+            default:
+              if (v.IsNumber ())
+                numbers[col](row) = v.GetDouble ();
+              else if (v.IsBool ())
+                numbers[col](row) = v.GetBool ();
+              else
+                numbers[col](row) = octave_NaN;
+              break;
+            }
+        }
+      row++;
+    }
+
+  octave_scalar_map retval (fields);
+  for (octave_idx_type col = 0; col < nfields; col++)
+    {
+      if (kinds[col] == boolean)
+        retval.contents (col) = bools[col];
+      else if (kinds[col] == string || kinds[col] == other)
+        retval.contents (col) = cells[col];
       else
-        error ("jsondecode: unidentified type");
+        retval.contents (col) = numbers[col];
     }
-  else
-    return decode_string_and_mixed_array (val, options);
+
+  return retval;
 }
 
-//! Decodes any JSON value.  This function only serves as an interface
-//! by choosing which function to call from the previous functions.
+//! Kinds of JSON values, depending on whether their elements have to be
+//! decoded before the value itself.
+
+enum class decode_kind
+{
+  value,            // decoded without decoding elements first
+  object,           // scalar struct of the decoded members
+  object_array,     // see decode_object_array
+  object_columns,   // see decode_columns
+  array_of_arrays,  // see decode_array_of_arrays
+  mixed_array       // Cell of the decoded elements
+};
+
+//! Decodes JSON values that do not contain other values to decode, like
+//! numbers, strings, and arrays of numbers or booleans.  All other values
+//! are only classified.
 //!
 //! @param val JSON value.
-//! @param options @c ReplacementStyle and @c Prefix options with their values.
+//! @param options @ref decode_options of this jsondecode call.
+//! @param[out] retval decoded value if the return value is
+//! @c decode_kind::value.
 //!
-//! @return @ref octave_value that contains the output of decoding @p val.
+//! @return kind of @p val.
 //!
 //! @b Example:
 //!
 //! @code{.cc}
 //! rapidjson::Document d;
-//! d.Parse ("[{\"a\":1,\"b\":2},{\"b\":3,\"a\":4}]");
-//! octave_value value = decode (d, octave_value_list ());
+//! d.Parse ("[1, 2, null]");
+//! octave_value array;
+//! decode_kind kind = decode_leaf (d, decode_options (), array);
 //! @endcode
 
-octave_value
-decode (const rapidjson::Value& val,
-        const octave::make_valid_name_options* options)
+decode_kind
+decode_leaf (const rapidjson::Value& val, const decode_options& options,
+             octave_value& retval)
 {
   if (val.IsBool ())
-    return val.GetBool ();
+    retval = val.GetBool ();
   else if (val.IsNumber ())
-    return decode_number (val);
+    retval = decode_number (val);
   else if (val.IsString ())
-    return val.GetString ();
+    {
+      const typed_array *array = find_typed_array (val, options);
+      retval = (array ? decode_typed_array (*array)
+                      : decode_string (val, options));
+    }
   else if (val.IsObject ())
-    return decode_object (val, options);
+    {
+      if (options.base64_arrays && is_base64_array (val))
+        retval = decode_base64_array (val);
+      else if (options.compact_sparse && is_sparse_object (val))
+        retval = decode_sparse (val);
+      else
+        return decode_kind::object;
+    }
   else if (val.IsNull ())
-    return NDArray ();
+    retval = NDArray ();
   else if (val.IsArray ())
-    return decode_array (val, options);
-  else
-    error ("jsondecode: unidentified type");
-}
-
-#endif
-
-DEFUN_DLD (jsondecode, args, ,
-           "-*- texinfo -*-\n\
-@deftypefn  {} {@var{object} =} jsondecode (@var{JSON_txt})                  \n\
-@deftypefnx {} {@var{object} =} jsondecode (@dots{}, \"ReplacementStyle\", @var{rs}) \n\
-@deftypefnx {} {@var{object} =} jsondecode (@dots{}, \"Prefix\", @var{pfx})  \n\
-@deftypefnx {} {@var{object} =} jsondecode (@dots{}, \"makeValidName\", @var{TF}) \n\
-                                                                             \n\
-Decode text that is formatted in JSON.                                       \n\
-                                                                             \n\
-The input @var{JSON_txt} is a string that contains JSON text.                \n\
-                                                                             \n\
-The output @var{object} is an Octave object that contains the result of      \n\
-decoding @var{JSON_txt}.                                                     \n\
-                                                                             \n\
-For more information about the options @qcode{\"ReplacementStyle\"} and      \n\
-@qcode{\"Prefix\"}, see                                                      \n\
-@ref{XREFmatlab_lang_makeValidName,,matlab.lang.makeValidName}.              \n\
-                                                                             \n\
-If the value of the option @qcode{\"makeValidName\"} is false then names     \n\
-will not be changed by @code{matlab.lang.makeValidName} and the              \n\
-@qcode{\"ReplacementStyle\"} and @qcode{\"Prefix\"} options will be ignored. \n\
-                                                                             \n\
-NOTE: Decoding and encoding JSON text is not guaranteed to reproduce the     \n\
-original text as some names may be changed by @code{matlab.lang.makeValidName}. \n\
-                                                                             \n\
-This table shows the conversions from JSON data types to Octave data types:  \n\
-                                                                             \n\
-@multitable @columnfractions 0.50 0.50                                       \n\
-@headitem JSON data type @tab Octave data type                               \n\
-@item Boolean @tab scalar logical                                            \n\
-@item Number @tab scalar double                                              \n\
-@item String @tab vector of characters                                       \n\
-@item Object @tab scalar struct (field names of the struct may be different  \n\
-      from the keys of the JSON object due to @code{matlab_lang_makeValidName} \n\
-@item null, inside a numeric array @tab @code{NaN}                           \n\
-@item null, inside a non-numeric array @tab empty double array @code{[]}     \n\
-@item Array, of different data types @tab cell array                         \n\
-@item Array, of Booleans @tab logical array                                  \n\
-@item Array, of Numbers @tab double array                                    \n\
-@item Array, of Strings @tab cell array of character vectors (@code{cellstr}) \n\
-@item Array of Objects, same field names @tab struct array                   \n\
-@item Array of Objects, different field names @tab cell array of scalar structs \n\
-@end multitable                                                              \n\
-                                                                             \n\
-Examples:                                                                    \n\
-                                                                             \n\
-@example                                                                     \n\
-@group                                                                       \n\
-jsondecode ('[1, 2, null, 3]')                                               \n\
-    @result{} ans =                                                          \n\
-                                                                             \n\
-      1                                                                      \n\
-      2                                                                      \n\
-    NaN                                                                      \n\
-      3                                                                      \n\
-@end group                                                                   \n\
-                                                                             \n\
-@group                                                                       \n\
-jsondecode ('[\"foo\", \"bar\", [\"foo\", \"bar\"]]')                        \n\
-    @result{} ans =                                                          \n\
-       @{                                                                    \n\
-         [1,1] = foo                                                         \n\
-         [2,1] = bar                                                         \n\
-         [3,1] =                                                             \n\
-         @{                                                                  \n\
-           [1,1] = foo                                                       \n\
-           [2,1] = bar                                                       \n\
-         @}                                                                  \n\
-                                                                             \n\
-       @}                                                                    \n\
-@end group                                                                   \n\
-                                                                             \n\
-@group                                                                       \n\
-jsondecode ('@{\"nu#m#ber\": 7, \"s#tr#ing\": \"hi\"@}', ...                 \n\
-            'ReplacementStyle', 'delete')                                    \n\
-    @result\{} scalar structure containing the fields:                       \n\
-                                                                             \n\
-         number = 7                                                          \n\
-         string = hi                                                         \n\
-@end group                                                                   \n\
-                                                                             \n\
-@group                                                                       \n\
-jsondecode ('@{\"nu#m#ber\": 7, \"s#tr#ing\": \"hi\"@}', ...                 \n\
-            'makeValidName', false)                                          \n\
-    @result\{} scalar structure containing the fields:                       \n\
-                                                                             \n\
-         nu#m#ber = 7                                                        \n\
-         s#tr#ing = hi                                                       \n\
-@end group                                                                   \n\
-                                                                             \n\
-@group                                                                       \n\
-jsondecode ('@{\"1\": \"one\", \"2\": \"two\"@}', 'Prefix', 'm_')            \n\
-    @result\{} scalar structure containing the fields:                       \n\
-                                                                             \n\
-         m_1 = one                                                           \n\
-         m_2 = two                                                           \n\
-@end group                                                                   \n\
-@end example                                                                 \n\
-                                                                             \n\
-@seealso{jsonencode, matlab.lang.makeValidName}                              \n\
-@end deftypefn ")
-{
-#if defined (HAVE_RAPIDJSON)
+    {
+      // Handle empty arrays
+      if (val.Empty ())
+        {
+          retval = NDArray ();
+          return decode_kind::value;
+        }
 
-  int nargin = args.length ();
+      // Arrays of numbers and booleans are checked and converted in a
+      // single pass.  It speculates that all elements are of the kind of the
+      // first one.  Any other element makes the array a mixed array, as it
+      // differs from the first one.
+      rapidjson::Type array_type = element_type (val[0], options);
+      if (array_type == rapidjson::kNumberType
+          || array_type == rapidjson::kNullType)
+        return decode_numeric_array (val, retval) ? decode_kind::value
+                                                  : decode_kind::mixed_array;
+      if (array_type == rapidjson::kTrueType
+          || array_type == rapidjson::kFalseType)
+        return decode_boolean_array (val, retval) ? decode_kind::value
+                                                  : decode_kind::mixed_array;
 
-  // makeValidName options are pairs, the number of arguments must be odd.
-  if (! (nargin % 2))
-    print_usage ();
+      // Compare with other elements to know if the array has multiple types
+      bool same_type = true;
+      for (const auto& elem : val.GetArray ())
+        if (element_type (elem, options) != array_type)
+          {
+            same_type = false;
+            break;
+          }
 
-  // Detect if the user wants to use makeValidName
-  bool use_makeValidName = true;
-  octave_value_list make_valid_name_params;
-  for (auto i = 1; i < nargin; i = i + 2)
-    {
-      std::string parameter = args(i).xstring_value ("jsondecode: "
-        "option argument must be a string");
-      if (octave::string::strcmpi (parameter, "makeValidName"))
+      if (same_type && (array_type != rapidjson::kStringType))
         {
-          use_makeValidName = args(i + 1).xbool_value ("jsondecode: "
-            "'makeValidName' value must be a bool");
+          if (array_type == rapidjson::kObjectType)
+            {
+              // Objects decoded into other types are never split into
+              // columns.
+              if (options.object_columns)
+                for (const auto& elem : val.GetArray ())
+                  if ((options.base64_arrays && is_base64_array (elem))
+                      || (options.compact_sparse && is_sparse_object (elem)))
+                    return decode_kind::object_array;
+
+              return options.object_columns ? decode_kind::object_columns
+                                            : decode_kind::object_array;
+            }
+          else if (array_type == rapidjson::kArrayType)
+            return decode_kind::array_of_arrays;
+          else
+            error ("jsondecode: unidentified type");
         }
       else
-        make_valid_name_params.append (args.slice(i, 2));
+        return decode_kind::mixed_array;
     }
+  else
+    error ("jsondecode: unidentified type");
 
-  octave::make_valid_name_options *options
-    = use_makeValidName ? new octave::make_valid_name_options (make_valid_name_params)
-                        : nullptr;
+  return decode_kind::value;
+}
 
-  octave::unwind_action del_opts ([options] (void) { if (options) delete options; });
+//! Decodes any JSON value.
+//!
+//! The nesting of JSON values is traversed with an explicit stack on the
+//! heap instead of recursive function calls.  Each stack frame holds a
+//! JSON object or array and its decoded elements so far.  When all
+//! elements are decoded, they are combined into the Octave value of the
+//! frame by the functions above.  Thus arbitrarily deep input cannot
+//! overflow the call stack of the Octave process.
+//!
+//! @param val JSON value.
+//! @param options @ref decode_options of this jsondecode call.
+//!
+//! @return @ref octave_value that contains the output of decoding @p val.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! rapidjson::Document d;
+//! d.Parse ("[{\"a\":1,\"b\":2},{\"b\":3,\"a\":4}]");
+//! octave_value value = decode (d, decode_options ());
+//! @endcode
 
-  if (! args(0).is_string ())
-    error ("jsondecode: JSON_TXT must be a character string");
+octave_value
+decode (const rapidjson::Value& val,
+        const decode_options& options)
+{
+  struct frame
+  {
+    frame (const rapidjson::Value& v, decode_kind k)
+      : val (&v), kind (k)
+    {
+      // Only the object and array members of the objects are decoded
+      // into elements, all other members are read by decode_columns.
+      if (kind == decode_kind::object_columns)
+        for (const auto& obj : v.GetArray ())
+          for (const auto& pair : obj.GetObject ())
+            if (pair.value.IsObject () || pair.value.IsArray ())
+              nested.push_back (&pair.value);
 
-  std::string json = args(0).string_value ();
-  rapidjson::Document d;
-  // DOM is chosen instead of SAX as SAX publishes events to a handler that
-  // decides what to do depending on the event only.  This will cause a
-  // problem in decoding JSON arrays as the output may be an array or a cell
-  // and that doesn't only depend on the event (startArray) but also on the
-  // types of the elements inside the array.
-  d.Parse <rapidjson::kParseNanAndInfFlag> (json.c_str ());
+      octave_idx_type n = (kind == decode_kind::object_columns
+                           ? nested.size ()
+                           : v.IsObject () ? v.MemberCount () : v.Size ());
+      elements = Cell (dim_vector (n, 1));
+    }
 
-  if (d.HasParseError ())
-    error ("jsondecode: parse error at offset %u: %s\n",
-           static_cast<unsigned int> (d.GetErrorOffset ()) + 1,
-           rapidjson::GetParseError_En (d.GetParseError ()));
+    //! @return JSON value of the element with index @p i.
 
-  return decode (d, options);
+    const rapidjson::Value& element (octave_idx_type i) const
+    {
+      if (kind == decode_kind::object_columns)
+        return *nested[i];
+      return val->IsObject () ? (val->MemberBegin () + i)->value : (*val)[i];
+    }
 
-#else
+    const rapidjson::Value *val;
+    decode_kind kind;
+    std::vector<const rapidjson::Value *> nested;
+    Cell elements;
+    octave_idx_type next = 0;
+  };
 
-  octave_unused_parameter (args);
+  octave_value retval;
+  decode_kind kind = decode_leaf (val, options, retval);
+  if (kind == decode_kind::value)
+    return retval;
 
-  err_disabled_feature ("jsondecode", "JSON decoding through RapidJSON");
+  std::vector<frame> stack;
+  stack.emplace_back (val, kind);
 
-#endif
-}
+  layout_cache local_layouts;
+  layout_cache& layouts = options.layouts ? *options.layouts : local_layouts;
 
-/*
+  while (true)
+    {
+      frame& top = stack.back ();
+      if (top.next < top.elements.numel ())
+        {
+          const rapidjson::Value& elem = top.element (top.next);
+          kind = decode_leaf (elem, options, retval);
+          if (kind != decode_kind::value)
+            {
+              stack.emplace_back (elem, kind);
+              continue;
+            }
+        }
+      else
+        {
+          switch (top.kind)
+            {
+            case decode_kind::object:
+              retval = decode_object (*top.val, top.elements, options,
+                                      layouts);
+              break;
+            case decode_kind::object_array:
+              retval = decode_object_array (top.elements, options.merge);
+              break;
+            case decode_kind::object_columns:
+              retval = decode_columns (*top.val, top.elements, options,
+                                       layouts);
+              break;
+            case decode_kind::array_of_arrays:
+              retval = decode_array_of_arrays (top.elements);
+              break;
+            default:
+              retval = top.elements;
+              break;
+            }
+
+          stack.pop_back ();
+          if (stack.empty ())
+            return retval;
+        }
+
+      frame& parent = stack.back ();
+      parent.elements(parent.next++) = retval;
+    }
+}
+
+//! Compiled form of the @c Schema option.
+//!
+//! The Octave template value is inspected once and turned into a tree of
+//! @c decode_schema nodes.  Decoding then follows the declared types and
+//! dimensions directly and never has to infer them from the JSON data.
+
+struct decode_schema
+{
+  enum schema_kind
+  {
+    any,            // []:             decode generically
+    scalar,         // numeric or logical scalar
+    string,         // character array
+    vector,         // numeric or logical vector
+    matrix,         // numeric or logical 2-D matrix
+    cell,           // {ELEM} or {}:   Nx1 cell array
+    object,         // scalar struct
+    object_array    // struct array or {STRUCT}: Nx1 struct array
+  };
+
+  schema_kind kind = any;
+
+  //! Octave class of numeric and logical values.
+  builtin_type_t type = btyp_double;
+
+  //! Orientation of vectors.
+  bool row = false;
+
+  //! Number of columns of matrices, zero if not fixed by the template.
+  octave_idx_type columns = 0;
+
+  //! Field names of objects and object arrays.
+  octave_fields fields;
+
+  //! Schemas of the fields of objects and object arrays, or the element
+  //! schema of cell arrays (empty for @c {}).
+  std::vector<decode_schema> members;
+};
+
+//! Converts an Octave template value into a @ref decode_schema.
+//!
+//! @param tmpl Octave value describing the expected JSON data.
+//!
+//! @return @ref decode_schema describing @p tmpl.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! octave_scalar_map tmpl;
+//! tmpl.assign ("id", octave_int32 (0));
+//! tmpl.assign ("name", "");
+//! decode_schema schema = compile_schema (tmpl);
+//! @endcode
+
+decode_schema
+compile_schema (const octave_value& tmpl)
+{
+  decode_schema schema;
+
+  if (tmpl.isstruct ())
+    {
+      octave_map map = tmpl.map_value ();
+      string_vector names = map.fieldnames ();
+      schema.kind = (map.numel () == 1) ? decode_schema::object
+                                        : decode_schema::object_array;
+      schema.fields = octave_fields (names);
+      for (octave_idx_type i = 0; i < names.numel (); ++i)
+        schema.members.push_back (map.numel () > 0
+                                  ? compile_schema (map.contents (i)(0))
+                                  : decode_schema ());
+    }
+  else if (tmpl.iscell ())
+    {
+      Cell cell = tmpl.cell_value ();
+      if (cell.numel () > 1)
+        error ("jsondecode: Schema: cell templates must have at most one "
+               "element");
+      if (cell.numel () == 1)
+        {
+          decode_schema element = compile_schema (cell(0));
+          if (element.kind == decode_schema::object)
+            {
+              // {STRUCT} describes an array of objects, which is decoded
+              // into a struct array like jsondecode does without a schema.
+              element.kind = decode_schema::object_array;
+              return element;
+            }
+          schema.members.push_back (element);
+        }
+      schema.kind = decode_schema::cell;
+    }
+  else if (tmpl.is_string ())
+    schema.kind = decode_schema::string;
+  else if ((tmpl.isnumeric () && tmpl.isreal ()) || tmpl.islogical ())
+    {
+      dim_vector dims = tmpl.dims ();
+      schema.type = tmpl.builtin_type ();
+      if (dims.ndims () > 2)
+        error ("jsondecode: Schema: N-D array templates are not supported");
+
+      if (schema.type == btyp_double && dims(0) == 0 && dims(1) == 0)
+        schema.kind = decode_schema::any;
+      else if (tmpl.numel () == 1)
+        schema.kind = decode_schema::scalar;
+      else if (dims(0) == 1 || dims(1) == 1)
+        {
+          schema.kind = decode_schema::vector;
+          schema.row = (dims(0) == 1);
+        }
+      else
+        {
+          schema.kind = decode_schema::matrix;
+          schema.columns = dims(1);
+        }
+    }
+  else
+    error ("jsondecode: Schema: unsupported template of class '%s'",
+           tmpl.class_name ().c_str ());
+
+  return schema;
+}
+
+//! Location of a JSON value inside the document being decoded.
+//!
+//! The path is a linked list on the stack of the decoding functions and is
+//! only turned into text when a mismatch has to be reported.
+
+struct schema_path
+{
+  const schema_path *parent;
+  const char *key;
+  octave_idx_type index;
+};
+
+//! Formats @p path as JSONPath, e.g. @c $.data[3].name.
+
+std::string
+schema_path_string (const schema_path *path)
+{
+  std::vector<const schema_path *> nodes;
+  for (; path != nullptr; path = path->parent)
+    nodes.push_back (path);
+
+  std::string retval = "$";
+  for (auto it = nodes.rbegin (); it != nodes.rend (); ++it)
+    if ((*it)->key != nullptr)
+      retval += std::string (".") + (*it)->key;
+    else
+      retval += '[' + std::to_string ((*it)->index) + ']';
+
+  return retval;
+}
+
+//! Reports a value of JSON type @p val that does not match @p expected.
+
+OCTAVE_NORETURN void
+err_schema_mismatch (const rapidjson::Value& val, const schema_path *path,
+                     const char *expected)
+{
+  static const char *type_names[] = { "null", "boolean", "boolean", "object",
+                                      "array", "string", "number" };
+
+  error ("jsondecode: Schema mismatch at %s: expected %s, found %s",
+         schema_path_string (path).c_str (), expected,
+         type_names[val.GetType ()]);
+}
+
+//! Reports a JSON number that cannot be stored in the integer class
+//! @p type without rounding or saturation.
+
+OCTAVE_NORETURN void
+err_schema_value (const rapidjson::Value& val, const schema_path *path,
+                  builtin_type_t type)
+{
+  std::string text;
+  if (val.IsInt64 ())
+    text = std::to_string (val.GetInt64 ());
+  else if (val.IsUint64 ())
+    text = std::to_string (val.GetUint64 ());
+  else
+    {
+      char buf[32];
+      std::snprintf (buf, sizeof (buf), "%.17g", val.GetDouble ());
+      text = buf;
+    }
+
+  error ("jsondecode: Schema mismatch at %s: expected %s value, found %s",
+         schema_path_string (path).c_str (), btyp_class_name[type].c_str (),
+         text.c_str ());
+}
+
+//! Decodes a single element of a numeric or logical array declared by a
+//! schema.
+//!
+//! This primary template is used for the integer classes, @p T is an
+//! @c octave_int.  Integers are read with their full 64 bit precision.  JSON
+//! numbers that are not integral or are out of the range of @p T are
+//! reported as mismatch.
+//!
+//! @tparam T element type of the Octave array.
+//!
+//! @param val JSON value.
+//! @param path location of @p val.
+//! @param type Octave class of the schema, for error messages.
+//!
+//! @return @p val converted to @p T.
+
+template <typename T>
+T
+schema_element (const rapidjson::Value& val, const schema_path *path,
+                builtin_type_t type)
+{
+  typedef typename T::val_type int_type;
+  typedef std::numeric_limits<int_type> limits;
+
+  if (val.IsInt64 ())
+    {
+      int64_t i = val.GetInt64 ();
+      if (i < 0)
+        {
+          if (! limits::is_signed
+              || i < static_cast<int64_t> (limits::min ()))
+            err_schema_value (val, path, type);
+        }
+      else if (static_cast<uint64_t> (i)
+               > static_cast<uint64_t> (limits::max ()))
+        err_schema_value (val, path, type);
+      return T (static_cast<int_type> (i));
+    }
+  else if (val.IsUint64 ())
+    {
+      uint64_t u = val.GetUint64 ();
+      if (u > static_cast<uint64_t> (limits::max ()))
+        err_schema_value (val, path, type);
+      return T (static_cast<int_type> (u));
+    }
+  else if (val.IsNumber ())
+    {
+      // Numbers written with a fraction or an exponent, e.g. 1.0 or 1e3.
+      double d = val.GetDouble ();
+      if (d != std::trunc (d)
+          || d < static_cast<double> (limits::min ())
+          || d >= static_cast<double> (limits::max ()) + 1.0)
+        err_schema_value (val, path, type);
+      return T (static_cast<int_type> (d));
+    }
+  else
+    err_schema_mismatch (val, path, "number");
+}
+
+//! JSON null is accepted for floating point classes only.
+
+template <>
+inline double
+schema_element<double> (const rapidjson::Value& val, const schema_path *path,
+                        builtin_type_t)
+{
+  if (val.IsNumber ())
+    return val.GetDouble ();
+  else if (val.IsNull ())
+    return octave_NaN;
+  else
+    err_schema_mismatch (val, path, "number");
+}
+
+template <>
+inline float
+schema_element<float> (const rapidjson::Value& val, const schema_path *path,
+                       builtin_type_t type)
+{
+  return schema_element<double> (val, path, type);
+}
+
+template <>
+inline bool
+schema_element<bool> (const rapidjson::Value& val, const schema_path *path,
+                      builtin_type_t)
+{
+  if (! val.IsBool ())
+    err_schema_mismatch (val, path, "boolean");
+  return val.GetBool ();
+}
+
+//! Decodes a numeric or logical scalar, vector, or matrix declared by a
+//! schema directly into an array of its class.
+//!
+//! @tparam ARRAY Octave array class of the schema, e.g. @c int32NDArray.
+
+template <typename ARRAY>
+octave_value
+schema_array (const rapidjson::Value& val, const decode_schema& schema,
+              const schema_path *path)
+{
+  typedef typename ARRAY::element_type T;
+
+  if (schema.kind == decode_schema::scalar)
+    return ARRAY (dim_vector (1, 1),
+                  schema_element<T> (val, path, schema.type));
+
+  if (! val.IsArray ())
+    err_schema_mismatch (val, path, "array");
+
+  if (schema.kind == decode_schema::vector)
+    {
+      octave_idx_type n = val.Size ();
+      dim_vector dims = schema.row ? dim_vector (1, n) : dim_vector (n, 1);
+      ARRAY array (dims);
+      T *data = array.fortran_vec ();
+      for (octave_idx_type i = 0; i < n; ++i)
+        {
+          schema_path elem_path {path, nullptr, i};
+          data[i] = schema_element<T> (val[i], &elem_path, schema.type);
+        }
+      return array;
+    }
+
+  octave_idx_type rows = val.Size ();
+  octave_idx_type cols = schema.columns;
+  if (rows > 0 && cols == 0 && val[0].IsArray ())
+    cols = val[0].Size ();
+  ARRAY array (dim_vector (rows, cols));
+  T *data = array.fortran_vec ();
+  for (octave_idx_type i = 0; i < rows; ++i)
+    {
+      schema_path row_path {path, nullptr, i};
+      const rapidjson::Value& row = val[i];
+      if (! row.IsArray ())
+        err_schema_mismatch (row, &row_path, "array");
+      if (row.Size () != cols)
+        error ("jsondecode: Schema mismatch at %s: expected %"
+               OCTAVE_IDX_TYPE_FORMAT " elements, found %u",
+               schema_path_string (&row_path).c_str (), cols, row.Size ());
+      for (octave_idx_type j = 0; j < cols; ++j)
+        {
+          schema_path elem_path {&row_path, nullptr, j};
+          data[i + j * rows] = schema_element<T> (row[j], &elem_path,
+                                                  schema.type);
+        }
+    }
+  return array;
+}
+
+//! Dispatches @ref schema_array on the class of the schema.
+
+octave_value
+schema_numeric (const rapidjson::Value& val, const decode_schema& schema,
+                const schema_path *path)
+{
+  switch (schema.type)
+    {
+    case btyp_double:
+      return schema_array<NDArray> (val, schema, path);
+    case btyp_float:
+      return schema_array<FloatNDArray> (val, schema, path);
+    case btyp_bool:
+      return schema_array<boolNDArray> (val, schema, path);
+    case btyp_int8:
+      return schema_array<int8NDArray> (val, schema, path);
+    case btyp_int16:
+      return schema_array<int16NDArray> (val, schema, path);
+    case btyp_int32:
+      return schema_array<int32NDArray> (val, schema, path);
+    case btyp_int64:
+      return schema_array<int64NDArray> (val, schema, path);
+    case btyp_uint8:
+      return schema_array<uint8NDArray> (val, schema, path);
+    case btyp_uint16:
+      return schema_array<uint16NDArray> (val, schema, path);
+    case btyp_uint32:
+      return schema_array<uint32NDArray> (val, schema, path);
+    case btyp_uint64:
+      return schema_array<uint64NDArray> (val, schema, path);
+    default:
+      error ("jsondecode: Schema: unsupported numeric class");
+    }
+}
+
+//! Finds the struct field declared by a schema for the JSON key @p name.
+//!
+//! Keys are looked up verbatim first, so that the common case of keys that
+//! already are valid names skips @c matlab.lang.makeValidName.
+
+octave_idx_type
+schema_field_index (const rapidjson::Value& name, const decode_schema& schema,
+                    const schema_path *path,
+                    const decode_options& options)
+{
+  std::string key = name.GetString ();
+  octave_idx_type idx = schema.fields.getfield (key);
+  if (idx < 0 && options.make_valid_name != nullptr)
+    {
+      std::string varname = key;
+      if (octave::make_valid_name (varname, *options.make_valid_name))
+        idx = schema.fields.getfield (varname);
+    }
+
+  if (idx < 0)
+    error ("jsondecode: Schema mismatch at %s: unexpected key \"%s\"",
+           schema_path_string (path).c_str (), key.c_str ());
+
+  return idx;
+}
+
+//! Reports the first field of an object schema that was not present.
+
+void
+schema_check_fields (const std::vector<bool>& seen,
+                     const decode_schema& schema, const schema_path *path)
+{
+  for (std::size_t i = 0; i < seen.size (); ++i)
+    if (! seen[i])
+      {
+        string_vector names = schema.fields.fieldnames ();
+        error ("jsondecode: Schema mismatch at %s: missing key \"%s\"",
+               schema_path_string (path).c_str (), names(i).c_str ());
+      }
+}
+
+//! Decodes a JSON value into the types and dimensions declared by a schema.
+//!
+//! No type inference is performed: every JSON value is checked against the
+//! schema once while it is converted.  Mismatches are reported together
+//! with their location in the JSON document.
+//!
+//! @param val JSON value.
+//! @param schema @ref decode_schema describing @p val.
+//! @param path location of @p val, @c nullptr for the document root.
+//! @param options @ref decode_options of this jsondecode call.
+//!
+//! @return @ref octave_value that contains the output of decoding @p val.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! rapidjson::Document d;
+//! d.Parse ("[1, 2, 3]");
+//! decode_schema schema = compile_schema (int32NDArray (dim_vector (0, 1)));
+//! octave_value array = decode_with_schema (d, schema, nullptr,
+//!                                          decode_options ());
+//! @endcode
+
+octave_value
+decode_with_schema (const rapidjson::Value& val, const decode_schema& schema,
+                    const schema_path *path,
+                    const decode_options& options)
+{
+  switch (schema.kind)
+    {
+    case decode_schema::any:
+      return decode (val, options);
+
+    case decode_schema::scalar:
+    case decode_schema::vector:
+    case decode_schema::matrix:
+      return schema_numeric (val, schema, path);
+
+    case decode_schema::string:
+      if (! val.IsString ())
+        err_schema_mismatch (val, path, "string");
+      return decode_string (val, options);
+
+    case decode_schema::cell:
+      {
+        if (! val.IsArray ())
+          err_schema_mismatch (val, path, "array");
+        octave_idx_type n = val.Size ();
+        Cell retval (dim_vector (n, 1));
+        for (octave_idx_type i = 0; i < n; ++i)
+          {
+            schema_path elem_path {path, nullptr, i};
+            retval(i) = schema.members.empty ()
+                        ? decode (val[i], options)
+                        : decode_with_schema (val[i], schema.members[0],
+                                              &elem_path, options);
+          }
+        return retval;
+      }
+
+    case decode_schema::object:
+      {
+        if (! val.IsObject ())
+          err_schema_mismatch (val, path, "object");
+        octave_scalar_map retval (schema.fields);
+        std::vector<bool> seen (schema.members.size (), false);
+        for (const auto& pair : val.GetObject ())
+          {
+            octave_idx_type idx = schema_field_index (pair.name, schema,
+                                                      path, options);
+            schema_path member_path {path, pair.name.GetString (), 0};
+            retval.contents (idx) = decode_with_schema (pair.value,
+                                                        schema.members[idx],
+                                                        &member_path,
+                                                        options);
+            seen[idx] = true;
+          }
+        schema_check_fields (seen, schema, path);
+        return retval;
+      }
+
+    case decode_schema::object_array:
+      {
+        if (! val.IsArray ())
+          err_schema_mismatch (val, path, "array");
+        octave_idx_type n = val.Size ();
+        octave_map retval (dim_vector (n, 1), schema.fields);
+        std::vector<bool> seen (schema.members.size ());
+        for (octave_idx_type k = 0; k < n; ++k)
+          {
+            schema_path elem_path {path, nullptr, k};
+            const rapidjson::Value& elem = val[k];
+            if (! elem.IsObject ())
+              err_schema_mismatch (elem, &elem_path, "object");
+            std::fill (seen.begin (), seen.end (), false);
+            for (const auto& pair : elem.GetObject ())
+              {
+                octave_idx_type idx = schema_field_index (pair.name, schema,
+                                                          &elem_path,
+                                                          options);
+                schema_path member_path {&elem_path,
+                                         pair.name.GetString (), 0};
+                retval.contents (idx)(k)
+                  = decode_with_schema (pair.value, schema.members[idx],
+                                        &member_path, options);
+                seen[idx] = true;
+              }
+            schema_check_fields (seen, schema, &elem_path);
+          }
+        return retval;
+      }
+    }
+
+  error ("jsondecode: unidentified type");
+}
+
+//! Base class of the readers for CBOR and MessagePack.
+//!
+//! A reader is a generator for @c rapidjson::Document::Populate: it emits
+//! the same handler events as RapidJSON's parser would for the equivalent
+//! JSON text.  The decode functions then see exactly the same DOM, so
+//! binary input yields exactly the same Octave values as JSON text.
+//!
+//! Nested arrays and maps are tracked on an explicit stack instead of by
+//! recursion, so deeply nested input cannot overflow the call stack.
+//!
+//! @tparam DERIVED format specific reader, which implements
+//!                 @c read (handler, is_key).
+
+template <typename DERIVED>
+class binary_reader
+{
+public:
+
+  binary_reader (const uint8_t *data, std::size_t size)
+    : m_data (data), m_size (size)
+  { }
+
+  //! Emits the handler events for one data item, which has to span all
+  //! input bytes.
+  //!
+  //! @return @c false on malformed input, see @ref error_message.
+
+  template <typename Handler>
+  bool operator () (Handler& handler)
+  {
+    std::vector<frame> stack;
+
+    for (;;)
+      {
+        frame *top = stack.empty () ? nullptr : &stack.back ();
+        bool is_key = (top != nullptr && top->is_map && top->key_next);
+        m_in_map = (top != nullptr && top->is_map);
+
+        item it = static_cast<DERIVED *> (this)->read (handler, is_key);
+
+        if (it.kind == item::invalid)
+          return false;
+        else if (it.kind == item::stop)
+          {
+            if (top == nullptr || ! top->indefinite
+                || (top->is_map && ! top->key_next))
+              {
+                m_error = "unexpected break";
+                return false;
+              }
+            close (handler, stack);
+          }
+        else if (is_key)
+          {
+            top->key_next = false;
+            continue;
+          }
+        else if (it.kind == item::array || it.kind == item::map)
+          {
+            bool is_map = (it.kind == item::map);
+            if (is_map)
+              handler.StartObject ();
+            else
+              handler.StartArray ();
+
+            if (it.indefinite || it.length > 0)
+              {
+                // Every element takes at least one byte.
+                if (! it.indefinite && it.length > m_size - m_pos)
+                  {
+                    m_error = "unexpected end of data";
+                    return false;
+                  }
+                stack.push_back ({it.length, 0, is_map, it.indefinite, true});
+                continue;
+              }
+
+            if (is_map)
+              handler.EndObject (0);
+            else
+              handler.EndArray (0);
+          }
+
+        // A value has been completed.  Count it and close all containers
+        // that are complete now.
+        while (! stack.empty ())
+          {
+            frame& f = stack.back ();
+            f.count++;
+            f.key_next = true;
+            if (f.indefinite || f.count < f.length)
+              break;
+            close (handler, stack);
+          }
+
+        if (stack.empty ())
+          {
+            if (m_pos != m_size)
+              {
+                m_error = "trailing data after the top-level item";
+                return false;
+              }
+            return true;
+          }
+      }
+  }
+
+  //! @return description of the error if the input was malformed.
+
+  const std::string& error_message (void) const { return m_error; }
+
+  //! @return byte offset of the error if the input was malformed.
+
+  std::size_t error_offset (void) const { return m_pos; }
+
+protected:
+
+  //! Result of reading one item by the format specific reader.  Scalars
+  //! and keys are emitted by the format specific reader, containers by
+  //! @ref operator().
+
+  struct item
+  {
+    enum kind_t { scalar, array, map, stop, invalid };
+
+    kind_t kind;
+    uint64_t length;
+    bool indefinite;
+  };
+
+  struct frame
+  {
+    uint64_t length;
+    rapidjson::SizeType count;
+    bool is_map;
+    bool indefinite;
+    bool key_next;
+  };
+
+  template <typename Handler>
+  void close (Handler& handler, std::vector<frame>& stack)
+  {
+    frame f = stack.back ();
+    stack.pop_back ();
+    if (f.is_map)
+      handler.EndObject (f.count);
+    else
+      handler.EndArray (f.count);
+  }
+
+  item fail (const std::string& msg)
+  {
+    m_error = msg;
+    return {item::invalid, 0, false};
+  }
+
+  static item scalar (void) { return {item::scalar, 0, false}; }
+
+  bool need (std::size_t n)
+  {
+    if (n > m_size - m_pos)
+      {
+        m_error = "unexpected end of data";
+        return false;
+      }
+    return true;
+  }
+
+  //! Reads an unsigned big-endian integer of @p nbytes bytes.
+
+  uint64_t get_be (int nbytes)
+  {
+    uint64_t x = 0;
+    for (int i = 0; i < nbytes; ++i)
+      x = (x << 8) | m_data[m_pos++];
+    return x;
+  }
+
+  const uint8_t *m_data;
+  std::size_t m_size;
+  std::size_t m_pos = 0;
+  std::string m_error;
+
+  //! Whether the item that is read is a key or value of a map.
+  bool m_in_map = false;
+};
+
+//! Emits the handler events for the elements of a byte string, which
+//! JSON does not know, as array of numbers.
+
+template <typename Handler> void
+emit_byte_array (Handler& handler, const uint8_t *bytes, std::size_t len)
+{
+  handler.StartArray ();
+  for (std::size_t i = 0; i < len; ++i)
+    handler.Uint (bytes[i]);
+  handler.EndArray (len);
+}
+
+//! Reader for the Concise Binary Object Representation (CBOR, RFC 8949).
+//!
+//! Typed arrays (RFC 8746, tags 64 to 87 except 76) become arrays of
+//! numbers, all other tags are ignored.  If a table of typed arrays is
+//! given, non-empty typed arrays that are not map values are recorded in
+//! it instead.  They become strings that point to their payload, which
+//! @ref decode_leaf decodes with @ref decode_typed_array.  All other
+//! strings are copied into the document, so they cannot be mistaken for
+//! typed arrays.
+
+class cbor_reader : public binary_reader<cbor_reader>
+{
+public:
+
+  cbor_reader (const uint8_t *data, std::size_t size,
+               typed_array_table *typed_arrays = nullptr)
+    : binary_reader<cbor_reader> (data, size), m_typed_arrays (typed_arrays)
+  { }
+
+  template <typename Handler>
+  item read (Handler& handler, bool is_key)
+  {
+    for (;;)
+      {
+        if (! need (1))
+          return {item::invalid, 0, false};
+
+        uint8_t initial = m_data[m_pos++];
+        uint8_t major = initial >> 5;
+        uint8_t info = initial & 0x1f;
+
+        if (initial == 0xff)
+          return {item::stop, 0, false};
+
+        uint64_t arg = 0;
+        bool indefinite = false;
+        if (major == 7)
+          ;  // Simple values and floats are handled below.
+        else if (info < 24)
+          arg = info;
+        else if (info <= 27)
+          {
+            int nbytes = 1 << (info - 24);
+            if (! need (nbytes))
+              return {item::invalid, 0, false};
+            arg = get_be (nbytes);
+          }
+        else if (info == 31 && major >= 2 && major <= 5)
+          indefinite = true;
+        else
+          return fail ("invalid additional information");
+
+        if (is_key && major != 3)
+          return fail ("map keys must be text strings");
+
+        switch (major)
+          {
+          case 0:
+            handler.Uint64 (arg);
+            return scalar ();
+
+          case 1:
+            if (arg <= static_cast<uint64_t> (INT64_MAX))
+              handler.Int64 (-1 - static_cast<int64_t> (arg));
+            else
+              handler.Double (-1.0 - static_cast<double> (arg));
+            return scalar ();
+
+          case 2:
+          case 3:
+            {
+              std::string str;
+              if (! read_string (major, arg, indefinite, str))
+                return {item::invalid, 0, false};
+              rapidjson::SizeType len = str.size ();
+              if (major == 2)
+                emit_byte_array (handler,
+                                 reinterpret_cast<const uint8_t *> (str.data ()),
+                                 len);
+              else if (is_key)
+                handler.Key (str.data (), len, true);
+              else
+                handler.String (str.data (), len, true);
+              return scalar ();
+            }
+
+          case 4:
+            return {item::array, arg, indefinite};
+
+          case 5:
+            return {item::map, arg, indefinite};
+
+          case 6:
+            if (arg >= 64 && arg <= 87 && arg != 76)
+              return read_typed_array (handler, arg);
+            // Other tags carry no information for JSON, decode the
+            // tagged item.
+            continue;
+
+          default:
+            return read_simple (handler, info);
+          }
+      }
+  }
+
+private:
+
+  //! Reads the (possibly chunked) content of a byte or text string.
+
+  bool read_string (uint8_t major, uint64_t len, bool indefinite,
+                    std::string& str)
+  {
+    if (! indefinite)
+      {
+        if (! need (len))
+          return false;
+        str.assign (reinterpret_cast<const char *> (m_data + m_pos), len);
+        m_pos += len;
+        return true;
+      }
+
+    for (;;)
+      {
+        if (! need (1))
+          return false;
+        uint8_t initial = m_data[m_pos++];
+        if (initial == 0xff)
+          return true;
+        uint8_t info = initial & 0x1f;
+        if ((initial >> 5) != major || info > 27 || info == 31)
+          {
+            fail ("invalid chunk of indefinite-length string");
+            return false;
+          }
+        uint64_t chunk = info;
+        if (info >= 24)
+          {
+            int nbytes = 1 << (info - 24);
+            if (! need (nbytes))
+              return false;
+            chunk = get_be (nbytes);
+          }
+        if (! need (chunk))
+          return false;
+        str.append (reinterpret_cast<const char *> (m_data + m_pos), chunk);
+        m_pos += chunk;
+      }
+  }
+
+  template <typename Handler>
+  item read_simple (Handler& handler, uint8_t info)
+  {
+    switch (info)
+      {
+      case 20:
+        handler.Bool (false);
+        return scalar ();
+      case 21:
+        handler.Bool (true);
+        return scalar ();
+      case 22:
+      case 23:
+        handler.Null ();
+        return scalar ();
+      case 25:
+        if (! need (2))
+          return {item::invalid, 0, false};
+        handler.Double (half_to_double (get_be (2)));
+        return scalar ();
+      case 26:
+        {
+          if (! need (4))
+            return {item::invalid, 0, false};
+          uint32_t bits = get_be (4);
+          float f;
+          std::memcpy (&f, &bits, sizeof (f));
+          handler.Double (f);
+          return scalar ();
+        }
+      case 27:
+        {
+          if (! need (8))
+            return {item::invalid, 0, false};
+          uint64_t bits = get_be (8);
+          double d;
+          std::memcpy (&d, &bits, sizeof (d));
+          handler.Double (d);
+          return scalar ();
+        }
+      default:
+        return fail ("unsupported simple value");
+      }
+  }
+
+  //! Reads the byte string of a typed array with tag @p tag.
+  //!
+  //! The tag encodes (RFC 8746, Section 2.1) whether the elements are
+  //! floats (f), signed (s), little endian (e), and their size (ll).
+  //! Typed arrays that are recorded in the table of typed arrays are
+  //! emitted as a string that points to their payload.  Otherwise, the
+  //! elements of float64 arrays in the byte order of this machine are
+  //! copied from the payload as they are emitted, all other elements are
+  //! assembled byte by byte.
+
+  template <typename Handler>
+  item read_typed_array (Handler& handler, uint64_t tag)
+  {
+    if (! need (1))
+      return {item::invalid, 0, false};
+    uint8_t initial = m_data[m_pos++];
+    uint8_t info = initial & 0x1f;
+    if ((initial >> 5) != 2 || info > 27)
+      return fail ("typed arrays must be definite-length byte strings");
+    uint64_t len = info;
+    if (info >= 24)
+      {
+        int nbytes = 1 << (info - 24);
+        if (! need (nbytes))
+          return {item::invalid, 0, false};
+        len = get_be (nbytes);
+      }
+    if (! need (len))
+      return {item::invalid, 0, false};
+
+    bool is_float = tag & 0x10;
+    bool is_signed = tag & 0x08;
+    int ll = tag & 0x03;
+    // For 8-bit integers the e bit means "clamped", not the byte order.
+    bool little_endian = (tag & 0x04) && (is_float || ll > 0);
+    std::size_t elem_size = is_float ? (2 << ll) : (1 << ll);
+    if (is_float && ll == 3)
+      return fail ("float128 typed arrays are not supported");
+    if (len % elem_size)
+      return fail ("typed array length is not a multiple of its element size");
+
+    const uint8_t *bytes = m_data + m_pos;
+    std::size_t n = len / elem_size;
+    m_pos += len;
+
+    if (m_typed_arrays && ! m_in_map && n > 0)
+      {
+        const char *payload = reinterpret_cast<const char *> (bytes);
+        (*m_typed_arrays)[payload] = {bytes, n, static_cast<uint8_t> (tag)};
+        handler.String (payload, 0, false);
+        return scalar ();
+      }
+
+    static const bool big_endian = octave::mach_info::words_big_endian ();
+
+    handler.StartArray ();
+    if (is_float && elem_size == 8 && little_endian != big_endian)
+      {
+        for (std::size_t i = 0; i < n; ++i)
+          {
+            double d;
+            std::memcpy (&d, bytes + i * sizeof (d), sizeof (d));
+            handler.Double (d);
+          }
+      }
+    else
+      for (std::size_t i = 0; i < n; ++i)
+        {
+          const uint8_t *elem = bytes + i * elem_size;
+          uint64_t bits = 0;
+          for (std::size_t k = 0; k < elem_size; ++k)
+            bits = (bits << 8) | elem[little_endian ? elem_size - 1 - k : k];
+
+          if (is_float)
+            {
+              if (elem_size == 2)
+                handler.Double (half_to_double (bits));
+              else if (elem_size == 4)
+                {
+                  uint32_t bits32 = bits;
+                  float f;
+                  std::memcpy (&f, &bits32, sizeof (f));
+                  handler.Double (f);
+                }
+              else
+                {
+                  double d;
+                  std::memcpy (&d, &bits, sizeof (d));
+                  handler.Double (d);
+                }
+            }
+          else if (is_signed)
+            {
+              // Sign-extend the element to 64 bits.
+              int shift = 64 - 8 * elem_size;
+              handler.Int64 (static_cast<int64_t> (bits << shift) >> shift);
+            }
+          else
+            handler.Uint64 (bits);
+        }
+    handler.EndArray (n);
+
+    return scalar ();
+  }
+
+  typed_array_table *m_typed_arrays;
+};
+
+//! Reader for MessagePack.  Extension types are not supported.
+
+class msgpack_reader : public binary_reader<msgpack_reader>
+{
+public:
+
+  msgpack_reader (const uint8_t *data, std::size_t size)
+    : binary_reader<msgpack_reader> (data, size)
+  { }
+
+  template <typename Handler>
+  item read (Handler& handler, bool is_key)
+  {
+    if (! need (1))
+      return {item::invalid, 0, false};
+
+    uint8_t type = m_data[m_pos++];
+
+    // Strings: fixstr, str8, str16, str32
+    if ((type & 0xe0) == 0xa0 || (type >= 0xd9 && type <= 0xdb))
+      {
+        uint64_t len = ((type & 0xe0) == 0xa0) ? (type & 0x1f) : 0;
+        if (type >= 0xd9)
+          {
+            int nbytes = 1 << (type - 0xd9);
+            if (! need (nbytes))
+              return {item::invalid, 0, false};
+            len = get_be (nbytes);
+          }
+        if (! need (len))
+          return {item::invalid, 0, false};
+        const char *str = reinterpret_cast<const char *> (m_data + m_pos);
+        m_pos += len;
+        if (is_key)
+          handler.Key (str, len, true);
+        else
+          handler.String (str, len, true);
+        return scalar ();
+      }
+
+    if (is_key)
+      return fail ("map keys must be strings");
+
+    if (type < 0x80)
+      {
+        handler.Uint (type);
+        return scalar ();
+      }
+    else if (type >= 0xe0)
+      {
+        handler.Int (static_cast<int8_t> (type));
+        return scalar ();
+      }
+    else if (type < 0x90)
+      return {item::map, static_cast<uint64_t> (type & 0x0f), false};
+    else if (type < 0xa0)
+      return {item::array, static_cast<uint64_t> (type & 0x0f), false};
+
+    switch (type)
+      {
+      case 0xc0:
+        handler.Null ();
+        return scalar ();
+      case 0xc2:
+        handler.Bool (false);
+        return scalar ();
+      case 0xc3:
+        handler.Bool (true);
+        return scalar ();
+
+      case 0xc4:  // bin 8
+      case 0xc5:  // bin 16
+      case 0xc6:  // bin 32
+        {
+          int nbytes = 1 << (type - 0xc4);
+          if (! need (nbytes))
+            return {item::invalid, 0, false};
+          uint64_t len = get_be (nbytes);
+          if (! need (len))
+            return {item::invalid, 0, false};
+          emit_byte_array (handler, m_data + m_pos, len);
+          m_pos += len;
+          return scalar ();
+        }
+
+      case 0xca:
+        {
+          if (! need (4))
+            return {item::invalid, 0, false};
+          uint32_t bits = get_be (4);
+          float f;
+          std::memcpy (&f, &bits, sizeof (f));
+          handler.Double (f);
+          return scalar ();
+        }
+      case 0xcb:
+        {
+          if (! need (8))
+            return {item::invalid, 0, false};
+          uint64_t bits = get_be (8);
+          double d;
+          std::memcpy (&d, &bits, sizeof (d));
+          handler.Double (d);
+          return scalar ();
+        }
+
+      case 0xcc:  // uint 8
+      case 0xcd:  // uint 16
+      case 0xce:  // uint 32
+      case 0xcf:  // uint 64
+        {
+          int nbytes = 1 << (type - 0xcc);
+          if (! need (nbytes))
+            return {item::invalid, 0, false};
+          handler.Uint64 (get_be (nbytes));
+          return scalar ();
+        }
+
+      case 0xd0:  // int 8
+      case 0xd1:  // int 16
+      case 0xd2:  // int 32
+      case 0xd3:  // int 64
+        {
+          int nbytes = 1 << (type - 0xd0);
+          if (! need (nbytes))
+            return {item::invalid, 0, false};
+          int shift = 64 - 8 * nbytes;
+          handler.Int64 (static_cast<int64_t> (get_be (nbytes) << shift)
+                         >> shift);
+          return scalar ();
+        }
+
+      case 0xdc:  // array 16
+      case 0xdd:  // array 32
+      case 0xde:  // map 16
+      case 0xdf:  // map 32
+        {
+          int nbytes = (type & 0x01) ? 4 : 2;
+          if (! need (nbytes))
+            return {item::invalid, 0, false};
+          uint64_t len = get_be (nbytes);
+          return {type < 0xde ? item::array : item::map, len, false};
+        }
+
+      default:
+        return fail ("unsupported type");
+      }
+  }
+};
+
+//! Parses CBOR or MessagePack data into a RapidJSON document.
+//!
+//! @param d document to populate.
+//! @param data binary data.
+//! @param size number of bytes of @p data.
+//! @param format either @c "cbor" or @c "msgpack".
+//! @param typed_arrays table of the CBOR typed arrays that are decoded
+//!                     from their payload, see @ref cbor_reader, or
+//!                     @c nullptr.  They refer to @p data.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! const uint8_t cbor[] = {0x82, 0x01, 0x02};
+//! rapidjson::Document d;
+//! parse_binary (d, cbor, sizeof (cbor), "cbor");
+//! @endcode
+
+void
+parse_binary (rapidjson::Document& d, const uint8_t *data, std::size_t size,
+              const std::string& format,
+              typed_array_table *typed_arrays = nullptr)
+{
+  std::string msg;
+  std::size_t offset;
+  if (format == "cbor")
+    {
+      cbor_reader reader (data, size, typed_arrays);
+      d.Populate (reader);
+      msg = reader.error_message ();
+      offset = reader.error_offset ();
+    }
+  else
+    {
+      msgpack_reader reader (data, size);
+      d.Populate (reader);
+      msg = reader.error_message ();
+      offset = reader.error_offset ();
+    }
+
+  if (! msg.empty ())
+    error ("jsondecode: %s parse error at offset %" OCTAVE_IDX_TYPE_FORMAT
+           ": %s\n", format == "cbor" ? "CBOR" : "MessagePack",
+           static_cast<octave_idx_type> (offset) + 1, msg.c_str ());
+}
+
+//! Parsing modes of JSON numbers (@c "NumberParsing" option).
+
+enum class number_parsing
+{
+  fast,   // RapidJSON's default, may be off by a few units in the last place
+  exact,  // correctly rounded (kParseFullPrecisionFlag)
+  raw     // numbers are kept as strings (kParseNumbersAsStringsFlag)
+};
+
+//! Options of a jsondecode call, parsed once from its arguments.
+
+struct jsondecode_settings
+{
+  jsondecode_settings (const octave_value_list& args, int first);
+
+  //! @return options for the decode functions, valid as long as this
+  //! object.
+
+  decode_options options (void) const
+  {
+    decode_options retval;
+    retval.make_valid_name = use_make_valid_name ? &make_valid_name : nullptr;
+    retval.base64_arrays = base64_arrays;
+    retval.compact_sparse = compact_sparse;
+    retval.object_columns = object_columns;
+    retval.merge = merge;
+    return retval;
+  }
+
+  bool use_make_valid_name = true;
+  octave::make_valid_name_options make_valid_name;
+  bool has_schema = false;
+  decode_schema schema;
+  std::string format = "json";
+  number_parsing numbers = number_parsing::fast;
+  bool base64_arrays = false;
+  bool compact_sparse = false;
+  bool object_columns = false;
+  object_merge merge = object_merge::ordered;
+  bool intern_strings = false;
+  bool validate_utf8 = false;
+  bool lazy = false;
+  int threads = 1;
+};
+
+//! Parses the option pairs of a jsondecode call.
+//!
+//! @param args arguments of the call.
+//! @param first index of the first option name in @p args.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! jsondecode_settings settings (ovl ("{}", "makeValidName", false), 1);
+//! @endcode
+
+jsondecode_settings::jsondecode_settings (const octave_value_list& args,
+                                          int first)
+{
+  octave_value_list make_valid_name_params;
+  for (auto i = first; i < args.length (); i = i + 2)
+    {
+      std::string parameter = args(i).xstring_value ("jsondecode: "
+        "option argument must be a string");
+      if (octave::string::strcmpi (parameter, "makeValidName"))
+        {
+          use_make_valid_name = args(i + 1).xbool_value ("jsondecode: "
+            "'makeValidName' value must be a bool");
+        }
+      else if (octave::string::strcmpi (parameter, "Schema"))
+        {
+          schema = compile_schema (args(i + 1));
+          has_schema = true;
+        }
+      else if (octave::string::strcmpi (parameter, "Threads"))
+        {
+          threads = args(i + 1).xint_value ("jsondecode: "
+            "'Threads' value must be an integer");
+          if (threads < 1)
+            error ("jsondecode: 'Threads' must be a positive integer");
+        }
+      else if (octave::string::strcmpi (parameter, "ValidateUTF8"))
+        {
+          validate_utf8 = args(i + 1).xbool_value ("jsondecode: "
+            "'ValidateUTF8' value must be a bool");
+        }
+      else if (octave::string::strcmpi (parameter, "InternStrings"))
+        {
+          intern_strings = args(i + 1).xbool_value ("jsondecode: "
+            "'InternStrings' value must be a bool");
+        }
+      else if (octave::string::strcmpi (parameter, "Lazy"))
+        {
+          lazy = args(i + 1).xbool_value ("jsondecode: "
+            "'Lazy' value must be a bool");
+        }
+      else if (octave::string::strcmpi (parameter, "NumericEncoding"))
+        {
+          std::string encoding = args(i + 1).xstring_value ("jsondecode: "
+            "'NumericEncoding' value must be a string");
+          if (octave::string::strcmpi (encoding, "base64"))
+            base64_arrays = true;
+          else if (octave::string::strcmpi (encoding, "text"))
+            base64_arrays = false;
+          else
+            error ("jsondecode: "
+                   R"('NumericEncoding' must be "text" or "base64")");
+        }
+      else if (octave::string::strcmpi (parameter, "SparseEncoding"))
+        {
+          std::string encoding = args(i + 1).xstring_value ("jsondecode: "
+            "'SparseEncoding' value must be a string");
+          if (octave::string::strcmpi (encoding, "compact"))
+            compact_sparse = true;
+          else if (octave::string::strcmpi (encoding, "dense"))
+            compact_sparse = false;
+          else
+            error ("jsondecode: "
+                   R"('SparseEncoding' must be "dense" or "compact")");
+        }
+      else if (octave::string::strcmpi (parameter, "ArrayOfObjects"))
+        {
+          std::string layout = args(i + 1).xstring_value ("jsondecode: "
+            "'ArrayOfObjects' value must be a string");
+          if (octave::string::strcmpi (layout, "columns"))
+            object_columns = true;
+          else if (octave::string::strcmpi (layout, "structs"))
+            object_columns = false;
+          else
+            error ("jsondecode: "
+                   R"('ArrayOfObjects' must be "structs" or "columns")");
+        }
+      else if (octave::string::strcmpi (parameter, "MergeObjects"))
+        {
+          std::string mode = args(i + 1).xstring_value ("jsondecode: "
+            "'MergeObjects' value must be a string");
+          if (octave::string::strcmpi (mode, "ordered"))
+            merge = object_merge::ordered;
+          else if (octave::string::strcmpi (mode, "unordered"))
+            merge = object_merge::unordered;
+          else if (octave::string::strcmpi (mode, "fill"))
+            merge = object_merge::fill;
+          else
+            error ("jsondecode: "
+                   R"('MergeObjects' must be "ordered", "unordered", )"
+                   R"(or "fill")");
+        }
+      else if (octave::string::strcmpi (parameter, "NumberParsing"))
+        {
+          std::string mode = args(i + 1).xstring_value ("jsondecode: "
+            "'NumberParsing' value must be a string");
+          if (octave::string::strcmpi (mode, "fast"))
+            numbers = number_parsing::fast;
+          else if (octave::string::strcmpi (mode, "exact"))
+            numbers = number_parsing::exact;
+          else if (octave::string::strcmpi (mode, "raw"))
+            numbers = number_parsing::raw;
+          else
+            error ("jsondecode: "
+                   R"('NumberParsing' must be "fast", "exact", or "raw")");
+        }
+      else if (octave::string::strcmpi (parameter, "Format"))
+        {
+          format = args(i + 1).xstring_value ("jsondecode: "
+            "'Format' value must be a string");
+          std::transform (format.begin (), format.end (), format.begin (),
+                          ::tolower);
+          if (format != "json" && format != "cbor" && format != "msgpack")
+            error ("jsondecode: "
+                   R"('Format' must be "json", "cbor", or "msgpack")");
+        }
+      else
+        make_valid_name_params.append (args.slice(i, 2));
+    }
+
+  if (use_make_valid_name)
+    make_valid_name = octave::make_valid_name_options (make_valid_name_params);
+
+  if (lazy && has_schema)
+    error ("jsondecode: the 'Lazy' and 'Schema' options cannot be combined");
+}
+
+//! Parses JSON text into a RapidJSON document without reporting errors.
+//!
+//! This function does not call into Octave and may run in worker threads.
+//! Errors are left in @p d for the caller.
+//!
+//! @param d document to populate.
+//! @param json JSON text.
+//! @param len number of characters of @p json.
+//! @param numbers parsing mode of numbers.
+
+void
+parse_json_text (rapidjson::Document& d, const char *json, std::size_t len,
+                 number_parsing numbers)
+{
+  // The iterative parser keeps its state on the heap, deeply nested input
+  // cannot overflow the call stack.
+  const unsigned flags = rapidjson::kParseNanAndInfFlag
+                         | rapidjson::kParseIterativeFlag;
+
+  switch (numbers)
+    {
+    case number_parsing::exact:
+      d.Parse <flags | rapidjson::kParseFullPrecisionFlag> (json, len);
+      break;
+    case number_parsing::raw:
+      d.Parse <flags | rapidjson::kParseNumbersAsStringsFlag> (json, len);
+      break;
+    default:
+      d.Parse <flags> (json, len);
+      break;
+    }
+}
+
+//! Parses JSON text from a stream into a RapidJSON document without
+//! reporting errors.
+//!
+//! Like @ref parse_json_text, this function does not call into Octave and
+//! may run in worker threads.  Invalid UTF-8 in strings is detected by
+//! RapidJSON while parsing, see @ref stream_error.
+//!
+//! @param d document to populate.
+//! @param is RapidJSON input stream, e.g. a @ref json_file_reader.
+//! @param numbers parsing mode of numbers.
+//! @param validate_utf8 @c true to validate the UTF-8 encoding of strings.
+
+template <typename Stream> void
+parse_json_stream (rapidjson::Document& d, Stream& is, number_parsing numbers,
+                   bool validate_utf8)
+{
+  const unsigned flags = rapidjson::kParseNanAndInfFlag
+                         | rapidjson::kParseIterativeFlag;
+  const unsigned validate = rapidjson::kParseValidateEncodingFlag;
+
+  switch (numbers)
+    {
+    case number_parsing::exact:
+      if (validate_utf8)
+        d.ParseStream <flags | validate
+                       | rapidjson::kParseFullPrecisionFlag> (is);
+      else
+        d.ParseStream <flags | rapidjson::kParseFullPrecisionFlag> (is);
+      break;
+    case number_parsing::raw:
+      if (validate_utf8)
+        d.ParseStream <flags | validate
+                       | rapidjson::kParseNumbersAsStringsFlag> (is);
+      else
+        d.ParseStream <flags | rapidjson::kParseNumbersAsStringsFlag> (is);
+      break;
+    default:
+      if (validate_utf8)
+        d.ParseStream <flags | validate> (is);
+      else
+        d.ParseStream <flags> (is);
+      break;
+    }
+}
+
+//! Describes the first error of parsing a JSON file.
+//!
+//! Errors of reading the file take precedence, as they end the input and
+//! thereby cause a parse error as well.  This function does not call into
+//! Octave.
+//!
+//! @param file stream that was parsed.
+//! @param d document that was populated from @p file.
+//!
+//! @return empty string, or an error message without the function name.
+
+std::string
+stream_error (const json_file_reader& file, const rapidjson::Document& d)
+{
+  if (! file.error ().empty ())
+    return file.error ();
+
+  if (! d.HasParseError ())
+    return "";
+
+  std::string offset = std::to_string (d.GetErrorOffset () + 1);
+  if (d.GetParseError () == rapidjson::kParseErrorStringInvalidEncoding)
+    return "invalid UTF-8 at offset " + offset;
+
+  return "parse error at offset " + offset + ": "
+         + rapidjson::GetParseError_En (d.GetParseError ());
+}
+
+//! Parses JSON text into a RapidJSON document.
+//!
+//! @param d document to populate.
+//! @param json JSON text.
+//! @param len number of characters of @p json.
+//! @param settings parsed options of the jsondecode call.
+//! @param offset position of @p json in a larger input, only used for
+//! error messages.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! rapidjson::Document d;
+//! parse_json (d, "[1, 2]", 6, jsondecode_settings (ovl (), 0));
+//! @endcode
+
+void
+parse_json (rapidjson::Document& d, const char *json, std::size_t len,
+            const jsondecode_settings& settings, std::size_t offset = 0)
+{
+  if (settings.validate_utf8)
+    {
+      std::size_t pos = find_invalid_utf8 (json, len);
+      if (pos != len)
+        error ("jsondecode: invalid UTF-8 at offset %"
+               OCTAVE_IDX_TYPE_FORMAT,
+               static_cast<octave_idx_type> (offset + pos) + 1);
+    }
+
+  parse_json_text (d, json, len, settings.numbers);
+
+  if (d.HasParseError ())
+    error ("jsondecode: parse error at offset %" OCTAVE_IDX_TYPE_FORMAT
+           ": %s\n",
+           static_cast<octave_idx_type> (offset + d.GetErrorOffset ()) + 1,
+           rapidjson::GetParseError_En (d.GetParseError ()));
+}
+
+//! Decodes a parsed JSON document according to the options of a
+//! jsondecode call.
+//!
+//! @param val JSON value to decode.
+//! @param settings parsed options of the jsondecode call.
+//!
+//! @return @ref octave_value that contains the output of decoding @p val.
+
+octave_value
+decode_document (const rapidjson::Value& val,
+                 const jsondecode_settings& settings,
+                 const decode_options& options)
+{
+  if (settings.has_schema)
+    return decode_with_schema (val, settings.schema, nullptr, options);
+
+  return decode (val, options);
+}
+
+octave_value
+decode_document (const rapidjson::Value& val,
+                 const jsondecode_settings& settings,
+                 const typed_array_table *typed_arrays = nullptr)
+{
+  decode_options options = settings.options ();
+  options.typed_arrays = typed_arrays;
+  string_table strings;
+  if (settings.intern_strings)
+    options.strings = &strings;
+
+  return decode_document (val, settings, options);
+}
+
+//! Upper limit of the bookkeeping that a RapidJSON pool allocator keeps at
+//! the start of its user buffer.
+
+const std::size_t pool_bookkeeping = 1024;
+
+//! Text of one element of a batch, which is not copied.
+
+struct json_text
+{
+  const char *data;
+  std::size_t size;
+};
+
+//! Parser state of one JSON text of a batch.
+//!
+//! The allocator of the document takes its memory from the buffer of the
+//! slot, which is kept between the texts that are parsed into the same
+//! slot.  If a text needs more memory, the buffer grows to that size before
+//! the next text, so that small documents need no memory allocation.  The
+//! buffers only live as long as the batch.
+
+class batch_slot
+{
+public:
+
+  //! Initial size of the buffer.
+  static const std::size_t min_size = 4096;
+
+  batch_slot (void) = default;
+
+  // No copying!
+
+  batch_slot (const batch_slot&) = delete;
+
+  batch_slot& operator = (const batch_slot&) = delete;
+
+  //! @return an empty document for the next text.
+
+  rapidjson::Document& reset (void)
+  {
+    std::size_t size = m_buffer.size ();
+    if (size == 0)
+      size = min_size;
+    else if (m_allocator && m_allocator->Capacity () > m_buffer.size ())
+      size = m_allocator->Capacity () + pool_bookkeeping;
+
+    // The document and the allocator use the buffer, they are destroyed
+    // before it is replaced.
+    m_document.reset ();
+    m_allocator.reset ();
+    if (size > m_buffer.size ())
+      std::vector<char> (size).swap (m_buffer);
+
+    m_allocator.reset (new rapidjson::MemoryPoolAllocator<>
+                         (m_buffer.data (), m_buffer.size ()));
+    m_document.reset (new rapidjson::Document (m_allocator.get ()));
+    return *m_document;
+  }
+
+  const rapidjson::Document& document (void) const { return *m_document; }
+
+private:
+
+  std::vector<char> m_buffer;
+  std::unique_ptr<rapidjson::MemoryPoolAllocator<>> m_allocator;
+  std::unique_ptr<rapidjson::Document> m_document;
+};
+
+//! Decodes JSON texts into a cell array of the decoded values.
+//!
+//! The texts are processed in blocks.  All texts of a block are parsed
+//! first, optionally by several worker threads, then decoded one after the
+//! other by the calling thread, as Octave values must not be created
+//! concurrently.  Object layouts and interned strings are shared by all
+//! texts.
+//!
+//! @param texts JSON texts, which are parsed where they are.
+//! @param dims dimensions of the output, with as many elements as
+//! @p texts.
+//! @param settings parsed options of the jsondecode call.
+//!
+//! @return cell array of the decoded values with the dimensions @p dims,
+//! or a struct array if all values are scalar structs with the same fields.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! jsondecode_settings settings (ovl (), 0);
+//! std::vector<json_text> texts {{"{\"a\":1}", 7}, {"{\"a\":2}", 7}};
+//! octave_value s = decode_batch (texts, dim_vector (2, 1), settings);
+//! @endcode
+
+octave_value
+decode_batch (const std::vector<json_text>& texts, const dim_vector& dims,
+              const jsondecode_settings& settings)
+{
+  octave_idx_type n = texts.size ();
+  const octave_idx_type block_size = 256 * settings.threads;
+
+  std::unique_ptr<batch_slot[]> slots (new batch_slot[std::min (n,
+                                                       block_size)]);
+
+  decode_options options = settings.options ();
+  layout_cache layouts;
+  string_table strings;
+  options.layouts = &layouts;
+  if (settings.intern_strings)
+    options.strings = &strings;
+
+  Cell retval (dims);
+  bool all_scalar_structs = true;
+  for (octave_idx_type first = 0; first < n; first += block_size)
+    {
+      octave_idx_type count = std::min (n - first, block_size);
+
+      if (settings.validate_utf8)
+        for (octave_idx_type k = 0; k < count; k++)
+          {
+            const json_text& text = texts[first + k];
+            std::size_t pos = find_invalid_utf8 (text.data, text.size);
+            if (pos != text.size)
+              error ("jsondecode: invalid UTF-8 in element %"
+                     OCTAVE_IDX_TYPE_FORMAT " at offset %"
+                     OCTAVE_IDX_TYPE_FORMAT,
+                     static_cast<octave_idx_type> (first + k + 1),
+                     static_cast<octave_idx_type> (pos) + 1);
+          }
+
+      auto parse_slots = [&] (octave_idx_type k0, octave_idx_type step)
+      {
+        for (octave_idx_type k = k0; k < count; k += step)
+          {
+            const json_text& text = texts[first + k];
+            parse_json_text (slots[k].reset (), text.data, text.size,
+                             settings.numbers);
+          }
+      };
+
+      int nthreads = std::min (static_cast<octave_idx_type> (settings.threads),
+                               count);
+      if (nthreads > 1)
+        {
+          std::vector<std::thread> workers;
+          std::vector<std::exception_ptr> failures (nthreads);
+          for (int t = 0; t < nthreads; t++)
+            workers.emplace_back ([&, t] (void)
+              {
+                try
+                  {
+                    parse_slots (t, nthreads);
+                  }
+                catch (...)
+                  {
+                    failures[t] = std::current_exception ();
+                  }
+              });
+          for (auto& worker : workers)
+            worker.join ();
+          for (const auto& failure : failures)
+            if (failure)
+              std::rethrow_exception (failure);
+        }
+      else
+        parse_slots (0, 1);
+
+      for (octave_idx_type k = 0; k < count; k++)
+        {
+          const rapidjson::Document& d = slots[k].document ();
+          if (d.HasParseError ())
+            error ("jsondecode: parse error in element %"
+                   OCTAVE_IDX_TYPE_FORMAT " at offset %"
+                   OCTAVE_IDX_TYPE_FORMAT ": %s\n",
+                   static_cast<octave_idx_type> (first + k + 1),
+                   static_cast<octave_idx_type> (d.GetErrorOffset ()) + 1,
+                   rapidjson::GetParseError_En (d.GetParseError ()));
+
+          octave_value value = decode_document (d, settings, options);
+          if (! value.isstruct () || value.numel () != 1)
+            all_scalar_structs = false;
+          retval(first + k) = value;
+        }
+    }
+
+  if (n > 0 && all_scalar_structs)
+    {
+      octave_value merged = decode_object_array (retval, settings.merge);
+      if (merged.isstruct ())
+        return merged.reshape (dims);
+    }
+
+  return retval;
+}
+
+//! Decodes a cell array of JSON texts.
+//!
+//! The texts are parsed from the character data of the cell elements,
+//! without copying them.
+//!
+//! @param texts cell array of strings.
+//! @param settings parsed options of the jsondecode call.
+//!
+//! @return see @ref decode_batch.
+
+octave_value
+decode_batch (const Cell& texts, const jsondecode_settings& settings)
+{
+  octave_idx_type n = texts.numel ();
+  std::vector<charNDArray> chars (n);
+  std::vector<json_text> spans (n);
+  for (octave_idx_type i = 0; i < n; i++)
+    {
+      // Only the first row of character matrices is used, like
+      // string_value does.
+      if (texts(i).rows () > 1)
+        chars[i] = charNDArray (texts(i).string_value ());
+      else
+        chars[i] = texts(i).char_array_value ();
+      spans[i] = {chars[i].data (),
+                  static_cast<std::size_t> (chars[i].numel ())};
+    }
+
+  return decode_batch (spans, texts.dims (), settings);
+}
+
+//! @return @c true if @p c is whitespace in JSON text.
+
+bool
+is_json_space (char c)
+{
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+//! Splits a stream of JSON text into its top-level values.
+//!
+//! The text may arrive in chunks with arbitrary boundaries.  A small state
+//! machine tracks strings, escapes, and the nesting depth of the unfinished
+//! value, so every byte is scanned once.  As soon as a top-level value is
+//! complete, it is parsed by RapidJSON and decoded.  Only the bytes of the
+//! unfinished value are kept between chunks.
+//!
+//! Top-level values may be concatenated or separated by whitespace.  A
+//! top-level number or literal is complete when it is followed by
+//! whitespace or another value, or when the end of the input is signaled.
+
+class incremental_decoder
+{
+public:
+
+  incremental_decoder (const jsondecode_settings& settings)
+    : m_settings (settings)
+  { }
+
+  //! Appends @p len bytes of JSON text and decodes all values that are
+  //! completed by them.
+  //!
+  //! @param chunk JSON text.
+  //! @param len number of bytes of @p chunk.
+  //! @param finish @c true if no more input follows.
+  //!
+  //! @return completed values in order of their appearance.
+
+  std::vector<octave_value>
+  feed (const char *chunk, std::size_t len, bool finish = false)
+  {
+    std::vector<octave_value> retval;
+
+    m_buffer.append (chunk, len);
+
+    // Errors discard the pending input, so that the decoder remains usable.
+    octave::unwind_action reset_on_error ([this] (void) { reset (); });
+
+    std::size_t pos = m_scanned;
+    for (; pos < m_buffer.size (); ++pos)
+      {
+        char c = m_buffer[pos];
+        if (m_in_string)
+          {
+            if (m_escape)
+              m_escape = false;
+            else if (c == '\\')
+              m_escape = true;
+            else if (c == '"')
+              {
+                m_in_string = false;
+                if (m_depth == 0)
+                  complete (pos + 1, retval);
+              }
+          }
+        else if (m_in_literal)
+          {
+            if (is_json_space (c) || c == '"' || c == '[' || c == '{'
+                || c == ']' || c == '}')
+              {
+                complete (pos, retval);
+                --pos;  // Scan the delimiter again.
+              }
+          }
+        else if (c == '"')
+          {
+            start (pos);
+            m_in_string = true;
+          }
+        else if (c == '[' || c == '{')
+          {
+            start (pos);
+            m_depth++;
+          }
+        else if (c == ']' || c == '}')
+          {
+            if (m_depth == 0)
+              error ("jsondecode: parse error at offset %"
+                     OCTAVE_IDX_TYPE_FORMAT ": unexpected '%c'",
+                     static_cast<octave_idx_type> (m_consumed + pos) + 1, c);
+            if (--m_depth == 0)
+              complete (pos + 1, retval);
+          }
+        else if (m_depth == 0 && ! is_json_space (c))
+          {
+            start (pos);
+            m_in_literal = true;
+          }
+        else if (m_depth == 0)
+          m_start = pos + 1;  // Skip whitespace between values.
+      }
+
+    if (finish)
+      {
+        if (m_in_literal)
+          complete (pos, retval);
+        else if (m_start < m_buffer.size ())
+          error ("jsondecode: parse error at offset %"
+                 OCTAVE_IDX_TYPE_FORMAT ": incomplete JSON value",
+                 static_cast<octave_idx_type> (m_consumed + m_buffer.size ())
+                 + 1);
+      }
+
+    // Keep only the unfinished value.
+    m_buffer.erase (0, m_start);
+    m_consumed += m_start;
+    m_scanned = pos - m_start;
+    m_start = 0;
+
+    reset_on_error.discard ();
+
+    return retval;
+  }
+
+  //! @return number of buffered bytes of the unfinished value.
+
+  std::size_t pending (void) const { return m_buffer.size (); }
+
+private:
+
+  void start (std::size_t pos)
+  {
+    if (m_depth == 0)
+      m_start = pos;
+  }
+
+  void complete (std::size_t end, std::vector<octave_value>& values)
+  {
+    m_in_literal = false;
+
+    rapidjson::Document d;
+    parse_json (d, m_buffer.data () + m_start, end - m_start, m_settings,
+                m_consumed + m_start);
+    values.push_back (decode_document (d, m_settings));
+
+    m_start = end;
+  }
+
+  void reset (void)
+  {
+    m_consumed += m_buffer.size ();
+    m_buffer.clear ();
+    m_start = m_scanned = 0;
+    m_depth = 0;
+    m_in_string = m_escape = m_in_literal = false;
+  }
+
+  jsondecode_settings m_settings;
+
+  //! Unfinished value, possibly preceded by completed values of this chunk.
+  std::string m_buffer;
+  //! Number of bytes discarded from the front of the input.
+  std::size_t m_consumed = 0;
+  //! Start of the unfinished value in @c m_buffer.
+  std::size_t m_start = 0;
+  //! Number of bytes of @c m_buffer that have been scanned.
+  std::size_t m_scanned = 0;
+
+  int m_depth = 0;
+  bool m_in_string = false;
+  bool m_escape = false;
+  bool m_in_literal = false;
+};
+
+//! Byte offsets of the top-level elements of a JSON file, see jsonindex.
+
+struct json_index
+{
+  //! @c true if the elements are those of a single top-level array,
+  //! @c false if they are a sequence of top-level values, e.g. NDJSON.
+  bool array = false;
+
+  //! Number of bytes of the file.
+  uint64_t bytes = 0;
+
+  std::vector<uint64_t> offsets;
+  std::vector<uint64_t> lengths;
+};
+
+//! Finds the top-level elements of a JSON file without parsing it.
+//!
+//! The file is read in chunks and each byte is scanned once by a small state
+//! machine like the one of @ref incremental_decoder: strings are skipped and
+//! brackets are counted.  The elements of a single top-level array are
+//! separated by the commas at depth one.  Otherwise every top-level value is
+//! an element, e.g. each line of an NDJSON file.
+//!
+//! @param filename name of a plain JSON file.
+//! @param[out] index offsets and lengths of the elements.
+//!
+//! @return empty string, or an error message.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! json_index index;
+//! std::string msg = scan_json_index ("records.ndjson", index);
+//! @endcode
+
+std::string
+scan_json_index (const std::string& filename, json_index& index)
+{
+  std::unique_ptr<std::FILE, int (*) (std::FILE *)>
+    file (std::fopen (filename.c_str (), "rb"), &std::fclose);
+  if (! file)
+    return "unable to open file '" + filename + "'";
+
+  // Top-level values and the elements of the first one, if it is an array.
+  std::vector<uint64_t> value_offsets, value_lengths;
+  std::vector<uint64_t> elem_offsets, elem_lengths;
+  bool first_is_array = false;
+
+  std::size_t depth = 0;
+  bool in_string = false;
+  bool escape = false;
+  bool in_literal = false;
+  bool in_elem = false;
+  uint64_t value_start = 0;
+  uint64_t elem_start = 0;
+  // Position of the last byte that is not whitespace.
+  uint64_t last = 0;
+  uint64_t pos = 0;
+
+  auto end_value = [&] (uint64_t end)
+  {
+    value_offsets.push_back (value_start);
+    value_lengths.push_back (end - value_start);
+  };
+
+  auto end_elem = [&] (void)
+  {
+    if (in_elem)
+      {
+        elem_offsets.push_back (elem_start);
+        elem_lengths.push_back (last + 1 - elem_start);
+        in_elem = false;
+      }
+  };
+
+  // Compressed files cannot be read at an offset.
+  unsigned char magic[4] = {0, 0, 0, 0};
+  std::size_t m = std::fread (magic, 1, sizeof (magic), file.get ());
+  if ((m >= 2 && magic[0] == 0x1F && magic[1] == 0x8B)
+      || (m == 4 && magic[0] == 0x28 && magic[1] == 0xB5 && magic[2] == 0x2F
+          && magic[3] == 0xFD))
+    return "compressed file '" + filename + "' cannot be indexed";
+  std::rewind (file.get ());
+
+  std::vector<char> buffer (65536);
+  std::size_t n;
+  while ((n = std::fread (buffer.data (), 1, buffer.size (), file.get ())) > 0)
+    for (std::size_t i = 0; i < n; ++i, ++pos)
+      {
+        char c = buffer[i];
+        if (in_string)
+          {
+            last = pos;
+            if (escape)
+              escape = false;
+            else if (c == '\\')
+              escape = true;
+            else if (c == '"')
+              {
+                in_string = false;
+                if (depth == 0)
+                  end_value (pos + 1);
+              }
+            continue;
+          }
+
+        if (in_literal)
+          {
+            if (! (is_json_space (c) || c == '"' || c == '[' || c == '{'
+                   || c == ']' || c == '}' || c == ','))
+              {
+                last = pos;
+                continue;
+              }
+            in_literal = false;
+            end_value (last + 1);
+          }
+
+        if (is_json_space (c))
+          continue;
+
+        // Elements of the first top-level value, if it is an array.
+        if (depth == 1 && first_is_array && value_offsets.empty ())
+          {
+            if (c == ',' || c == ']' || c == '}')
+              end_elem ();
+            else if (! in_elem)
+              {
+                in_elem = true;
+                elem_start = pos;
+              }
+          }
+
+        if (c == '"')
+          {
+            if (depth == 0)
+              value_start = pos;
+            in_string = true;
+          }
+        else if (c == '[' || c == '{')
+          {
+            if (depth == 0)
+              {
+                value_start = pos;
+                if (value_offsets.empty ())
+                  first_is_array = (c == '[');
+              }
+            depth++;
+          }
+        else if (c == ']' || c == '}' || (c == ',' && depth == 0))
+          {
+            if (depth == 0)
+              return "parse error at offset " + std::to_string (pos + 1)
+                     + ": unexpected '" + c + "'";
+            if (--depth == 0)
+              end_value (pos + 1);
+          }
+        else if (depth == 0)
+          {
+            value_start = pos;
+            in_literal = true;
+          }
+
+        last = pos;
+      }
+
+  if (std::ferror (file.get ()))
+    return "unable to read file '" + filename + "'";
+
+  if (in_literal)
+    end_value (last + 1);
+  else if (in_string || depth > 0)
+    return "parse error at offset " + std::to_string (pos + 1)
+           + ": incomplete JSON value";
+
+  index.bytes = pos;
+  index.array = (first_is_array && value_offsets.size () == 1);
+  if (index.array)
+    {
+      index.offsets.swap (elem_offsets);
+      index.lengths.swap (elem_lengths);
+    }
+  else
+    {
+      index.offsets.swap (value_offsets);
+      index.lengths.swap (value_lengths);
+    }
+
+  return "";
+}
+
+//! Decodes some elements of a JSON file by their byte offsets.
+//!
+//! Only the text of the requested elements is read and parsed, so the cost
+//! depends on their size and not on the size of the file.
+//!
+//! @param filename name of the file.
+//! @param index struct returned by jsonindex for the file.
+//! @param elements indices of the elements to decode, starting at 1.
+//! @param settings parsed options of the jsondecodefile call.
+//!
+//! @return decoded element if @p elements is a scalar, otherwise the
+//! decoded elements with the dimensions of @p elements like
+//! @ref decode_batch.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! octave_value rec = decode_elements ("records.ndjson", index,
+//!                                     octave_value (42),
+//!                                     jsondecode_settings (ovl (), 0));
+//! @endcode
+
+octave_value
+decode_elements (const std::string& filename, const octave_value& index,
+                 const octave_value& elements,
+                 const jsondecode_settings& settings)
+{
+  const char *bad_index = "jsondecodefile: 'Index' must be a struct "
+                          "returned by jsonindex";
+  if (! index.isstruct () || index.numel () != 1)
+    error ("%s", bad_index);
+  octave_scalar_map map = index.scalar_map_value ();
+  if (! map.isfield ("offsets") || ! map.isfield ("lengths")
+      || ! map.isfield ("bytes"))
+    error ("%s", bad_index);
+  uint64NDArray offsets = map.getfield ("offsets").xuint64_array_value
+                            ("%s", bad_index);
+  uint64NDArray lengths = map.getfield ("lengths").xuint64_array_value
+                            ("%s", bad_index);
+  uint64_t bytes = map.getfield ("bytes").xuint64_scalar_value
+                     ("%s", bad_index).value ();
+  if (offsets.numel () != lengths.numel ())
+    error ("%s", bad_index);
+
+  NDArray k = elements.xarray_value ("jsondecodefile: 'Elements' must be "
+                                     "a numeric array");
+
+  std::unique_ptr<std::FILE, int (*) (std::FILE *)>
+    file (std::fopen (filename.c_str (), "rb"), &std::fclose);
+  if (! file)
+    error ("jsondecodefile: unable to open file '%s'", filename.c_str ());
+
+  uint64_t size;
+  if (! file_size (file.get (), size) || size != bytes)
+    error ("jsondecodefile: the file has changed since it was indexed");
+
+  // All elements are read into one buffer, the spans point into it once
+  // it is complete.
+  std::string buffer;
+  std::vector<std::size_t> starts (k.numel ());
+  std::vector<json_text> texts (k.numel ());
+  uint64_t offset = 0;
+  for (octave_idx_type i = 0; i < k.numel (); ++i)
+    {
+      if (k(i) != octave::math::round (k(i)) || k(i) < 1
+          || k(i) > offsets.numel ())
+        error ("jsondecodefile: 'Elements' must be indices between 1 and %"
+               OCTAVE_IDX_TYPE_FORMAT, offsets.numel ());
+
+      octave_idx_type e = k(i) - 1;
+      offset = offsets(e).value ();
+      uint64_t len = lengths(e).value ();
+      if (offset > bytes || len > bytes - offset)
+        error ("%s", bad_index);
+
+      starts[i] = buffer.size ();
+      texts[i].size = len;
+      buffer.resize (starts[i] + len);
+      if (! seek_file (file.get (), offset)
+          || std::fread (&buffer[starts[i]], 1, len, file.get ()) != len)
+        error ("jsondecodefile: unable to read file '%s'", filename.c_str ());
+    }
+
+  for (octave_idx_type i = 0; i < k.numel (); ++i)
+    texts[i].data = buffer.data () + starts[i];
+
+  if (k.numel () != 1)
+    return decode_batch (texts, k.dims (), settings);
+
+  // Errors report the offset in the file.
+  rapidjson::Document d;
+  parse_json (d, texts[0].data, texts[0].size, settings, offset);
+  return decode_document (d, settings);
+}
+
+//! Handle to an @ref incremental_decoder returned by @c jsondecoder.
+//!
+//! Copies of the Octave value share the decoder, so that feeding one copy
+//! advances all of them.
+
+class octave_json_decoder : public octave_base_value
+{
+public:
+
+  octave_json_decoder (void) = default;
+
+  octave_json_decoder (const jsondecode_settings& settings)
+    : m_decoder (std::make_shared<incremental_decoder> (settings))
+  { }
+
+  octave_base_value * clone (void) const
+  { return new octave_json_decoder (*this); }
+
+  octave_base_value * empty_clone (void) const
+  { return new octave_json_decoder (); }
+
+  incremental_decoder& decoder (void) const { return *m_decoder; }
+
+  bool is_defined (void) const { return true; }
+
+  dim_vector dims (void) const { return dim_vector (1, 1); }
+
+  bool print_as_scalar (void) const { return true; }
+
+  void print (std::ostream& os, bool pr_as_read_syntax = false)
+  {
+    print_raw (os, pr_as_read_syntax);
+    newline (os);
+  }
+
+  void print_raw (std::ostream& os, bool = false) const
+  {
+    indent (os);
+    os << "<jsondecoder: " << (m_decoder ? m_decoder->pending () : 0)
+       << " bytes pending>";
+  }
+
+private:
+
+  std::shared_ptr<incremental_decoder> m_decoder;
+
+  DECLARE_OV_TYPEID_FUNCTIONS_AND_DATA
+};
+
+DEFINE_OV_TYPEID_FUNCTIONS_AND_DATA (octave_json_decoder, "jsondecoder",
+                                     "jsondecoder");
+
+//! Registers the Octave value type @p T on first use.
+//!
+//! The oct-file is locked, because values of the type must not outlive
+//! the code of their class.
+
+template <typename T> void
+register_type_once (octave::interpreter& interp)
+{
+  static bool type_loaded = false;
+  if (! type_loaded)
+    {
+      T::register_type ();
+      interp.mlock ();
+      type_loaded = true;
+    }
+}
+
+//! Parsed JSON document of a lazy jsondecode call.
+//!
+//! Subtrees are decoded on demand and memoized, so that each one is decoded
+//! at most once, no matter how often it is accessed.
+
+class lazy_document
+{
+public:
+
+  lazy_document (const jsondecode_settings& settings)
+    : m_settings (settings)
+  { }
+
+  rapidjson::Document& document (void) { return m_document; }
+
+  //! @return decoded value of @p val, a value of this document.
+
+  octave_value materialize (const rapidjson::Value& val)
+  {
+    auto it = m_cache.find (&val);
+    if (it != m_cache.end ())
+      return it->second;
+
+    decode_options options = m_settings.options ();
+    if (m_settings.intern_strings)
+      options.strings = &m_strings;
+
+    octave_value retval = decode (val, options);
+    m_cache[&val] = retval;
+    return retval;
+  }
+
+  //! Finds the member of the JSON object @p val that is decoded into the
+  //! struct field @p name.
+  //!
+  //! @return the member value or @c nullptr if there is none.
+
+  const rapidjson::Value *
+  member (const rapidjson::Value& val, const std::string& name) const
+  {
+    const octave::make_valid_name_options *options
+      = m_settings.options ().make_valid_name;
+
+    // Like in decode_object, the last of duplicate keys wins.
+    const rapidjson::Value *retval = nullptr;
+    for (const auto& pair : val.GetObject ())
+      {
+        std::string varname = pair.name.GetString ();
+        if (options != nullptr)
+          octave::make_valid_name (varname, *options);
+        if (varname == name)
+          retval = &pair.value;
+      }
+
+    return retval;
+  }
+
+  //! @return whether the JSON object @p val is decoded into a scalar
+  //! struct, whose fields are its members.
+
+  bool is_struct (const rapidjson::Value& val) const
+  {
+    decode_options options = m_settings.options ();
+    return val.IsObject ()
+           && ! (options.base64_arrays && is_base64_array (val))
+           && ! (options.compact_sparse && is_sparse_object (val));
+  }
+
+  //! Checks whether a scalar index of kind @p type (@c '(' or @c '{')
+  //! selects the same element in the decoded JSON array @p val as in the
+  //! JSON array itself.
+  //!
+  //! This is the case for braces on arrays decoded into a cell of the
+  //! decoded elements, and for parentheses on arrays of objects with the
+  //! same keys, which are decoded into a struct array.  All other arrays,
+  //! e.g. matrices, are indexed after they were decoded.
+
+  bool indexes_elements (const rapidjson::Value& val, char type) const
+  {
+    if (! val.IsArray () || val.Empty ())
+      return false;
+
+    // Numbers and null, or true and false, are decoded into one array.
+    auto category = [] (const rapidjson::Value& v)
+    {
+      rapidjson::Type t = v.GetType ();
+      return (t == rapidjson::kNullType ? rapidjson::kNumberType
+              : t == rapidjson::kTrueType ? rapidjson::kFalseType : t);
+    };
+
+    rapidjson::Type first = category (val[0]);
+    bool same_type = true;
+    for (const auto& elem : val.GetArray ())
+      if (category (elem) != first)
+        {
+          same_type = false;
+          break;
+        }
+
+    if (type == '{')
+      return ! same_type || first == rapidjson::kStringType;
+
+    if (! same_type || first != rapidjson::kObjectType
+        || m_settings.options ().object_columns)
+      return false;
+
+    // Objects with the same keys in the same order are merged into a struct
+    // array by every "MergeObjects" mode.
+    const rapidjson::Value& obj0 = val[0];
+    for (const auto& elem : val.GetArray ())
+      {
+        if (! is_struct (elem)
+            || elem.MemberCount () != obj0.MemberCount ())
+          return false;
+        auto it0 = obj0.MemberBegin ();
+        for (auto it = elem.MemberBegin (); it != elem.MemberEnd ();
+             ++it, ++it0)
+          if (it->name != it0->name)
+            return false;
+      }
+
+    return true;
+  }
+
+private:
+
+  jsondecode_settings m_settings;
+  rapidjson::Document m_document;
+  std::unordered_map<const rapidjson::Value *, octave_value> m_cache;
+  string_table m_strings;
+};
+
+//! Handle to a value of a @ref lazy_document, returned by
+//! @c jsondecode (..., "Lazy", true).
+//!
+//! Indexing navigates the JSON document: field names select members of
+//! JSON objects, scalar indices select elements of JSON arrays where the
+//! decoded array is indexed the same way (see
+//! @ref lazy_document::indexes_elements).  Only the value at the end of the
+//! index chain is decoded.  Other indices are applied to the decoded value,
+//! so that the result is always the same as for the decoded document.  The document is shared
+//! by all handles and freed with the last one.
+
+class octave_lazy_json : public octave_base_value
+{
+public:
+
+  octave_lazy_json (void) = default;
+
+  octave_lazy_json (const std::shared_ptr<lazy_document>& doc,
+                    const rapidjson::Value *val)
+    : m_doc (doc), m_val (val)
+  { }
+
+  octave_base_value * clone (void) const
+  { return new octave_lazy_json (*this); }
+
+  octave_base_value * empty_clone (void) const
+  { return new octave_lazy_json (); }
+
+  octave_value subsref (const std::string& type,
+                        const std::list<octave_value_list>& idx)
+  {
+    const rapidjson::Value *val = m_val;
+
+    std::size_t k = 0;
+    auto it = idx.begin ();
+    for (; k < type.size (); ++k, ++it)
+      {
+        if (type[k] == '.')
+          {
+            if (! m_doc->is_struct (*val))
+              break;
+
+            std::string name = (*it)(0).string_value ();
+            const rapidjson::Value *elem = m_doc->member (*val, name);
+            if (elem == nullptr)
+              error ("jsondecode: no JSON key for field '%s'", name.c_str ());
+            val = elem;
+          }
+        else if (it->length () == 0)
+          continue;
+        else
+          {
+            if (it->length () != 1 || ! (*it)(0).is_real_scalar ()
+                || (*it)(0).is_bool_scalar ()
+                || ! m_doc->indexes_elements (*val, type[k]))
+              break;
+
+            double d = (*it)(0).double_value ();
+            if (d != octave::math::round (d) || d < 1)
+              error ("jsondecode: JSON array index must be a positive "
+                     "integer");
+            if (d > val->Size ())
+              error ("jsondecode: index (%g): out of bound %u", d,
+                     val->Size ());
+
+            val = &(*val)[static_cast<rapidjson::SizeType> (d) - 1];
+          }
+      }
+
+    octave_value retval = m_doc->materialize (*val);
+    if (k < type.size ())
+      retval = retval.subsref (type.substr (k),
+                               std::list<octave_value_list> (it, idx.end ()));
+
+    return retval;
+  }
+
+  octave_value_list subsref (const std::string& type,
+                             const std::list<octave_value_list>& idx, int)
+  {
+    return subsref (type, idx);
+  }
+
+  bool is_defined (void) const { return true; }
+
+  dim_vector dims (void) const { return dim_vector (1, 1); }
+
+  bool print_as_scalar (void) const { return true; }
+
+  void print (std::ostream& os, bool pr_as_read_syntax = false)
+  {
+    print_raw (os, pr_as_read_syntax);
+    newline (os);
+  }
+
+  void print_raw (std::ostream& os, bool = false) const
+  {
+    indent (os);
+    if (m_val == nullptr)
+      os << "<lazy JSON>";
+    else if (m_val->IsObject ())
+      os << "<lazy JSON object with " << m_val->MemberCount () << " keys>";
+    else if (m_val->IsArray ())
+      os << "<lazy JSON array with " << m_val->Size () << " elements>";
+    else
+      os << "<lazy JSON value>";
+  }
+
+private:
+
+  std::shared_ptr<lazy_document> m_doc;
+  const rapidjson::Value *m_val = nullptr;
+
+  DECLARE_OV_TYPEID_FUNCTIONS_AND_DATA
+};
+
+DEFINE_OV_TYPEID_FUNCTIONS_AND_DATA (octave_lazy_json, "lazy_json",
+                                     "lazy_json");
+
+//! JSON text that is read and parsed in a background thread.
+//!
+//! Reading (and decompressing) the file and parsing do not call into
+//! Octave.  Errors are kept as
+//! messages until @ref fetch, which decodes the document into Octave values
+//! in the calling (interpreter) thread.
+
+class async_decode
+{
+public:
+
+  //! Starts reading and parsing @p input in a background thread.
+  //!
+  //! @param settings parsed options of the jsondecode_async call.
+  //! @param input JSON text, or the name of a file if @p from_file.
+  //! @param from_file @c true if @p input is a file name.
+
+  async_decode (const jsondecode_settings& settings, std::string input,
+                bool from_file)
+    : m_settings (settings), m_input (std::move (input)),
+      m_from_file (from_file)
+  {
+    m_task = std::async (std::launch::async, [this] (void) { run (); });
+  }
+
+  // No copying!
+
+  async_decode (const async_decode&) = delete;
+
+  async_decode& operator = (const async_decode&) = delete;
+
+  //! @return @c true if reading and parsing are finished.
+
+  bool ready (void) const
+  {
+    return m_finished
+           || (m_task.wait_for (std::chrono::seconds (0))
+               == std::future_status::ready);
+  }
+
+  //! Waits for the background thread and decodes its result.
+  //!
+  //! The decoded value is cached, further calls return it again.
+  //!
+  //! @return @ref octave_value that contains the decoded JSON text.
+
+  octave_value fetch (void)
+  {
+    if (! m_finished)
+      {
+        m_finished = true;
+        m_task.get ();
+      }
+
+    if (! m_error.empty ())
+      error ("%s", m_error.c_str ());
+
+    if (m_value.is_undefined ())
+      {
+        m_value = decode_document (m_document, m_settings);
+
+        // The document is not needed anymore.
+        rapidjson::Document ().Swap (m_document);
+      }
+
+    return m_value;
+  }
+
+private:
+
+  //! Body of the background thread.
+
+  void run (void)
+  {
+    if (m_from_file)
+      {
+        // Compressed files are decompressed while parsing.
+        json_file_reader file (m_input);
+        parse_json_stream (m_document, file, m_settings.numbers,
+                           m_settings.validate_utf8);
+        std::string msg = stream_error (file, m_document);
+        if (! msg.empty ())
+          m_error = "jsondecode_async: " + msg;
+        return;
+      }
+
+    if (m_settings.validate_utf8)
+      {
+        std::size_t pos = find_invalid_utf8 (m_input.data (), m_input.size ());
+        if (pos != m_input.size ())
+          {
+            m_error = "jsondecode_async: invalid UTF-8 at offset "
+                      + std::to_string (pos + 1);
+            return;
+          }
+      }
+
+    parse_json_text (m_document, m_input.data (), m_input.size (),
+                     m_settings.numbers);
+
+    if (m_document.HasParseError ())
+      m_error = "jsondecode_async: parse error at offset "
+                + std::to_string (m_document.GetErrorOffset () + 1) + ": "
+                + rapidjson::GetParseError_En (m_document.GetParseError ());
+
+    // The text is not needed anymore.
+    std::string ().swap (m_input);
+  }
+
+  jsondecode_settings m_settings;
+  std::string m_input;
+  bool m_from_file;
+
+  rapidjson::Document m_document;
+  std::string m_error;
+
+  octave_value m_value;
+  bool m_finished = false;
+
+  //! Declared last, so that it is destroyed first: the destructor of the
+  //! future waits for the background thread, which uses the other members.
+  std::future<void> m_task;
+};
+
+//! Handle to an @ref async_decode returned by @c jsondecode_async.
+
+class octave_json_future : public octave_base_value
+{
+public:
+
+  octave_json_future (void) = default;
+
+  octave_json_future (const jsondecode_settings& settings, std::string input,
+                      bool from_file)
+    : m_task (std::make_shared<async_decode> (settings, std::move (input),
+                                              from_file))
+  { }
+
+  octave_base_value * clone (void) const
+  { return new octave_json_future (*this); }
+
+  octave_base_value * empty_clone (void) const
+  { return new octave_json_future (); }
+
+  async_decode& task (void) const { return *m_task; }
+
+  bool is_defined (void) const { return true; }
+
+  dim_vector dims (void) const { return dim_vector (1, 1); }
+
+  bool print_as_scalar (void) const { return true; }
+
+  void print (std::ostream& os, bool pr_as_read_syntax = false)
+  {
+    print_raw (os, pr_as_read_syntax);
+    newline (os);
+  }
+
+  void print_raw (std::ostream& os, bool = false) const
+  {
+    indent (os);
+    os << "<json_future: "
+       << (m_task && m_task->ready () ? "ready" : "pending") << ">";
+  }
+
+private:
+
+  std::shared_ptr<async_decode> m_task;
+
+  DECLARE_OV_TYPEID_FUNCTIONS_AND_DATA
+};
+
+DEFINE_OV_TYPEID_FUNCTIONS_AND_DATA (octave_json_future, "json_future",
+                                     "json_future");
+
+//! Memory for the RapidJSON documents of jsondecode, kept between calls.
+//!
+//! Each call parses into a pool allocator whose first chunk is the buffer
+//! of the arena, so that a document that fits into it needs no memory
+//! allocation at all.  If a document needs more chunks, the buffer grows to
+//! the total capacity of all chunks at the start of the next call, so that
+//! a document of the same size fits into the first chunk again.  It never
+//! grows beyond @c max_retained bytes.  Each thread has its own arena.
+//!
+//! Only the memory of the DOM is kept.  The parse stack of
+//! @c rapidjson::Document always uses its own @c CrtAllocator.
+
+class decode_arena
+{
+public:
+
+  //! Initial size of the buffer, the default chunk size of RapidJSON.
+  static const std::size_t min_size = 64 * 1024;
+
+  //! Upper limit of the memory that is kept between calls.
+  static const std::size_t max_retained = 64 * 1024 * 1024;
+
+  //! @return arena of the calling thread.
+
+  static decode_arena& instance (void)
+  {
+    static thread_local decode_arena arena;
+    return arena;
+  }
+
+  //! @return buffer for the first chunk of a pool allocator, or
+  //! @p fallback resized to @c min_size if the arena is already in use.
+
+  std::vector<char>& acquire (std::vector<char>& fallback)
+  {
+    if (m_in_use)
+      {
+        fallback.resize (min_size);
+        return fallback;
+      }
+
+    m_in_use = true;
+    m_calls++;
+    if (m_buffer.size () < m_wanted)
+      std::vector<char> (m_wanted).swap (m_buffer);
+    return m_buffer;
+  }
+
+  //! Returns @p buffer to the arena.
+  //!
+  //! The buffer is still in use by the pool allocator, which is destroyed
+  //! after this call.  Therefore it is only resized by the next
+  //! @ref acquire.
+  //!
+  //! @param buffer buffer returned by @ref acquire.
+  //! @param capacity capacity of all chunks of the pool allocator that used
+  //! @p buffer.
+
+  void release (const std::vector<char>& buffer, std::size_t capacity)
+  {
+    if (&buffer != &m_buffer)
+      return;
+
+    m_in_use = false;
+    if (capacity > m_buffer.size ())
+      {
+        m_spills++;
+        // The allocator keeps its bookkeeping at the start of the buffer.
+        std::size_t size = capacity + pool_bookkeeping;
+        if (size > max_retained)
+          size = max_retained;
+        if (size > m_wanted)
+          m_wanted = size;
+      }
+  }
+
+  //! Frees the buffer.
+
+  void clear (void)
+  {
+    if (! m_in_use)
+      {
+        std::vector<char> ().swap (m_buffer);
+        m_wanted = min_size;
+      }
+  }
+
+  //! @return statistics of the arena for @c __jsondecode_arena__.
+
+  octave_scalar_map stats (void) const
+  {
+    octave_scalar_map retval;
+    retval.assign ("calls", static_cast<double> (m_calls));
+    retval.assign ("spills", static_cast<double> (m_spills));
+    retval.assign ("retained_bytes", static_cast<double> (m_buffer.size ()));
+    retval.assign ("max_retained_bytes", static_cast<double> (max_retained));
+    return retval;
+  }
+
+private:
+
+  std::vector<char> m_buffer;
+  //! Size of the buffer for the next call.
+  std::size_t m_wanted = min_size;
+  bool m_in_use = false;
+  //! Number of documents parsed into the arena.
+  uint64_t m_calls = 0;
+  //! Number of documents that needed memory beyond the buffer.
+  uint64_t m_spills = 0;
+};
+
+//! RapidJSON document whose memory is taken from the @ref decode_arena of
+//! the calling thread and returned to it on destruction.
+
+class arena_document
+{
+public:
+
+  arena_document (void)
+    : m_arena (decode_arena::instance ()),
+      m_buffer (m_arena.acquire (m_fallback)),
+      m_allocator (m_buffer.data (), m_buffer.size ()),
+      m_document (&m_allocator)
+  { }
+
+  // No copying!
+
+  arena_document (const arena_document&) = delete;
+
+  arena_document& operator = (const arena_document&) = delete;
+
+  ~arena_document (void)
+  {
+    m_arena.release (m_buffer, m_allocator.Capacity ());
+  }
+
+  rapidjson::Document& document (void) { return m_document; }
+
+private:
+
+  decode_arena& m_arena;
+  std::vector<char> m_fallback;
+  std::vector<char>& m_buffer;
+  rapidjson::MemoryPoolAllocator<> m_allocator;
+  rapidjson::Document m_document;
+};
+
+#endif
+
+DEFMETHOD_DLD (jsondecode, interp, args, ,
+               "-*- texinfo -*-\n\
+@deftypefn  {} {@var{object} =} jsondecode (@var{JSON_txt})                  \n\
+@deftypefnx {} {@var{object} =} jsondecode (@dots{}, \"ReplacementStyle\", @var{rs}) \n\
+@deftypefnx {} {@var{object} =} jsondecode (@dots{}, \"Prefix\", @var{pfx})  \n\
+@deftypefnx {} {@var{object} =} jsondecode (@dots{}, \"makeValidName\", @var{TF}) \n\
+@deftypefnx {} {@var{object} =} jsondecode (@dots{}, \"Schema\", @var{template}) \n\
+@deftypefnx {} {@var{object} =} jsondecode (@var{bytes}, \"Format\", @var{fmt}) \n\
+@deftypefnx {} {@var{object} =} jsondecode (@dots{}, \"NumericEncoding\", @var{enc}) \n\
+@deftypefnx {} {@var{object} =} jsondecode (@dots{}, \"SparseEncoding\", @var{enc}) \n\
+@deftypefnx {} {@var{object} =} jsondecode (@dots{}, \"NumberParsing\", @var{mode}) \n\
+@deftypefnx {} {@var{object} =} jsondecode (@dots{}, \"ArrayOfObjects\", @var{layout}) \n\
+@deftypefnx {} {@var{object} =} jsondecode (@dots{}, \"MergeObjects\", @var{mode}) \n\
+@deftypefnx {} {@var{object} =} jsondecode (@dots{}, \"InternStrings\", @var{TF}) \n\
+@deftypefnx {} {@var{object} =} jsondecode (@dots{}, \"ValidateUTF8\", @var{TF}) \n\
+@deftypefnx {} {@var{objects} =} jsondecode (@var{C}, @dots{}, \"Threads\", @var{n}) \n\
+@deftypefnx {} {@var{h} =} jsondecode (@dots{}, \"Lazy\", @var{TF})           \n\
+                                                                             \n\
+Decode text that is formatted in JSON.                                       \n\
+                                                                             \n\
+The input @var{JSON_txt} is a string that contains JSON text.                \n\
+                                                                             \n\
+The output @var{object} is an Octave object that contains the result of      \n\
+decoding @var{JSON_txt}.                                                     \n\
+                                                                             \n\
+If the input @var{C} is a cell array of strings, each string is decoded     \n\
+separately and @var{objects} is a cell array of the same size with the      \n\
+results.  If all results are scalar structs with the same fields, they are   \n\
+merged into a struct array of the same size instead.  This is much faster    \n\
+than decoding the strings one by one, e.g. with @code{cellfun}.  The option  \n\
+@qcode{\"Threads\"} parses up to @var{n} strings in parallel (default: 1); \n\
+the conversion into Octave values always happens in the calling thread.      \n\
+                                                                             \n\
+The option @qcode{\"Format\"} selects the input format: @qcode{\"json\"}   \n\
+(default) for JSON text, @qcode{\"cbor\"} or @qcode{\"msgpack\"} for a    \n\
+@code{uint8} array @var{bytes} with data encoded as CBOR (RFC 8949) or      \n\
+MessagePack, for example by @code{jsonencode}.  Binary input is decoded into \n\
+exactly the same Octave values as the equivalent JSON text.  CBOR typed     \n\
+arrays (RFC 8746) are decoded like arrays of numbers.                        \n\
+                                                                             \n\
+If the value of the option @qcode{\"NumericEncoding\"} is @qcode{\"base64\"}, \n\
+JSON objects with exactly the keys @qcode{\"dtype\"}, @qcode{\"shape\"}, and \n\
+@qcode{\"data\"}, as written by                                            \n\
+@code{jsonencode (@dots{}, \"NumericEncoding\", \"base64\")}, are decoded   \n\
+into N-D arrays of their original class and dimensions.  The default value   \n\
+@qcode{\"text\"} decodes such objects into structs.                          \n\
+                                                                             \n\
+Likewise, if the value of the option @qcode{\"SparseEncoding\"} is         \n\
+@qcode{\"compact\"}, JSON objects with exactly the keys @qcode{\"sparse\"}   \n\
+(@code{true}), @qcode{\"size\"}, @qcode{\"i\"}, @qcode{\"j\"}, and          \n\
+@qcode{\"v\"}, as written by                                                \n\
+@code{jsonencode (@dots{}, \"SparseEncoding\", \"compact\")}, are decoded  \n\
+into sparse matrices.  The default value @qcode{\"dense\"} decodes such    \n\
+objects into structs.                                                        \n\
+                                                                             \n\
+The option @qcode{\"NumberParsing\"} selects how numbers in JSON text are  \n\
+parsed.  @qcode{\"fast\"} (default) is the fastest mode, but the parsed     \n\
+double may differ from the correctly rounded value in the last bits for     \n\
+numbers with many significant digits.  @qcode{\"exact\"} parses every number \n\
+into the correctly rounded double at the cost of some speed for such         \n\
+numbers.  @qcode{\"raw\"} keeps the text of every number and returns it as  \n\
+a character vector, e.g. to preserve big integers or decimals exactly.  Then \n\
+arrays of numbers are decoded like arrays of strings.  This option has no    \n\
+effect on binary formats.                                                    \n\
+                                                                             \n\
+By default, arrays of objects are decoded into struct arrays if all objects  \n\
+have the same keys, and into cell arrays of structs otherwise.  If the value \n\
+of the option @qcode{\"ArrayOfObjects\"} is @qcode{\"columns\"}, every     \n\
+array of N objects is decoded into a scalar struct instead, with one field   \n\
+per distinct key.  Each field is an Nx1 column: a double vector for numbers, \n\
+a logical vector for Booleans, a cell array of strings for strings, and a    \n\
+cell array for anything else.  Missing keys and null are @code{NaN} in      \n\
+double columns and empty otherwise.  Logical columns with missing values are \n\
+decoded into double columns.  This needs much less memory than struct arrays \n\
+for large tables and allows vectorized processing of the columns.  The       \n\
+default value is @qcode{\"structs\"}.                                       \n\
+                                                                             \n\
+The option @qcode{\"MergeObjects\"} selects the arrays of objects that are \n\
+decoded into struct arrays.  With @qcode{\"ordered\"} (default), all      \n\
+objects must have the same keys in the same order.  With                    \n\
+@qcode{\"unordered\"}, the keys may be in any order, as in records from    \n\
+many web APIs.  With @qcode{\"fill\"}, every array of objects is decoded  \n\
+into a struct array and missing keys are filled with @code{[]}.  The fields \n\
+are ordered by the first appearance of their key.                           \n\
+                                                                             \n\
+If the value of the option @qcode{\"ValidateUTF8\"} is true, JSON text that \n\
+is not valid UTF-8 (RFC 3629) is an error that reports the offset of the    \n\
+first invalid byte.  By default, invalid bytes are passed through to the    \n\
+decoded strings.  This option has no effect on binary formats.              \n\
+                                                                             \n\
+If the value of the option @qcode{\"InternStrings\"} is true, identical     \n\
+string values share the same memory until one of them is modified.  This    \n\
+saves memory for data with many repeated strings, e.g. status codes or unit \n\
+names.  The decoded values are the same as without this option.             \n\
+                                                                             \n\
+For more information about the options @qcode{\"ReplacementStyle\"} and      \n\
+@qcode{\"Prefix\"}, see                                                      \n\
+@ref{XREFmatlab_lang_makeValidName,,matlab.lang.makeValidName}.              \n\
+                                                                             \n\
+If the value of the option @qcode{\"makeValidName\"} is false then names     \n\
+will not be changed by @code{matlab.lang.makeValidName} and the              \n\
+@qcode{\"ReplacementStyle\"} and @qcode{\"Prefix\"} options will be ignored. \n\
+                                                                             \n\
+If the option @qcode{\"Schema\"} is given, type inference is skipped and   \n\
+the JSON text is decoded directly into the types and dimensions declared by  \n\
+the Octave value @var{template}:                                             \n\
+                                                                             \n\
+@itemize @bullet                                                             \n\
+@item                                                                        \n\
+a scalar struct declares an object with exactly these keys, whose values are \n\
+described by the field values;                                               \n\
+                                                                             \n\
+@item                                                                        \n\
+a struct array, or a cell containing a scalar struct, declares an array of   \n\
+such objects, which is decoded into an Nx1 struct array;                     \n\
+                                                                             \n\
+@item                                                                        \n\
+a numeric or logical scalar declares a number or Boolean of that class;      \n\
+                                                                             \n\
+@item                                                                        \n\
+a numeric or logical vector, e.g. @code{zeros (0, 1, \"int32\")}, declares an \n\
+array of numbers or Booleans, decoded into a column or row vector like       \n\
+@var{template};                                                              \n\
+                                                                             \n\
+@item                                                                        \n\
+a numeric or logical matrix, e.g. @code{zeros (0, 3)}, declares an array of  \n\
+arrays of equal length, which is decoded into a matrix with one row per      \n\
+inner array;                                                                 \n\
+                                                                             \n\
+@item                                                                        \n\
+a character array declares a string;                                         \n\
+                                                                             \n\
+@item                                                                        \n\
+a cell @code{@{@var{elem}@}} declares an array whose elements are described  \n\
+by @var{elem}, and @code{@{@}} an array of arbitrary values, decoded into an \n\
+Nx1 cell array;                                                              \n\
+                                                                             \n\
+@item                                                                        \n\
+@code{[]} accepts any JSON value, which is decoded without a schema.         \n\
+@end itemize                                                                 \n\
+                                                                             \n\
+JSON null is accepted as @code{NaN} for floating point numbers only.        \n\
+Integer classes accept integral numbers in their range only, 64 bit integers \n\
+are decoded without loss of precision.  Any mismatch between the JSON text   \n\
+and @var{template} is an error that reports the location of the offending    \n\
+value, e.g. @code{$.data[3].name}.                                           \n\
+                                                                             \n\
+If the value of the option @qcode{\"Lazy\"} is true, the JSON text is only \n\
+parsed and a handle @var{h} to the parsed document is returned.  Indexing   \n\
+@var{h} decodes only the accessed part of the document, e.g.                \n\
+@code{@var{h}.data(3).name} decodes a single string.  Field names select     \n\
+keys of JSON objects.  Scalar indices select elements of JSON arrays without \n\
+decoding the array where it is indexed like its decoded value: braces on     \n\
+arrays decoded into a cell, and parentheses on arrays of objects with the    \n\
+same keys.  All other indices are applied to the decoded value, so that the  \n\
+result is always the same as indexing the output of @code{jsondecode}.       \n\
+@code{@var{h}()} decodes the whole document.  Decoded parts are remembered,  \n\
+so accessing them again is cheap.  The default value is false.               \n\
+This option cannot be combined with @qcode{\"Schema\"}.                      \n\
+                                                                             \n\
+NOTE: Decoding and encoding JSON text is not guaranteed to reproduce the     \n\
+original text as some names may be changed by @code{matlab.lang.makeValidName}. \n\
+                                                                             \n\
+This table shows the conversions from JSON data types to Octave data types:  \n\
+                                                                             \n\
+@multitable @columnfractions 0.50 0.50                                       \n\
+@headitem JSON data type @tab Octave data type                               \n\
+@item Boolean @tab scalar logical                                            \n\
+@item Number @tab scalar double                                              \n\
+@item String @tab vector of characters                                       \n\
+@item Object @tab scalar struct (field names of the struct may be different  \n\
+      from the keys of the JSON object due to @code{matlab_lang_makeValidName} \n\
+@item null, inside a numeric array @tab @code{NaN}                           \n\
+@item null, inside a non-numeric array @tab empty double array @code{[]}     \n\
+@item Array, of different data types @tab cell array                         \n\
+@item Array, of Booleans @tab logical array                                  \n\
+@item Array, of Numbers @tab double array                                    \n\
+@item Array, of Strings @tab cell array of character vectors (@code{cellstr}) \n\
+@item Array of Objects, same field names @tab struct array                   \n\
+@item Array of Objects, different field names @tab cell array of scalar structs \n\
+@end multitable                                                              \n\
+                                                                             \n\
+Examples:                                                                    \n\
+                                                                             \n\
+@example                                                                     \n\
+@group                                                                       \n\
+jsondecode ('[1, 2, null, 3]')                                               \n\
+    @result{} ans =                                                          \n\
+                                                                             \n\
+      1                                                                      \n\
+      2                                                                      \n\
+    NaN                                                                      \n\
+      3                                                                      \n\
+@end group                                                                   \n\
+                                                                             \n\
+@group                                                                       \n\
+jsondecode ('[\"foo\", \"bar\", [\"foo\", \"bar\"]]')                        \n\
+    @result{} ans =                                                          \n\
+       @{                                                                    \n\
+         [1,1] = foo                                                         \n\
+         [2,1] = bar                                                         \n\
+         [3,1] =                                                             \n\
+         @{                                                                  \n\
+           [1,1] = foo                                                       \n\
+           [2,1] = bar                                                       \n\
+         @}                                                                  \n\
+                                                                             \n\
+       @}                                                                    \n\
+@end group                                                                   \n\
+                                                                             \n\
+@group                                                                       \n\
+jsondecode ('@{\"nu#m#ber\": 7, \"s#tr#ing\": \"hi\"@}', ...                 \n\
+            'ReplacementStyle', 'delete')                                    \n\
+    @result\{} scalar structure containing the fields:                       \n\
+                                                                             \n\
+         number = 7                                                          \n\
+         string = hi                                                         \n\
+@end group                                                                   \n\
+                                                                             \n\
+@group                                                                       \n\
+jsondecode ('@{\"nu#m#ber\": 7, \"s#tr#ing\": \"hi\"@}', ...                 \n\
+            'makeValidName', false)                                          \n\
+    @result\{} scalar structure containing the fields:                       \n\
+                                                                             \n\
+         nu#m#ber = 7                                                        \n\
+         s#tr#ing = hi                                                       \n\
+@end group                                                                   \n\
+                                                                             \n\
+@group                                                                       \n\
+jsondecode ('@{\"1\": \"one\", \"2\": \"two\"@}', 'Prefix', 'm_')            \n\
+    @result\{} scalar structure containing the fields:                       \n\
+                                                                             \n\
+         m_1 = one                                                           \n\
+         m_2 = two                                                           \n\
+@end group                                                                   \n\
+                                                                             \n\
+@group                                                                       \n\
+jsondecode ('[@{\"id\": 1, \"tags\": [\"a\"]@}]', ...                        \n\
+            'Schema', @{struct ('id', int32 (0), 'tags', @{@{''@}@})@})       \n\
+    @result\{} 1x1 struct array containing the fields:                       \n\
+                                                                             \n\
+         id                                                                  \n\
+         tags                                                                \n\
+@end group                                                                   \n\
+@end example                                                                 \n\
+                                                                             \n\
+@seealso{jsonencode, matlab.lang.makeValidName}                              \n\
+@end deftypefn ")
+{
+#if defined (HAVE_RAPIDJSON)
+
+  int nargin = args.length ();
+
+  // makeValidName options are pairs, the number of arguments must be odd.
+  if (! (nargin % 2))
+    print_usage ();
+
+  jsondecode_settings settings (args, 1);
+
+  if (args(0).iscell ())
+    {
+      if (! args(0).iscellstr ())
+        error ("jsondecode: JSON_TXT must be a cell array of strings");
+      if (settings.lazy)
+        error ("jsondecode: the 'Lazy' option cannot be used with a cell "
+               "array JSON_TXT");
+      if (settings.format != "json")
+        error ("jsondecode: a cell array JSON_TXT must contain JSON text");
+      return decode_batch (args(0).cell_value (), settings);
+    }
+
+  std::string json;
+  if (args(0).is_string ())
+    json = args(0).string_value ();
+  else if (args(0).is_uint8_type ())
+    {
+      uint8NDArray bytes = args(0).uint8_array_value ();
+      json.assign (reinterpret_cast<const char *> (bytes.data ()),
+                   bytes.numel ());
+    }
+  else
+    error ("jsondecode: JSON_TXT must be a character string or uint8 array");
+
+  // The document of a lazy call is kept alive by the returned handle,
+  // only other calls take the memory of the arena.
+  std::shared_ptr<lazy_document> lazy_doc;
+  std::unique_ptr<arena_document> local_document;
+  if (settings.lazy)
+    lazy_doc = std::make_shared<lazy_document> (settings);
+  else
+    local_document.reset (new arena_document ());
+  rapidjson::Document& d = lazy_doc ? lazy_doc->document ()
+                                    : local_document->document ();
+
+  // Typed arrays are decoded from JSON, which has to outlive the
+  // document.  Lazy documents and schemas read the DOM only.
+  typed_array_table typed_arrays;
+  bool direct = ! lazy_doc && ! settings.has_schema;
+  if (settings.format != "json")
+    parse_binary (d, reinterpret_cast<const uint8_t *> (json.data ()),
+                  json.size (), settings.format,
+                  direct ? &typed_arrays : nullptr);
+  else
+    // DOM is chosen instead of SAX as SAX publishes events to a handler
+    // that decides what to do depending on the event only.  This will
+    // cause a problem in decoding JSON arrays as the output may be an
+    // array or a cell and that doesn't only depend on the event
+    // (startArray) but also on the types of the elements inside the array.
+    parse_json (d, json.data (), json.size (), settings);
+
+  if (lazy_doc)
+    {
+      register_type_once<octave_lazy_json> (interp);
+      return octave_value (new octave_lazy_json (lazy_doc, &d));
+    }
+
+  return decode_document (d, settings, &typed_arrays);
+
+#else
+
+  octave_unused_parameter (interp);
+  octave_unused_parameter (args);
+
+  err_disabled_feature ("jsondecode", "JSON decoding through RapidJSON");
+
+#endif
+}
+
+/*
 Functional BIST tests are located in test/json/jsondecode_BIST.tst
 
-## Input validation tests
+## Input validation tests
+%!test
+%! fail ("jsondecode ()");
+%! fail ("jsondecode ('1', 2)");
+%! fail ("jsondecode (1)", "JSON_TXT must be a character string");
+%! fail ("jsondecode ('1', 'Format', 'bson')", "'Format' must be");
+%! fail ("jsondecode ('12-')", "parse error at offset 3");
+
+## Binary formats
+%!test
+%! data = struct ('a', {1; 2}, 'b', {'x'; [1, 2, 3]}, 'c', {true; false});
+%! for fmt = {'cbor', 'msgpack'}
+%!   bytes = jsonencode (data, 'Format', fmt{1});
+%!   assert (jsondecode (bytes, 'Format', fmt{1}), jsondecode (jsonencode (data)));
+%! endfor
+%! x = {[1.5, NaN; -Inf, 4], 'str', {}, struct()};
+%! for fmt = {'cbor', 'msgpack'}
+%!   bytes = jsonencode (x, 'Format', fmt{1}, 'ConvertInfAndNaN', false);
+%!   assert (jsondecode (bytes, 'Format', fmt{1}), ...
+%!           jsondecode (jsonencode (x, 'ConvertInfAndNaN', false)));
+%! endfor
+
+%!test
+%! ## CBOR indefinite-length map and array, half and single floats
+%! bytes = uint8 ([191, 97, 97, 159, 249, 60, 0, 250, 63, 192, 0, 0, 255, 255]);
+%! assert (jsondecode (bytes, 'Format', 'cbor'), struct ('a', [1; 1.5]));
+%! ## CBOR typed array of little-endian int16 (tag 77)
+%! bytes = uint8 ([216, 77, 68, 1, 0, 254, 255]);
+%! assert (jsondecode (bytes, 'Format', 'cbor'), [1; -2]);
+%! assert (jsondecode ([uint8(130), bytes, bytes], 'Format', 'cbor'), ...
+%!         [1, -2; 1, -2]);
+%! ## CBOR typed array of big-endian float64 (tag 82)
+%! bytes = uint8 ([216, 82, 80, 63, 240, 0, 0, 0, 0, 0, 0, ...
+%!                 192, 0, 0, 0, 0, 0, 0, 0]);
+%! assert (jsondecode (bytes, 'Format', 'cbor'), [1; -2]);
+%! assert (jsondecode ([uint8([161, 97, 97]), bytes], 'Format', 'cbor'), ...
+%!         struct ('a', [1; -2]));
+%! ## MessagePack map16 with negative fixint and uint16
+%! bytes = uint8 ([222, 0, 2, 161, 120, 255, 161, 121, 205, 1, 0]);
+%! assert (jsondecode (bytes, 'Format', 'msgpack'), struct ('x', -1, 'y', 256));
+
+%!test
+%! ## Large typed arrays as values, array elements, and map values
+%! x = (1:200000)' / 7;
+%! assert (jsondecode (jsonencode (x, 'Format', 'cbor'), 'Format', 'cbor'), x);
+%! m = reshape (1:6000, 3, 2000) / 3;
+%! assert (jsondecode (jsonencode (m, 'Format', 'cbor'), 'Format', 'cbor'), m);
+%! c = jsondecode (jsonencode ({x, 'a', x}, 'Format', 'cbor'), 'Format', 'cbor');
+%! assert (c, {x; 'a'; x});
+%! s = jsondecode (jsonencode (struct ('v', x), 'Format', 'cbor'), ...
+%!                 'Format', 'cbor');
+%! assert (s, struct ('v', x));
+%! assert (jsondecode (jsonencode ({'x'}, 'Format', 'cbor'), 'Format', 'cbor'), ...
+%!         {'x'});
+
+%!test
+%! fail ("jsondecode (uint8 ([130, 1]), 'Format', 'cbor')", ...
+%!       'CBOR parse error at offset 2: unexpected end of data');
+%! fail ("jsondecode (uint8 ([1, 2]), 'Format', 'cbor')", 'trailing data');
+%! fail ("jsondecode (uint8 ([161, 1, 2]), 'Format', 'cbor')", ...
+%!       'map keys must be text strings');
+%! fail ("jsondecode (uint8 (193), 'Format', 'msgpack')", ...
+%!       'MessagePack parse error at offset 2: unsupported type');
+
+## Deeply nested input
+%!test
+%! n = 10000;
+%! txt = [repmat('{"a":', 1, n), '1', repmat('}', 1, n)];
+%! x = jsondecode (txt);
+%! assert (jsonencode (x), txt);
+%! for i = 1:n
+%!   x = x.a;
+%! endfor
+%! assert (x, 1);
+%! txt = [repmat('["x",', 1, n), '1', repmat(']', 1, n)];
+%! x = jsondecode (txt);
+%! assert (jsonencode (x), txt);
+%! for i = 1:n
+%!   x = x{2};
+%! endfor
+%! assert (x, 1);
+
+## Arrays of arrays larger than one tile of the transpose
+%!test
+%! x = reshape (1:70*45*3, 70, 45, 3);
+%! assert (jsondecode (jsonencode (x)), x);
+%! s = struct ('a', num2cell (reshape (1:40*35, 40, 35)));
+%! assert (jsondecode (jsonencode (s)), s);
+
+## Arrays that stop being numeric or boolean late
+%!test
+%! x = [1:1000, NaN]';
+%! assert (jsondecode (jsonencode (x)), x);
+%! assert (jsondecode ('[null, null]'), [NaN; NaN]);
+%! assert (jsondecode ('[1, 2, null, "a"]'), {1; 2; []; 'a'});
+%! assert (jsondecode ('[null, 1, true]'), {[]; 1; true});
+%! assert (jsondecode ('[true, false, 1]'), {true; false; 1});
+%! assert (jsondecode ('[false, [true]]'), {false; true});
+%! assert (jsondecode (['[', repmat('1,', 1, 5000), '{}]']), ...
+%!         [num2cell(ones (5000, 1)); {struct()}]);
+
+## ReplacementStyle "hex" on long keys
+%!test
+%! s = jsondecode ('{"a-b c":1}', 'ReplacementStyle', 'hex');
+%! assert (fieldnames (s), {'a0x2DbC'});
+%! s = jsondecode (['{"', repmat('a-', 1, 5000), '":1}'], 'ReplacementStyle', 'hex');
+%! assert (fieldnames (s), {repmat('a0x2D', 1, 5000)});
+
+## Objects with shared field layouts
+%!test
+%! x = jsondecode ('[{"a":1,"b":"x"},[1,2],{"a":2,"b":"y"},{"b":3,"a":4}]');
+%! assert (x, {struct('a', 1, 'b', 'x'); [1; 2]; struct('a', 2, 'b', 'y'); ...
+%!             struct('b', 3, 'a', 4)});
+%! assert (fieldnames (x{4}), {'b'; 'a'});
+%! x{1}.c = 5;
+%! assert (fieldnames (x{3}), {'a'; 'b'});
+%! x = jsondecode ('[{"1":1,"x1":2},true,{"1":3,"x1":4}]');
+%! assert (x, {struct('x1', 2); true; struct('x1', 4)});
+%! x = jsondecode ('[{"a b":1},1,{"a b":2}]', 'makeValidName', false);
+%! assert ({getfield(x{1}, 'a b'), getfield(x{3}, 'a b')}, {1, 2});
+
+## NumericEncoding option
+%!test
+%! x = rand (3, 4, 2);
+%! txt = jsonencode (x, 'NumericEncoding', 'base64');
+%! assert (jsondecode (txt, 'NumericEncoding', 'base64'), x);
+%! data = struct ('a', int16 ([1, -1; 300, -300]), 'b', single ([0.1; NaN]), ...
+%!                'c', logical ([1, 0, 1]), 'd', 'str', 'e', zeros (0, 3));
+%! txt = jsonencode (data, 'NumericEncoding', 'base64');
+%! assert (jsondecode (txt, 'NumericEncoding', 'base64'), data);
+
+%!test
+%! txt = '{"dtype":"uint8","shape":[1,3],"data":"AQID"}';
+%! assert (jsondecode (txt, 'NumericEncoding', 'base64'), uint8 ([1, 2, 3]));
+%! assert (jsondecode (txt), ...
+%!         struct ('dtype', 'uint8', 'shape', [1; 3], 'data', 'AQID'));
+%! txt = ['[{"dtype":"int16","shape":[2],"data":"AQD//w=="},', ...
+%!        '{"dtype":"bool","shape":[1,2],"data":"AQA="}]'];
+%! assert (jsondecode (txt, 'NumericEncoding', 'base64'), ...
+%!         {int16([1; -1]); [true, false]});
+
+%!test
+%! fail ("jsondecode ('1', 'NumericEncoding', 1)", ...
+%!       "'NumericEncoding' value must be a string");
+%! fail ("jsondecode ('1', 'NumericEncoding', 'hex')", ...
+%!       "'NumericEncoding' must be");
+%! opts = {'NumericEncoding', 'base64'};
+%! fail (@() jsondecode ('{"dtype":"uint8","shape":[1,2],"data":"AQID"}', ...
+%!                       opts{:}), 'does not match "shape"');
+%! fail (@() jsondecode ('{"dtype":"float64","shape":[1000000000,1],"data":"AQID"}', ...
+%!                       opts{:}), 'does not match "shape"');
+%! fail (@() jsondecode (['{"dtype":"float64","shape":', ...
+%!                        '[4294967296,4294967296,4294967296],"data":""}'], ...
+%!                       opts{:}), 'does not match "shape"');
+%! fail (@() jsondecode ('{"dtype":"uint8","shape":[1,3],"data":"AQ*D"}', ...
+%!                       opts{:}), 'invalid base64');
+%! fail (@() jsondecode ('{"dtype":"char","shape":[1,1],"data":"AA=="}', ...
+%!                       opts{:}), 'unknown "dtype"');
+
+## SparseEncoding option
+%!test
+%! S = sprand (50, 40, 0.1);
+%! txt = jsonencode (S, 'SparseEncoding', 'compact');
+%! assert (jsondecode (txt, 'SparseEncoding', 'compact'), S);
+%! data = struct ('a', sparse ([true, false; false, true]), 'b', sparse (3, 0));
+%! txt = jsonencode (data, 'SparseEncoding', 'compact');
+%! assert (jsondecode (txt, 'SparseEncoding', 'compact'), data);
+%! txt = '{"sparse":true,"size":[2,2],"i":[2,2],"j":[1,1],"v":[3,4]}';
+%! assert (jsondecode (txt, 'SparseEncoding', 'compact'), sparse ([0, 0; 7, 0]));
+%! assert (jsondecode (txt), struct ('sparse', true, 'size', [2; 2], ...
+%!                                   'i', [2; 2], 'j', [1; 1], 'v', [3; 4]));
+
+%!test
+%! fail ("jsondecode ('1', 'SparseEncoding', 'coo')", ...
+%!       "'SparseEncoding' must be");
+%! opts = {'SparseEncoding', 'compact'};
+%! fail (@() jsondecode ('{"sparse":true,"size":[2],"i":[],"j":[],"v":[]}', ...
+%!                       opts{:}), '"size" must contain two');
+%! fail (@() jsondecode ('{"sparse":true,"size":[2,2],"i":[1],"j":[],"v":[1]}', ...
+%!                       opts{:}), 'arrays of the same length');
+%! fail (@() jsondecode ('{"sparse":true,"size":[2,2],"i":[3],"j":[1],"v":[1]}', ...
+%!                       opts{:}), 'out of bound');
+
+## Lazy option
+%!test
+%! txt = ['{"data": [{"name": "a", "v": [1, 2]}, {"name": "b", "v": [3, 4]}], ', ...
+%!        '"n": 2, "a b": true}'];
+%! h = jsondecode (txt, 'Lazy', true);
+%! assert (class (h), 'lazy_json');
+%! assert (h.n, 2);
+%! assert (h.data(2).name, 'b');
+%! assert (h.data(2).v, [3; 4]);
+%! assert (h.data(1).v(2), 2);
+%! assert (h.a_b, true);
+%! ref = jsondecode (txt);
+%! assert (h.data, ref.data);
+%! assert (h.data([2, 1]), ref.data([2, 1]));
+%! assert (h(), ref);
+%! h2 = jsondecode (txt, 'Lazy', true, 'makeValidName', false);
+%! assert (h2.('a b'), true);
+%! fail ("h.nosuchkey", "no JSON key for field 'nosuchkey'");
+%! fail ("h.data(3)", "out of bound");
+%! fail ("h.data(1.5)", "must be a positive integer");
+
+%!test
+%! txt = ['{"m": [[1, 2], [3, 4]], "v": [1, null, 3], "c": [1, "x", [2, 3]], ', ...
+%!        '"s": ["a", "b"], "o": [{"a": 1}, {"b": 2}], "e": [], ', ...
+%!        '"p": [{"a": 1, "b": 2}, {"b": 3, "a": 4}]}'];
+%! ref = jsondecode (txt);
+%! h = jsondecode (txt, 'Lazy', true);
+%! assert (h.m(2), ref.m(2));
+%! assert (h.m(2, :), ref.m(2, :));
+%! assert (h.v(2), ref.v(2));
+%! assert (h.c(2), ref.c(2));
+%! assert (h.c{2}, ref.c{2});
+%! assert (h.c{3}(2), ref.c{3}(2));
+%! assert (h.s{1}, ref.s{1});
+%! assert (h.s(1), ref.s(1));
+%! assert (h.o{2}, ref.o{2});
+%! assert (h.o(2), ref.o(2));
+%! assert (h.p(2), ref.p(2));
+%! fail ("h.m{2}");
+%! fail ("h.e(1)");
+%! h = jsondecode (txt, 'Lazy', true, 'MergeObjects', 'fill');
+%! ref = jsondecode (txt, 'MergeObjects', 'fill');
+%! assert (h.o(2), ref.o(2));
+%! assert (h.p(2), ref.p(2));
+
+%!test
+%! fail ("jsondecode ('1', 'Lazy', 1)", "'Lazy' value must be a bool");
+%! fail ("jsondecode ('1', 'Lazy', true, 'Schema', 0)", "cannot be combined");
+
+## Cell array of JSON texts
+%!test
+%! c = {'{"a":1,"b":"x"}', '{"a":2,"b":"y"}'; '{"a":3,"b":"z"}', '{"a":4,"b":""}'};
+%! s = jsondecode (c);
+%! assert (size (s), [2, 2]);
+%! assert ([s.a], [1, 3, 2, 4]);
+%! assert (s(2,1).b, 'z');
+%! assert (jsondecode (c, 'Threads', 3), s);
+%! c = {'[1,2]'; '{"a":1}'; '"str"'; 'null'};
+%! assert (jsondecode (c), {[1; 2]; struct('a', 1); 'str'; []});
+%! assert (jsondecode ({'{"a":1}', '{"b":2}'}), {struct('a', 1), struct('b', 2)});
+%! assert (jsondecode ({'[{"a":1},{"a":2}]'}), {struct('a', {1; 2})});
+%! assert (jsondecode (cell (0, 1)), cell (0, 1));
+%! c = repmat ({'{"k":[true,false]}'}, 1, 1000);
+%! c{end} = '{"k":5}';
+%! s = jsondecode (c, 'Threads', 4, 'InternStrings', true);
+%! assert (size (s), [1, 1000]);
+%! assert (s(999).k, [true; false]);
+%! assert (s(1000).k, 5);
+
+%!test
+%! ## Texts larger than the initial memory of a slot, which is reused by
+%! ## the following blocks.
+%! c = repmat ({jsonencode(1:5000)}, 1, 600);
+%! c{end} = jsonencode ({1:10, 'x'});
+%! obs = jsondecode (c);
+%! assert (size (obs), [1, 600]);
+%! assert (obs{300}, (1:5000)');
+%! assert (obs{end}, {(1:10)'; 'x'});
+
+%!test
+%! c = repmat ({'1'}, 1, 600);
+%! c{555} = '[1,';
+%! fail ("jsondecode (c, 'Threads', 2)", "parse error in element 555");
+%! fail ("jsondecode ({'1', 2})", "JSON_TXT must be a cell array of strings");
+%! fail ("jsondecode ({'1'}, 'Lazy', true)", "'Lazy' option cannot be used");
+%! fail ("jsondecode ({'1'}, 'Threads', 0)", "'Threads' must be a positive");
+
+## MergeObjects option
+%!test
+%! txt = '[{"a":1,"b":"x"},{"b":"y","a":2}]';
+%! assert (jsondecode (txt), {struct('a', 1, 'b', 'x'); struct('b', 'y', 'a', 2)});
+%! assert (jsondecode (txt, 'MergeObjects', 'ordered'), jsondecode (txt));
+%! s = jsondecode (txt, 'MergeObjects', 'unordered');
+%! assert (s, struct ('a', {1; 2}, 'b', {'x'; 'y'}));
+%! assert (jsondecode (txt, 'MergeObjects', 'fill'), s);
+%! txt = '[{"a":1},{"b":2,"a":3},{}]';
+%! assert (jsondecode (txt, 'MergeObjects', 'unordered'), ...
+%!         {struct('a', 1); struct('b', 2, 'a', 3); struct()});
+%! s = jsondecode (txt, 'MergeObjects', 'fill');
+%! assert (fieldnames (s), {'a'; 'b'});
+%! assert (s, struct ('a', {1; 3; []}, 'b', {[]; 2; []}));
+%! assert (jsondecode ('[{"a":1},{"a":2,"b":3}]', 'MergeObjects', 'unordered'), ...
+%!         {struct('a', 1); struct('a', 2, 'b', 3)});
+%! assert (jsondecode ('[{"a":1},[1,2]]', 'MergeObjects', 'fill'), ...
+%!         {struct('a', 1); [1; 2]});
+%! assert (jsondecode ({'{"a":1,"b":2}', '{"b":3,"a":4}'}, ...
+%!                     'MergeObjects', 'unordered'), ...
+%!         struct ('a', {1, 4}, 'b', {2, 3}));
+%! fail ("jsondecode ('[]', 'MergeObjects', 'sorted')", ...
+%!       "'MergeObjects' must be");
+
+## ArrayOfObjects option
+%!test
+%! txt = '[{"id":1,"ok":true,"name":"a","v":[1,2]},{"ok":false,"id":2,"name":"b","v":null},{"id":null,"ok":true,"name":null,"v":"x"}]';
+%! c = jsondecode (txt, 'ArrayOfObjects', 'columns');
+%! assert (fieldnames (c), {'id'; 'ok'; 'name'; 'v'});
+%! assert (c.id, [1; 2; NaN]);
+%! assert (c.ok, [true; false; true]);
+%! assert (c.name, {'a'; 'b'; ''});
+%! assert (c.v, {[1; 2]; []; 'x'});
+%! c = jsondecode ('[{"a":1,"b":true},{"c":"x","a":2},{}]', ...
+%!                 'ArrayOfObjects', 'columns');
+%! assert (c, struct ('a', [1; 2; NaN], 'b', [1; NaN; NaN], ...
+%!                    'c', {{''; 'x'; ''}}));
+%! c = jsondecode ('{"t":[{"x":{"y":[{"z":1},{"z":2}]}},{"x":3}]}', ...
+%!                 'ArrayOfObjects', 'columns');
+%! assert (c.t.x, {struct('y', struct ('z', [1; 2])); 3});
+%! c = jsondecode ('[{"1":1,"x1":2},{"x1":3}]', 'ArrayOfObjects', 'columns');
+%! assert (c, struct ('x1', [2; 3]));
+%! c = jsondecode ('[{"a":1},{"a":2}]', 'ArrayOfObjects', 'columns', ...
+%!                 'NumberParsing', 'raw');
+%! assert (c.a, {'1'; '2'});
+%! assert (jsondecode ('[{"a":1},{"a":2}]', 'ArrayOfObjects', 'structs'), ...
+%!         struct ('a', {1; 2}));
+%! fail ("jsondecode ('[]', 'ArrayOfObjects', 'rows')", ...
+%!       "'ArrayOfObjects' must be");
+
+## ValidateUTF8 option
+%!test
+%! txt = ['"', char([195, 169, 226, 130, 172, 240, 159, 152, 128]), '"'];
+%! assert (jsondecode (txt, 'ValidateUTF8', true), jsondecode (txt));
+%! assert (jsondecode (['"', char(255), '"']), char (255));
+%! fail ("jsondecode (['\"', char(255), '\"'], 'ValidateUTF8', true)", ...
+%!       "invalid UTF-8 at offset 2");
+%! fail ("jsondecode (['\"', repmat('a', 1, 20), char([192, 128]), '\"'], 'ValidateUTF8', true)", ...
+%!       "invalid UTF-8 at offset 22");
+%! fail ("jsondecode (['\"', char([237, 160, 128]), '\"'], 'ValidateUTF8', true)", ...
+%!       "invalid UTF-8 at offset 2");
+%! fail ("jsondecode (['\"', char([244, 144, 128, 128]), '\"'], 'ValidateUTF8', true)", ...
+%!       "invalid UTF-8 at offset 2");
+%! fail ("jsondecode (['1 ', char([226, 130])], 'ValidateUTF8', true)", ...
+%!       "invalid UTF-8 at offset 3");
+%! fail ("jsondecode ({'1', char([34, 200, 34])}, 'ValidateUTF8', true)", ...
+%!       "invalid UTF-8 in element 2 at offset 2");
+%! h = jsondecoder ('ValidateUTF8', true);
+%! fail ("jsondecoder_feed (h, ['[1] \"', char(255), '\"'])", "invalid UTF-8 at offset 6");
+
+## InternStrings option
+%!test
+%! txt = '[{"u":"m","v":1},{"u":"s","v":2},["m","s","m"],"m"]';
+%! assert (jsondecode (txt, 'InternStrings', true), jsondecode (txt));
+%! x = jsondecode (txt, 'InternStrings', true);
+%! x{3}{1}(1) = 'k';
+%! assert (x{3}, {'k'; 's'; 'm'});
+%! assert (x{4}, 'm');
+%! assert (x{1}.u, 'm');
+%! s = jsondecode ('{"a":"x","b":"x"}', 'InternStrings', true, ...
+%!                 'Schema', struct ('a', '', 'b', ''));
+%! assert (s, struct ('a', 'x', 'b', 'x'));
+%! h = jsondecode (txt, 'Lazy', true, 'InternStrings', true);
+%! assert (h{4}, 'm');
+%! fail ("jsondecode ('1', 'InternStrings', 'yes')", ...
+%!       "'InternStrings' value must be a bool");
+
+## NumberParsing option
+%!test
+%! txt = '[0.1, 1e-300, 9007199254740993, -5, 2.2250738585072011e-308]';
+%! fast = jsondecode (txt);
+%! exact = jsondecode (txt, 'NumberParsing', 'exact');
+%! assert (exact, [0.1; 1e-300; 9007199254740992; -5; 2.2250738585072011e-308]);
+%! assert (fast, exact, eps);
+%! assert (jsondecode (txt, 'NumberParsing', 'raw'), ...
+%!         {'0.1'; '1e-300'; '9007199254740993'; '-5'; '2.2250738585072011e-308'});
+%! assert (jsondecode ('{"id": 12345678901234567890}', 'NumberParsing', 'raw'), ...
+%!         struct ('id', '12345678901234567890'));
+%! h = jsondecoder ('NumberParsing', 'raw');
+%! assert (jsondecoder_feed (h, '1.50 '), {'1.50'});
+%! fail ("jsondecode ('1', 'NumberParsing', 'slow')", "'NumberParsing' must be");
+
+## Schema option
+%!test
+%! tmpl = struct ('id', int32 (0), 'name', '', 'scores', zeros (0, 1), ...
+%!                'flags', false (1, 0), 'tags', {{''}});
+%! obs = jsondecode (['{"id": 7, "name": "a", "scores": [1, null], ', ...
+%!                    '"flags": [true, false], "tags": ["x", "y"]}'], ...
+%!                   'Schema', tmpl);
+%! assert (obs.id, int32 (7));
+%! assert (obs.name, 'a');
+%! assert (obs.scores, [1; NaN]);
+%! assert (obs.flags, [true, false]);
+%! assert (obs.tags, {'x'; 'y'});
+
+%!test
+%! tmpl = {struct ('a', 0, 'b', [])};
+%! obs = jsondecode ('[{"b": "x", "a": 1}, {"a": 2, "b": [1, 2]}]', ...
+%!                   'Schema', tmpl);
+%! assert (size (obs), [2, 1]);
+%! assert ({obs.a}, {1, 2});
+%! assert ({obs.b}, {'x', [1; 2]});
+
+%!test
+%! obs = jsondecode ('[[1, 2, 3], [4, 5, 6]]', 'Schema', zeros (0, 3, 'single'));
+%! assert (obs, single ([1, 2, 3; 4, 5, 6]));
+%! obs = jsondecode ('{"my key": 1}', 'Schema', struct ('myKey', 0));
+%! assert (obs, struct ('myKey', 1));
+%! obs = jsondecode ('[]', 'Schema', {struct('a', 0)});
+%! assert (size (obs), [0, 1]);
+
+%!test
+%! tmpl = struct ('data', {{struct ('name', '')}});
+%! fail ("jsondecode ('{\"data\": [{\"name\": \"a\"}, {\"name\": 1}]}', 'Schema', tmpl)", ...
+%!       'Schema mismatch at \$\.data\[1\]\.name: expected string, found number');
+%! fail ("jsondecode ('{\"a\": 1}', 'Schema', struct ('b', 0))", ...
+%!       'unexpected key "a"');
+%! fail ("jsondecode ('{}', 'Schema', struct ('b', 0))", 'missing key "b"');
+%! fail ("jsondecode ('[1, null]', 'Schema', zeros (0, 1, 'int8'))", ...
+%!       'at \$\[1\]: expected number, found null');
+%! fail ("jsondecode ('1', 'Schema', @sin)", 'unsupported template');
+
+%!test
+%! obs = jsondecode ('[9007199254740993, -9223372036854775808]', ...
+%!                   'Schema', zeros (1, 0, 'int64'));
+%! assert (obs, [int64(9007199254740992) + int64(1), intmin('int64')]);
+%! obs = jsondecode ('18446744073709551615', 'Schema', uint64 (0));
+%! assert (obs, intmax ('uint64'));
+%! obs = jsondecode ('[1.0, 1e2]', 'Schema', zeros (1, 0, 'int32'));
+%! assert (obs, int32 ([1, 100]));
+%! fail ("jsondecode ('{\"a\": 1.5}', 'Schema', struct ('a', int32 (0)))", ...
+%!       'at \$\.a: expected int32 value, found 1\.5');
+%! fail ("jsondecode ('[1, 300]', 'Schema', zeros (0, 1, 'uint8'))", ...
+%!       'at \$\[1\]: expected uint8 value, found 300');
+%! fail ("jsondecode ('-1', 'Schema', uint64 (0))", ...
+%!       'expected uint64 value, found -1');
+%! fail ("jsondecode ('9223372036854775808', 'Schema', int64 (0))", ...
+%!       'expected int64 value, found 9223372036854775808');
+
+*/
+
+// PKG_ADD: autoload ("jsondecodefile", "jsondecode.oct");
+// PKG_DEL: autoload ("jsondecodefile", which ("jsondecode"), "remove");
+
+DEFMETHOD_DLD (jsondecodefile, interp, args, ,
+               "-*- texinfo -*-\n\
+@deftypefn  {} {@var{object} =} jsondecodefile (@var{filename})              \n\
+@deftypefnx {} {@var{object} =} jsondecodefile (@dots{}, @var{option}, @var{value}, @dots{}) \n\
+@deftypefnx {} {@var{elems} =} jsondecodefile (@var{filename}, \"Index\", @var{idx}, \"Elements\", @var{k}, @dots{}) \n\
+                                                                             \n\
+Decode the JSON text of the file @var{filename}.                             \n\
+                                                                             \n\
+Files compressed with gzip or zstd are detected by their first bytes and    \n\
+decompressed while they are parsed, the whole text is never held in         \n\
+memory.  Other files are read as they are.  zstd is only supported if the    \n\
+package has been built with it.                                              \n\
+                                                                             \n\
+The options are the same as for @code{jsondecode}, the option               \n\
+@qcode{\"Format\"} must be @qcode{\"json\"}.  With                          \n\
+@qcode{\"ValidateUTF8\"}, the UTF-8 encoding of the strings is validated    \n\
+while parsing.                                                               \n\
+                                                                             \n\
+With the options @qcode{\"Index\"} and @qcode{\"Elements\"}, only the      \n\
+elements @var{k} of the file are read and decoded, where @var{idx} is the   \n\
+index of the file returned by @code{jsonindex}.  Thus the cost of reading   \n\
+a record depends on its size, not on the size of the file.  If @var{k} is  \n\
+a scalar, @var{elems} is the decoded element.  Otherwise @var{elems} is a   \n\
+cell array with the dimensions of @var{k}, or a struct array if all        \n\
+elements are scalar structs with the same fields, as for a cell array       \n\
+input of @code{jsondecode}.                                                  \n\
+                                                                             \n\
+Example:                                                                     \n\
+                                                                             \n\
+@example                                                                     \n\
+@group                                                                       \n\
+s = jsondecodefile (\"catalog.json.gz\");                                    \n\
+idx = jsonindex (\"records.ndjson\");                                        \n\
+r = jsondecodefile (\"records.ndjson\", \"Index\", idx, \"Elements\", 42);   \n\
+@end group                                                                   \n\
+@end example                                                                 \n\
+                                                                             \n\
+@seealso{jsondecode, jsonencodefile, jsonindex}                              \n\
+@end deftypefn")
+{
+#if defined (HAVE_RAPIDJSON)
+
+  int nargin = args.length ();
+
+  // Options are pairs, the number of arguments must be odd.
+  if (! (nargin % 2))
+    print_usage ();
+
+  std::string filename = octave::sys::file_ops::tilde_expand
+    (args(0).xstring_value ("jsondecodefile: FILENAME must be a character "
+                            "string"));
+
+  // "Index" and "Elements" are handled here, the other options by
+  // jsondecode_settings.
+  octave_value index, elements;
+  octave_value_list options;
+  for (int i = 1; i < nargin; i += 2)
+    {
+      if (args(i).is_string ()
+          && octave::string::strcmpi (args(i).string_value (), "Index"))
+        index = args(i + 1);
+      else if (args(i).is_string ()
+               && octave::string::strcmpi (args(i).string_value (),
+                                           "Elements"))
+        elements = args(i + 1);
+      else
+        options.append (args.slice (i, 2));
+    }
+
+  jsondecode_settings settings (options, 0);
+  if (settings.format != "json")
+    error ("jsondecodefile: only JSON text can be read from a file");
+
+  if (index.is_defined () != elements.is_defined ())
+    error ("jsondecodefile: the 'Index' and 'Elements' options must be "
+           "given together");
+  if (index.is_defined ())
+    {
+      if (settings.lazy)
+        error ("jsondecodefile: the 'Lazy' option cannot be used with "
+               "'Elements'");
+      return decode_elements (filename, index, elements, settings);
+    }
+
+  // The document of a lazy call is kept alive by the returned handle,
+  // only other calls take the memory of the arena.
+  std::shared_ptr<lazy_document> lazy_doc;
+  std::unique_ptr<arena_document> local_document;
+  if (settings.lazy)
+    lazy_doc = std::make_shared<lazy_document> (settings);
+  else
+    local_document.reset (new arena_document ());
+  rapidjson::Document& d = lazy_doc ? lazy_doc->document ()
+                                    : local_document->document ();
+
+  {
+    json_file_reader file (filename);
+    parse_json_stream (d, file, settings.numbers, settings.validate_utf8);
+    std::string msg = stream_error (file, d);
+    if (! msg.empty ())
+      error ("jsondecodefile: %s", msg.c_str ());
+  }
+
+  if (lazy_doc)
+    {
+      register_type_once<octave_lazy_json> (interp);
+      return octave_value (new octave_lazy_json (lazy_doc, &d));
+    }
+
+  return decode_document (d, settings);
+
+#else
+
+  octave_unused_parameter (interp);
+  octave_unused_parameter (args);
+
+  err_disabled_feature ("jsondecodefile", "JSON decoding through RapidJSON");
+
+#endif
+}
+
+/*
 %!test
-%! fail ("jsondecode ()");
-%! fail ("jsondecode ('1', 2)");
-%! fail ("jsondecode (1)", "JSON_TXT must be a character string");
-%! fail ("jsondecode ('12-')", "parse error at offset 3");
+%! txt = '{"a": [1, 2, 3], "b c": {"d": "é"}}';
+%! fname = tempname ();
+%! unwind_protect
+%!   fid = fopen (fname, 'w');
+%!   fputs (fid, txt);
+%!   fclose (fid);
+%!   assert (jsondecodefile (fname), jsondecode (txt));
+%!   assert (jsondecodefile (fname, 'makeValidName', false), ...
+%!           jsondecode (txt, 'makeValidName', false));
+%!   h = jsondecodefile (fname, 'Lazy', true);
+%!   assert (h.a, [1; 2; 3]);
+%!   gzip (fname);
+%!   assert (jsondecodefile ([fname, '.gz']), jsondecode (txt));
+%! unwind_protect_cleanup
+%!   delete (fname);
+%!   if (exist ([fname, '.gz'], 'file'))
+%!     delete ([fname, '.gz']);
+%!   endif
+%! end_unwind_protect
+
+%!test
+%! fname = tempname ();
+%! unwind_protect
+%!   fid = fopen (fname, 'w');
+%!   fwrite (fid, [91, 49, 44, 32, 50]);
+%!   fclose (fid);
+%!   fail ("jsondecodefile (fname)", "parse error at offset 6");
+%!   fid = fopen (fname, 'w');
+%!   fwrite (fid, [91, 34, 97, 255, 34, 93]);
+%!   fclose (fid);
+%!   assert (jsondecodefile (fname), {char([97, 255])});
+%!   fail ("jsondecodefile (fname, 'ValidateUTF8', true)", ...
+%!         "invalid UTF-8 at offset");
+%! unwind_protect_cleanup
+%!   delete (fname);
+%! end_unwind_protect
+
+%!test
+%! fail ("jsondecodefile ()");
+%! fail ("jsondecodefile (1)", "FILENAME must be a character string");
+%! fail ("jsondecodefile ('x.json', 'Format', 'cbor')", "only JSON text");
+%! fail ("jsondecodefile (tempname ())", "unable to open file");
+*/
+
+// PKG_ADD: autoload ("jsonindex", "jsondecode.oct");
+// PKG_DEL: autoload ("jsonindex", which ("jsondecode"), "remove");
+
+DEFUN_DLD (jsonindex, args, ,
+           "-*- texinfo -*-\n\
+@deftypefn {} {@var{idx} =} jsonindex (@var{filename})                       \n\
+                                                                             \n\
+Index the top-level elements of the JSON file @var{filename}.                \n\
+                                                                             \n\
+If the file contains a single top-level array, its elements are indexed.    \n\
+Otherwise, every top-level value is an element, e.g. each line of an NDJSON \n\
+file.  The file is not parsed, a fast scan skips the strings and counts the \n\
+brackets.  Compressed files cannot be indexed.                               \n\
+                                                                             \n\
+The index @var{idx} is a struct with the fields                              \n\
+                                                                             \n\
+@table @asis                                                                 \n\
+@item @qcode{\"file\"}                                                       \n\
+the name of the file.                                                        \n\
+@item @qcode{\"type\"}                                                       \n\
+@qcode{\"array\"} or @qcode{\"values\"}.                                     \n\
+@item @qcode{\"bytes\"}                                                      \n\
+the size of the file.                                                        \n\
+@item @qcode{\"offsets\"}, @qcode{\"lengths\"}                               \n\
+@code{uint64} column vectors of the byte offset (starting at 0) and length  \n\
+of each element.                                                             \n\
+@end table                                                                   \n\
+                                                                             \n\
+Pass @var{idx} to @code{jsondecodefile} to decode single elements without  \n\
+parsing the whole file.  @var{idx} can be saved next to the file, e.g. with \n\
+@code{save}, and is valid until the file changes.                            \n\
+                                                                             \n\
+Example:                                                                     \n\
+                                                                             \n\
+@example                                                                     \n\
+@group                                                                       \n\
+idx = jsonindex (\"records.ndjson\");                                        \n\
+n = numel (idx.offsets);                                                     \n\
+r = jsondecodefile (\"records.ndjson\", \"Index\", idx, \"Elements\", n);    \n\
+@end group                                                                   \n\
+@end example                                                                 \n\
+                                                                             \n\
+@seealso{jsondecodefile}                                                     \n\
+@end deftypefn")
+{
+#if defined (HAVE_RAPIDJSON)
+
+  if (args.length () != 1)
+    print_usage ();
+
+  std::string filename = octave::sys::file_ops::tilde_expand
+    (args(0).xstring_value ("jsonindex: FILENAME must be a character string"));
+
+  json_index index;
+  std::string msg = scan_json_index (filename, index);
+  if (! msg.empty ())
+    error ("jsonindex: %s", msg.c_str ());
+
+  octave_idx_type n = index.offsets.size ();
+  uint64NDArray offsets (dim_vector (n, 1));
+  uint64NDArray lengths (dim_vector (n, 1));
+  for (octave_idx_type i = 0; i < n; ++i)
+    {
+      offsets(i) = octave_uint64 (index.offsets[i]);
+      lengths(i) = octave_uint64 (index.lengths[i]);
+    }
+
+  octave_scalar_map retval;
+  retval.assign ("file", filename);
+  retval.assign ("type", index.array ? "array" : "values");
+  retval.assign ("bytes", octave_uint64 (index.bytes));
+  retval.assign ("offsets", offsets);
+  retval.assign ("lengths", lengths);
+
+  return ovl (retval);
+
+#else
+
+  octave_unused_parameter (args);
+
+  err_disabled_feature ("jsonindex", "JSON decoding through RapidJSON");
+
+#endif
+}
+
+/*
+%!test
+%! fname = tempname ();
+%! unwind_protect
+%!   fid = fopen (fname, 'w');
+%!   fputs (fid, '[ {"a": 1, "s": "x,]"}, [1, [2]], "str\"]" ,42 , {"a": 2, "s": "y"}]');
+%!   fclose (fid);
+%!   idx = jsonindex (fname);
+%!   assert (idx.type, 'array');
+%!   assert (idx.offsets, uint64 ([2; 24; 34; 44; 49]));
+%!   assert (idx.lengths, uint64 ([20; 8; 8; 2; 18]));
+%!   assert (jsondecodefile (fname, 'Index', idx, 'Elements', 3), 'str"]');
+%!   assert (jsondecodefile (fname, 'Index', idx, 'Elements', 4), 42);
+%!   assert (jsondecodefile (fname, 'Index', idx, 'Elements', [1, 5]), ...
+%!           struct ('a', {1, 2}, 's', {'x,]', 'y'}));
+%!   assert (jsondecodefile (fname, 'Index', idx, 'Elements', [2; 4]), ...
+%!           {{1; 2}; 42});
+%!   fail ("jsondecodefile (fname, 'Index', idx, 'Elements', 6)", ...
+%!         "'Elements' must be indices between 1 and 5");
+%!   fail ("jsondecodefile (fname, 'Index', idx)", "must be given together");
+%!   fail ("jsondecodefile (fname, 'Index', 1, 'Elements', 1)", ...
+%!         "'Index' must be a struct returned by jsonindex");
+%!   bad = idx;
+%!   bad.lengths(2) = intmax ('uint64');
+%!   fail ("jsondecodefile (fname, 'Index', bad, 'Elements', 2)", ...
+%!         "'Index' must be a struct returned by jsonindex");
+%!   bad = idx;
+%!   bad.offsets(1) = idx.bytes + 1;
+%!   fail ("jsondecodefile (fname, 'Index', bad, 'Elements', 1)", ...
+%!         "'Index' must be a struct returned by jsonindex");
+%!   fid = fopen (fname, 'w');
+%!   fprintf (fid, '{"a": 1}\n\n{"a": 2}\n  3\n"x"');
+%!   fclose (fid);
+%!   fail ("jsondecodefile (fname, 'Index', idx, 'Elements', 1)", ...
+%!         "file has changed");
+%!   idx = jsonindex (fname);
+%!   assert (idx.type, 'values');
+%!   assert (idx.bytes, uint64 (26));
+%!   assert (idx.offsets, uint64 ([0; 10; 21; 23]));
+%!   assert (idx.lengths, uint64 ([8; 8; 1; 3]));
+%!   assert (jsondecodefile (fname, 'Index', idx, 'Elements', 3), 3);
+%!   assert (jsondecodefile (fname, 'Index', idx, 'Elements', [2, 1]), ...
+%!           struct ('a', {2, 1}));
+%!   fid = fopen (fname, 'w');
+%!   fputs (fid, '[1, 2] [3]');
+%!   fclose (fid);
+%!   idx = jsonindex (fname);
+%!   assert (idx.type, 'values');
+%!   assert (idx.offsets, uint64 ([0; 7]));
+%!   fid = fopen (fname, 'w');
+%!   fputs (fid, '[1, 2');
+%!   fclose (fid);
+%!   fail ("jsonindex (fname)", "incomplete JSON value");
+%! unwind_protect_cleanup
+%!   delete (fname);
+%! end_unwind_protect
+
+%!test
+%! fail ("jsonindex ()");
+%! fail ("jsonindex (1)", "FILENAME must be a character string");
+%! fail ("jsonindex (tempname ())", "unable to open file");
+*/
+
+// PKG_ADD: autoload ("__jsondecode_arena__", "jsondecode.oct");
+// PKG_DEL: autoload ("__jsondecode_arena__", which ("jsondecode"), "remove");
+
+DEFUN_DLD (__jsondecode_arena__, args, ,
+           "-*- texinfo -*-\n\
+@deftypefn  {} {@var{stats} =} __jsondecode_arena__ ()                        \n\
+@deftypefnx {} {} __jsondecode_arena__ (\"clear\")                            \n\
+Undocumented internal function.                                              \n\
+                                                                             \n\
+Return statistics of the memory that @code{jsondecode} keeps between calls  \n\
+in the calling thread: the number of @qcode{calls}, the number of         \n\
+@qcode{spills} that needed more memory than was kept, and the               \n\
+@qcode{retained_bytes} with their upper limit @qcode{max_retained_bytes}.  \n\
+With @qcode{\"clear\"}, the kept memory is freed.                            \n\
+@end deftypefn")
+{
+#if defined (HAVE_RAPIDJSON)
+
+  int nargin = args.length ();
+  if (nargin > 1)
+    print_usage ();
+
+  decode_arena& arena = decode_arena::instance ();
+  if (nargin == 1)
+    {
+      std::string action = args(0).xstring_value ("__jsondecode_arena__: "
+        "ACTION must be a string");
+      if (action != "clear")
+        error (R"(__jsondecode_arena__: ACTION must be "clear")");
+      arena.clear ();
+    }
+
+  return ovl (arena.stats ());
+
+#else
+
+  octave_unused_parameter (args);
+
+  err_disabled_feature ("__jsondecode_arena__",
+                        "JSON decoding through RapidJSON");
+
+#endif
+}
+
+/*
+%!test
+%! __jsondecode_arena__ ('clear');
+%! s = __jsondecode_arena__ ();
+%! assert (s.retained_bytes, 0);
+%! jsondecode ('[1, 2, 3]');
+%! t = __jsondecode_arena__ ();
+%! assert (t.calls, s.calls + 1);
+%! assert (t.spills, s.spills);
+%! assert (t.retained_bytes, 64 * 1024);
+%! txt = jsonencode (num2cell (1:1e5));
+%! jsondecode (txt);
+%! t = __jsondecode_arena__ ();
+%! assert (t.spills, s.spills + 1);
+%! assert (t.retained_bytes, 64 * 1024);
+%! jsondecode (txt);
+%! u = __jsondecode_arena__ ();
+%! assert (u.spills, t.spills);
+%! assert (u.retained_bytes > 64 * 1024);
+%! assert (u.retained_bytes <= u.max_retained_bytes);
+%! jsondecode (txt);
+%! v = __jsondecode_arena__ ();
+%! assert (v.spills, u.spills);
+%! assert (v.retained_bytes, u.retained_bytes);
+%! jsondecode (txt, 'Lazy', true);
+%! w = __jsondecode_arena__ ();
+%! assert (w.calls, v.calls);
+%! fail ("__jsondecode_arena__ ('reset')", 'ACTION must be "clear"');
+*/
+
+// PKG_ADD: autoload ("jsondecoder", "jsondecode.oct");
+// PKG_DEL: autoload ("jsondecoder", which ("jsondecode"), "remove");
+
+DEFMETHOD_DLD (jsondecoder, interp, args, ,
+               "-*- texinfo -*-\n\
+@deftypefn  {} {@var{h} =} jsondecoder ()                                    \n\
+@deftypefnx {} {@var{h} =} jsondecoder (@var{option}, @var{value}, @dots{})  \n\
+                                                                             \n\
+Create an incremental decoder for JSON text that arrives in chunks.          \n\
+                                                                             \n\
+The chunks are passed to the decoder @var{h} by @code{jsondecoder_feed},    \n\
+which returns every top-level JSON value as soon as it is complete.  The     \n\
+chunk boundaries are arbitrary, e.g. the bytes received from a socket or a   \n\
+pipe.  Top-level values may be concatenated or separated by whitespace.      \n\
+Only the text of the unfinished value is kept in memory.                     \n\
+                                                                             \n\
+The options are the same as for @code{jsondecode} and apply to every decoded \n\
+value.  The option @qcode{\"Format\"} must be @qcode{\"json\"}.             \n\
+                                                                             \n\
+Copies of @var{h} refer to the same decoder.                                 \n\
+                                                                             \n\
+Example:                                                                     \n\
+                                                                             \n\
+@example                                                                     \n\
+@group                                                                       \n\
+h = jsondecoder ();                                                          \n\
+v = jsondecoder_feed (h, '@{\"a\": [1, ')                                     \n\
+    @result{} v = @{@}(0x1)                                                   \n\
+v = jsondecoder_feed (h, '2]@} @{\"a\": 3@}');                                  \n\
+v@{2@}.a                                                                      \n\
+    @result{} 3                                                              \n\
+@end group                                                                   \n\
+@end example                                                                 \n\
+                                                                             \n\
+@seealso{jsondecoder_feed, jsondecode}                                       \n\
+@end deftypefn")
+{
+#if defined (HAVE_RAPIDJSON)
+
+  // Options are pairs, the number of arguments must be even.
+  if (args.length () % 2)
+    print_usage ();
+
+  jsondecode_settings settings (args, 0);
+  if (settings.format != "json")
+    error ("jsondecoder: only JSON text can be decoded incrementally");
+  if (settings.lazy)
+    error ("jsondecoder: the 'Lazy' option is not supported");
+
+  register_type_once<octave_json_decoder> (interp);
+
+  return octave_value (new octave_json_decoder (settings));
+
+#else
+
+  octave_unused_parameter (interp);
+  octave_unused_parameter (args);
+
+  err_disabled_feature ("jsondecoder", "JSON decoding through RapidJSON");
+
+#endif
+}
+
+/*
+%!test
+%! h = jsondecoder ();
+%! assert (class (h), 'jsondecoder');
+%! assert (jsondecoder_feed (h, '{"a":'), cell (0, 1));
+%! assert (jsondecoder_feed (h, ' [1, 2]}{"b"'), {struct('a', [1; 2])});
+%! assert (jsondecoder_feed (h, ':"x}"} [true'), {struct('b', 'x}')});
+%! assert (jsondecoder_feed (h, ']"s\"]" 42'), {true; 's"]'});
+%! assert (jsondecoder_feed (h, sprintf ('\n')), {42});
+%! assert (jsondecoder_feed (h, '-7'), cell (0, 1));
+%! assert (jsondecoder_feed (h), {-7});
+
+%!test
+%! data = {struct('a', {1, 'x"}'}), [1, 2; 3, 4], 'str', NaN, true};
+%! txt = strjoin (cellfun (@(x) jsonencode (x, 'ConvertInfAndNaN', false), ...
+%!                         data, 'UniformOutput', false), ' ');
+%! h = jsondecoder ();
+%! values = {};
+%! for i = 1:numel (txt)
+%!   values = [values; jsondecoder_feed(h, uint8 (txt(i)))];
+%! endfor
+%! values = [values; jsondecoder_feed(h)];
+%! assert (values, cellfun (@(x) jsondecode (jsonencode (x, ...
+%!           'ConvertInfAndNaN', false)), data(:), 'UniformOutput', false));
+
+%!test
+%! h = jsondecoder ('ReplacementStyle', 'delete');
+%! h2 = h;
+%! assert (jsondecoder_feed (h, '{"a b":'), cell (0, 1));
+%! assert (jsondecoder_feed (h2, '1}'), {struct('ab', 1)});
+
+%!test
+%! h = jsondecoder ();
+%! fail ("jsondecoder_feed (h, '[1, }')", "parse error at offset 5");
+%! assert (jsondecoder_feed (h, '[3]'), {3});
+%! fail ("jsondecoder_feed (h, ']')", "unexpected ']'");
+%! jsondecoder_feed (h, '[1');
+%! fail ("jsondecoder_feed (h)", "incomplete JSON value");
+%! fail ("jsondecoder ('Format', 'cbor')", "only JSON text");
+%! fail ("jsondecoder ('makeValidName')");
+*/
+
+// PKG_ADD: autoload ("jsondecoder_feed", "jsondecode.oct");
+// PKG_DEL: autoload ("jsondecoder_feed", which ("jsondecode"), "remove");
+
+DEFUN_DLD (jsondecoder_feed, args, ,
+           "-*- texinfo -*-\n\
+@deftypefn  {} {@var{values} =} jsondecoder_feed (@var{h}, @var{chunk})      \n\
+@deftypefnx {} {@var{values} =} jsondecoder_feed (@var{h})                   \n\
+                                                                             \n\
+Pass the next chunk of JSON text to the incremental decoder @var{h}.         \n\
+                                                                             \n\
+@var{chunk} is a character string or a @code{uint8} array of UTF-8 encoded  \n\
+JSON text.  The output @var{values} is an Nx1 cell array of the top-level    \n\
+values that have been completed by @var{chunk}, decoded like                 \n\
+@code{jsondecode}.                                                           \n\
+                                                                             \n\
+A top-level number or literal (e.g. @code{42} or @code{true}) is only        \n\
+complete when whitespace or another value follows.  Calling                  \n\
+@code{jsondecoder_feed} without @var{chunk} signals the end of the input: a  \n\
+pending number or literal is returned and an unfinished value is an error.   \n\
+                                                                             \n\
+After a parse error, the pending text is discarded and @var{h} can be used  \n\
+for the following input.                                                     \n\
+                                                                             \n\
+@seealso{jsondecoder, jsondecode}                                            \n\
+@end deftypefn")
+{
+#if defined (HAVE_RAPIDJSON)
+
+  int nargin = args.length ();
+  if (nargin < 1 || nargin > 2)
+    print_usage ();
+
+  if (args(0).type_id () != octave_json_decoder::static_type_id ())
+    error ("jsondecoder_feed: H must be a jsondecoder object");
+
+  const octave_json_decoder& h
+    = dynamic_cast<const octave_json_decoder&> (args(0).get_rep ());
+
+  std::vector<octave_value> values;
+  if (nargin == 1)
+    values = h.decoder ().feed ("", 0, true);
+  else if (args(1).is_string ())
+    {
+      std::string chunk = args(1).string_value ();
+      values = h.decoder ().feed (chunk.data (), chunk.size ());
+    }
+  else if (args(1).is_uint8_type ())
+    {
+      uint8NDArray bytes = args(1).uint8_array_value ();
+      values = h.decoder ().feed (reinterpret_cast<const char *>
+                                    (bytes.data ()), bytes.numel ());
+    }
+  else
+    error ("jsondecoder_feed: CHUNK must be a character string or uint8 "
+           "array");
+
+  Cell retval (dim_vector (values.size (), 1));
+  for (std::size_t i = 0; i < values.size (); ++i)
+    retval(i) = values[i];
+
+  return ovl (retval);
+
+#else
+
+  octave_unused_parameter (args);
+
+  err_disabled_feature ("jsondecoder_feed",
+                        "JSON decoding through RapidJSON");
+
+#endif
+}
+
+/*
+%!test
+%! fail ("jsondecoder_feed ()");
+%! fail ("jsondecoder_feed (1, '[]')", "H must be a jsondecoder object");
+%! fail ("jsondecoder_feed (jsondecoder (), 1)", "CHUNK must be a character string");
+*/
+
+// PKG_ADD: autoload ("jsondecode_async", "jsondecode.oct");
+// PKG_DEL: autoload ("jsondecode_async", which ("jsondecode"), "remove");
+
+DEFMETHOD_DLD (jsondecode_async, interp, args, ,
+               "-*- texinfo -*-\n\
+@deftypefn  {} {@var{f} =} jsondecode_async (@var{JSON_txt})                 \n\
+@deftypefnx {} {@var{f} =} jsondecode_async (@var{filename}, \"FromFile\", true) \n\
+@deftypefnx {} {@var{f} =} jsondecode_async (@dots{}, @var{option}, @var{value}, @dots{}) \n\
+                                                                             \n\
+Start decoding JSON text in a background thread.                             \n\
+                                                                             \n\
+@var{JSON_txt} is a character string or a @code{uint8} array of UTF-8       \n\
+encoded JSON text.  If the option @qcode{\"FromFile\"} is true, the first    \n\
+argument is the name of a file, which is read in the background thread as   \n\
+well.  Files compressed with gzip or zstd are decompressed while parsing,   \n\
+see @code{jsondecodefile}.                                                   \n\
+                                                                             \n\
+The function returns immediately.  Reading and parsing run concurrently     \n\
+with the following Octave code.  @code{jsondecode_isready (@var{f})} tells   \n\
+whether they are finished, @code{jsondecode_fetch (@var{f})} waits for them  \n\
+and returns the decoded value.  Octave values are only created by            \n\
+@code{jsondecode_fetch}, in the interpreter thread.  Errors, e.g. a parse    \n\
+error or a missing file, are reported by @code{jsondecode_fetch}.            \n\
+                                                                             \n\
+The other options are the same as for @code{jsondecode}.  The option        \n\
+@qcode{\"Format\"} must be @qcode{\"json\"} and the option                  \n\
+@qcode{\"Lazy\"} is not supported.                                           \n\
+                                                                             \n\
+Example:                                                                     \n\
+                                                                             \n\
+@example                                                                     \n\
+@group                                                                       \n\
+f = jsondecode_async (\"data.json\", \"FromFile\", true);                    \n\
+## @dots{} other work @dots{}                                                 \n\
+s = jsondecode_fetch (f);                                                    \n\
+@end group                                                                   \n\
+@end example                                                                 \n\
+                                                                             \n\
+@seealso{jsondecode_isready, jsondecode_fetch, jsondecode}                   \n\
+@end deftypefn")
+{
+#if defined (HAVE_RAPIDJSON)
+
+  int nargin = args.length ();
+
+  // Options are pairs, the number of arguments must be odd.
+  if (! (nargin % 2))
+    print_usage ();
+
+  // "FromFile" is handled here, the other options by jsondecode_settings.
+  bool from_file = false;
+  octave_value_list options;
+  for (int i = 1; i < nargin; i += 2)
+    {
+      if (args(i).is_string ()
+          && octave::string::strcmpi (args(i).string_value (), "FromFile"))
+        from_file = args(i + 1).xbool_value ("jsondecode_async: "
+          "'FromFile' value must be a bool");
+      else
+        options.append (args.slice (i, 2));
+    }
+
+  jsondecode_settings settings (options, 0);
+  if (settings.format != "json")
+    error ("jsondecode_async: only JSON text can be decoded asynchronously");
+  if (settings.lazy)
+    error ("jsondecode_async: the 'Lazy' option is not supported");
+
+  std::string input;
+  if (from_file)
+    input = octave::sys::file_ops::tilde_expand
+              (args(0).xstring_value ("jsondecode_async: FILENAME must be a "
+                                      "character string"));
+  else if (args(0).is_string ())
+    input = args(0).string_value ();
+  else if (args(0).is_uint8_type ())
+    {
+      uint8NDArray bytes = args(0).uint8_array_value ();
+      input.assign (reinterpret_cast<const char *> (bytes.data ()),
+                    bytes.numel ());
+    }
+  else
+    error ("jsondecode_async: JSON_TXT must be a character string or uint8 "
+           "array");
+
+  register_type_once<octave_json_future> (interp);
+
+  return octave_value (new octave_json_future (settings, std::move (input),
+                                               from_file));
+
+#else
+
+  octave_unused_parameter (interp);
+  octave_unused_parameter (args);
+
+  err_disabled_feature ("jsondecode_async", "JSON decoding through RapidJSON");
+
+#endif
+}
+
+/*
+%!test
+%! f = jsondecode_async ('{"a": [1, 2, 3], "b": "x"}');
+%! assert (class (f), 'json_future');
+%! assert (jsondecode_fetch (f), struct ('a', [1; 2; 3], 'b', 'x'));
+%! assert (jsondecode_isready (f));
+%! assert (jsondecode_fetch (f), struct ('a', [1; 2; 3], 'b', 'x'));
+
+%!test
+%! f = jsondecode_async (uint8 ('[1, null, 3]'));
+%! while (! jsondecode_isready (f))
+%!   pause (0.01);
+%! endwhile
+%! assert (jsondecode_fetch (f), [1; NaN; 3]);
+
+%!test
+%! f = jsondecode_async ('{"1a": 1}', 'makeValidName', false);
+%! assert (jsondecode_fetch (f), struct ('1a', 1));
+
+%!test
+%! fname = [tempname(), '.json'];
+%! fid = fopen (fname, 'w');
+%! fputs (fid, '[{"x 1": true}, {"x 1": false}]');
+%! fclose (fid);
+%! unwind_protect
+%!   f = jsondecode_async (fname, 'FromFile', true);
+%!   assert (jsondecode_fetch (f), struct ('x1', {true; false}));
+%! unwind_protect_cleanup
+%!   unlink (fname);
+%! end_unwind_protect
+
+%!test
+%! f = jsondecode_async ('[1, 2');
+%! fail ("jsondecode_fetch (f)", "parse error at offset 6");
+%! fail ("jsondecode_fetch (f)", "parse error at offset 6");
+%! f = jsondecode_async (char ([34, 255, 34]), 'ValidateUTF8', true);
+%! fail ("jsondecode_fetch (f)", "invalid UTF-8 at offset 2");
+%! f = jsondecode_async (tempname (), 'FromFile', true);
+%! fail ("jsondecode_fetch (f)", "unable to open file");
+
+%!test
+%! fail ("jsondecode_async ()");
+%! fail ("jsondecode_async ('1', 'FromFile')");
+%! fail ("jsondecode_async (1)", "JSON_TXT must be a character string");
+%! fail ("jsondecode_async (1, 'FromFile', true)", "FILENAME must be a character string");
+%! fail ("jsondecode_async ('1', 'Lazy', true)", "'Lazy' option is not supported");
+%! fail ("jsondecode_async ('1', 'Format', 'cbor')", "only JSON text");
+*/
+
+// PKG_ADD: autoload ("jsondecode_isready", "jsondecode.oct");
+// PKG_DEL: autoload ("jsondecode_isready", which ("jsondecode"), "remove");
+
+DEFUN_DLD (jsondecode_isready, args, ,
+           "-*- texinfo -*-\n\
+@deftypefn {} {@var{tf} =} jsondecode_isready (@var{f})                      \n\
+                                                                             \n\
+Return true if the background decoding of @var{f} is finished.               \n\
+                                                                             \n\
+@var{f} is returned by @code{jsondecode_async}.  If @var{tf} is true,       \n\
+@code{jsondecode_fetch (@var{f})} does not wait.                             \n\
+                                                                             \n\
+@seealso{jsondecode_async, jsondecode_fetch}                                 \n\
+@end deftypefn")
+{
+#if defined (HAVE_RAPIDJSON)
+
+  if (args.length () != 1)
+    print_usage ();
+
+  if (args(0).type_id () != octave_json_future::static_type_id ())
+    error ("jsondecode_isready: F must be returned by jsondecode_async");
+
+  const octave_json_future& f
+    = dynamic_cast<const octave_json_future&> (args(0).get_rep ());
+
+  return ovl (f.task ().ready ());
+
+#else
+
+  octave_unused_parameter (args);
+
+  err_disabled_feature ("jsondecode_isready",
+                        "JSON decoding through RapidJSON");
+
+#endif
+}
+
+/*
+%!test
+%! fail ("jsondecode_isready ()");
+%! fail ("jsondecode_isready (1)", "F must be returned by jsondecode_async");
+*/
+
+// PKG_ADD: autoload ("jsondecode_fetch", "jsondecode.oct");
+// PKG_DEL: autoload ("jsondecode_fetch", which ("jsondecode"), "remove");
+
+DEFUN_DLD (jsondecode_fetch, args, ,
+           "-*- texinfo -*-\n\
+@deftypefn {} {@var{value} =} jsondecode_fetch (@var{f})                     \n\
+                                                                             \n\
+Wait for the background decoding of @var{f} and return the decoded value.   \n\
+                                                                             \n\
+@var{f} is returned by @code{jsondecode_async}.  Errors of reading or       \n\
+parsing the JSON text are reported here.  The value is decoded once,        \n\
+further calls return it again.                                               \n\
+                                                                             \n\
+@seealso{jsondecode_async, jsondecode_isready}                               \n\
+@end deftypefn")
+{
+#if defined (HAVE_RAPIDJSON)
+
+  if (args.length () != 1)
+    print_usage ();
+
+  if (args(0).type_id () != octave_json_future::static_type_id ())
+    error ("jsondecode_fetch: F must be returned by jsondecode_async");
+
+  const octave_json_future& f
+    = dynamic_cast<const octave_json_future&> (args(0).get_rep ());
+
+  return ovl (f.task ().fetch ());
+
+#else
 
+  octave_unused_parameter (args);
+
+  err_disabled_feature ("jsondecode_fetch",
+                        "JSON decoding through RapidJSON");
+
+#endif
+}
+
+/*
+%!test
+%! fail ("jsondecode_fetch ()");
+%! fail ("jsondecode_fetch (1)", "F must be returned by jsondecode_async");
 */
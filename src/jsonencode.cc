@@ -23,11 +23,31 @@
 //
 ////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include <octave/oct.h>
+#include <octave/file-ops.h>
+#include <octave/interpreter.h>
+#include <octave/mach-info.h>
+#include <octave/boolSparse.h>
+#include <octave/dSparse.h>
+#include <octave/uint8NDArray.h>
 
 // Include some features from Octave 7.
 #include "octave7.h"
 
+#include "json_stream.h"
+#include "json_utf8.h"
+
 #define HAVE_RAPIDJSON 1
 #define HAVE_RAPIDJSON_PRETTYWRITER 1
 
@@ -41,22 +61,662 @@
 
 #if defined (HAVE_RAPIDJSON)
 
+//! Options of a jsonencode call that affect the encode functions.
+
+struct encode_options
+{
+  //! Write @c Inf and @c NaN as @c null (@c "ConvertInfAndNaN").
+  bool convert_inf_and_nan = true;
+
+  //! Write non-scalar numeric and logical arrays as base64 encoded objects
+  //! (@c "NumericEncoding" @c "base64").
+  bool base64_arrays = false;
+
+  //! Write sparse matrices as objects of their nonzero elements
+  //! (@c "SparseEncoding" @c "compact") instead of full JSON arrays.
+  bool compact_sparse = false;
+
+  //! Write the top-level scalar struct of columns as a JSON array of one
+  //! object per row (@c "Rows").
+  bool rows = false;
+
+  //! Escape all non-ASCII characters of the JSON text (@c "ASCII").
+  bool ascii = false;
+};
+
+//! Base class of the binary writers for CBOR and MessagePack.
+//!
+//! The binary writers implement the subset of the interface of RapidJSON's
+//! writers that is used by the encode functions, so that the very same
+//! traversal of the Octave value can emit JSON text or binary data.
+//!
+//! Both binary formats store the number of elements in front of arrays and
+//! maps, which is unknown when a container starts.  Therefore a header of
+//! maximal size is reserved and filled with the shortest possible header
+//! when the container ends.  The unused bytes of all headers are removed
+//! in a single pass over the buffer by @ref data, so that the time stays
+//! linear in the size of the output for any depth of nesting.
+
+class binary_writer
+{
+public:
+
+  //! @return the encoded bytes.
+
+  const std::string& data (void)
+  {
+    compact ();
+    return m_buffer;
+  }
+
+protected:
+
+  struct container
+  {
+    std::size_t header;
+    uint64_t count;
+    bool is_map;
+  };
+
+  //! Header reserved in the buffer, in the order of the containers.
+
+  struct header
+  {
+    std::size_t offset;
+    std::size_t reserved;
+    std::size_t len;
+  };
+
+  //! Counts a new element of the enclosing array.
+
+  void value (void)
+  {
+    if (! m_containers.empty () && ! m_containers.back ().is_map)
+      m_containers.back ().count++;
+  }
+
+  //! Counts a new key-value pair of the enclosing map.
+
+  void key (void) { m_containers.back ().count++; }
+
+  void open (bool is_map, std::size_t reserved)
+  {
+    value ();
+    m_containers.push_back ({m_headers.size (), 0, is_map});
+    m_headers.push_back ({m_buffer.size (), reserved, reserved});
+    m_buffer.append (reserved, '\0');
+  }
+
+  container close (void)
+  {
+    container c = m_containers.back ();
+    m_containers.pop_back ();
+    return c;
+  }
+
+  //! Writes the @p len bytes of @p bytes into the header reserved for the
+  //! container @p c.  The remaining reserved bytes are removed later by
+  //! @ref compact.
+
+  void patch (const container& c, const uint8_t *bytes, std::size_t len)
+  {
+    header& h = m_headers[c.header];
+    std::memcpy (&m_buffer[h.offset], bytes, len);
+    h.len = len;
+  }
+
+  //! Removes the unused bytes of all headers, moving each byte of the
+  //! buffer at most once.
+
+  void compact (void)
+  {
+    if (m_headers.empty ())
+      return;
+
+    char *buf = &m_buffer[0];
+    std::size_t dst = m_headers[0].offset;
+    std::size_t src = dst;
+    for (const header& h : m_headers)
+      {
+        std::size_t n = h.offset + h.len - src;
+        std::memmove (buf + dst, buf + src, n);
+        dst += n;
+        src = h.offset + h.reserved;
+      }
+    std::size_t n = m_buffer.size () - src;
+    std::memmove (buf + dst, buf + src, n);
+    m_buffer.resize (dst + n);
+    m_headers.clear ();
+  }
+
+  void put (uint8_t byte) { m_buffer.push_back (static_cast<char> (byte)); }
+
+  void put (const void *bytes, std::size_t len)
+  {
+    m_buffer.append (static_cast<const char *> (bytes), len);
+  }
+
+  //! Writes the @p nbytes least significant bytes of @p x in big-endian
+  //! (network) byte order.
+
+  void put_be (uint64_t x, int nbytes)
+  {
+    for (int i = nbytes - 1; i >= 0; --i)
+      put (static_cast<uint8_t> (x >> (8 * i)));
+  }
+
+  std::string m_buffer;
+  std::vector<container> m_containers;
+  std::vector<header> m_headers;
+};
+
+//! Writer for the Concise Binary Object Representation (CBOR, RFC 8949).
+//!
+//! Numeric vectors are written as typed arrays of float64 (RFC 8746) by
+//! @ref encode_numeric_vector.
+
+class cbor_writer : public binary_writer
+{
+public:
+
+  bool Null (void) { value (); put (0xf6); return true; }
+
+  bool Bool (bool b) { value (); put (b ? 0xf5 : 0xf4); return true; }
+
+  bool Int64 (int64_t i)
+  {
+    value ();
+    // Negative integers are stored as -1 - i with major type 1.
+    if (i < 0)
+      put_head (1, static_cast<uint64_t> (-1 - i));
+    else
+      put_head (0, static_cast<uint64_t> (i));
+    return true;
+  }
+
+  bool Double (double d)
+  {
+    value ();
+    uint64_t bits;
+    std::memcpy (&bits, &d, sizeof (bits));
+    put (0xfb);
+    put_be (bits, 8);
+    return true;
+  }
+
+  bool String (const char *str)
+  {
+    return String (str, std::strlen (str));
+  }
+
+  bool String (const char *str, rapidjson::SizeType length, bool = false)
+  {
+    value ();
+    put_head (3, length);
+    put (str, length);
+    return true;
+  }
+
+  bool Key (const char *str)
+  {
+    return Key (str, std::strlen (str));
+  }
+
+  bool Key (const char *str, rapidjson::SizeType length, bool = false)
+  {
+    key ();
+    put_head (3, length);
+    put (str, length);
+    return true;
+  }
+
+  bool StartArray (void) { open (false, 9); return true; }
+
+  bool EndArray (rapidjson::SizeType = 0) { finish (4); return true; }
+
+  bool StartObject (void) { open (true, 9); return true; }
+
+  bool EndObject (rapidjson::SizeType = 0) { finish (5); return true; }
+
+  //! Writes @p n doubles as typed array (tag 86 or 82, float64 in the
+  //! byte order of this machine).
+
+  bool Float64Array (const double *data, std::size_t n)
+  {
+    value ();
+    static const bool big_endian = octave::mach_info::words_big_endian ();
+    put_head (6, big_endian ? 82 : 86);
+    put_head (2, n * sizeof (double));
+    put (data, n * sizeof (double));
+    return true;
+  }
+
+private:
+
+  //! Encodes the initial byte and argument of a data item into @p out.
+  //!
+  //! @return number of bytes written (at most 9).
+
+  static std::size_t head (uint8_t *out, uint8_t major, uint64_t arg)
+  {
+    major <<= 5;
+    if (arg < 24)
+      {
+        out[0] = major | static_cast<uint8_t> (arg);
+        return 1;
+      }
+
+    int nbytes = (arg <= 0xff ? 1 : arg <= 0xffff ? 2
+                                  : arg <= 0xffffffff ? 4 : 8);
+    out[0] = major | (nbytes == 1 ? 24 : nbytes == 2 ? 25
+                                       : nbytes == 4 ? 26 : 27);
+    for (int i = 0; i < nbytes; ++i)
+      out[nbytes - i] = static_cast<uint8_t> (arg >> (8 * i));
+    return nbytes + 1;
+  }
+
+  void put_head (uint8_t major, uint64_t arg)
+  {
+    uint8_t buf[9];
+    put (buf, head (buf, major, arg));
+  }
+
+  void finish (uint8_t major)
+  {
+    container c = close ();
+    uint8_t buf[9];
+    patch (c, buf, head (buf, major, c.count));
+  }
+};
+
+//! Writer for MessagePack.
+
+class msgpack_writer : public binary_writer
+{
+public:
+
+  bool Null (void) { value (); put (0xc0); return true; }
+
+  bool Bool (bool b) { value (); put (b ? 0xc3 : 0xc2); return true; }
+
+  bool Int64 (int64_t i)
+  {
+    value ();
+    if (i >= 0)
+      {
+        if (i < 128)
+          put (static_cast<uint8_t> (i));
+        else if (i <= 0xff)
+          { put (0xcc); put_be (i, 1); }
+        else if (i <= 0xffff)
+          { put (0xcd); put_be (i, 2); }
+        else if (i <= 0xffffffff)
+          { put (0xce); put_be (i, 4); }
+        else
+          { put (0xcf); put_be (i, 8); }
+      }
+    else
+      {
+        if (i >= -32)
+          put (static_cast<uint8_t> (i));
+        else if (i >= -128)
+          { put (0xd0); put_be (i, 1); }
+        else if (i >= -32768)
+          { put (0xd1); put_be (i, 2); }
+        else if (i >= -2147483648LL)
+          { put (0xd2); put_be (i, 4); }
+        else
+          { put (0xd3); put_be (i, 8); }
+      }
+    return true;
+  }
+
+  bool Double (double d)
+  {
+    value ();
+    uint64_t bits;
+    std::memcpy (&bits, &d, sizeof (bits));
+    put (0xcb);
+    put_be (bits, 8);
+    return true;
+  }
+
+  bool String (const char *str)
+  {
+    return String (str, std::strlen (str));
+  }
+
+  bool String (const char *str, rapidjson::SizeType length, bool = false)
+  {
+    value ();
+    put_str (str, length);
+    return true;
+  }
+
+  bool Key (const char *str)
+  {
+    return Key (str, std::strlen (str));
+  }
+
+  bool Key (const char *str, rapidjson::SizeType length, bool = false)
+  {
+    key ();
+    put_str (str, length);
+    return true;
+  }
+
+  bool StartArray (void) { open (false, 5); return true; }
+
+  bool EndArray (rapidjson::SizeType = 0) { finish (0x90, 0xdc); return true; }
+
+  bool StartObject (void) { open (true, 5); return true; }
+
+  bool EndObject (rapidjson::SizeType = 0) { finish (0x80, 0xde); return true; }
+
+private:
+
+  void put_str (const char *str, uint32_t length)
+  {
+    if (length < 32)
+      put (static_cast<uint8_t> (0xa0 | length));
+    else if (length <= 0xff)
+      { put (0xd9); put_be (length, 1); }
+    else if (length <= 0xffff)
+      { put (0xda); put_be (length, 2); }
+    else
+      { put (0xdb); put_be (length, 4); }
+    put (str, length);
+  }
+
+  //! Writes the header of an array (@p fix = 0x90, @p type16 = 0xdc) or a
+  //! map (@p fix = 0x80, @p type16 = 0xde).  The 32-bit variant follows the
+  //! 16-bit one.
+
+  void finish (uint8_t fix, uint8_t type16)
+  {
+    container c = close ();
+    if (c.count > 0xffffffff)
+      error ("jsonencode: MessagePack containers are limited to 2^32-1 "
+             "elements");
+
+    uint8_t buf[5];
+    std::size_t len;
+    if (c.count < 16)
+      {
+        buf[0] = fix | static_cast<uint8_t> (c.count);
+        len = 1;
+      }
+    else
+      {
+        int nbytes = (c.count <= 0xffff ? 2 : 4);
+        buf[0] = (nbytes == 2 ? type16 : type16 + 1);
+        for (int i = 0; i < nbytes; ++i)
+          buf[nbytes - i] = static_cast<uint8_t> (c.count >> (8 * i));
+        len = nbytes + 1;
+      }
+    patch (c, buf, len);
+  }
+};
+
+//! Octave value to encode, detached from the interpreter.
+//!
+//! The encode functions write into a snapshot like into any other writer.
+//! It records their calls as plain numbers and strings, which
+//! @ref replay sends to the actual writer later, in any thread.  Thus only
+//! the traversal of the Octave value needs the interpreter thread, while
+//! formatting the numbers, escaping the strings, and compressing the
+//! output do not.
+//!
+//! The checks of the binary writers that fail with an error are done while
+//! recording, as the replay must not call into Octave.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! encode_snapshot snapshot ("json");
+//! encode (snapshot, octave_value (1.5), encode_options ());
+//! rapidjson::StringBuffer json;
+//! rapidjson::Writer<rapidjson::StringBuffer> writer (json);
+//! snapshot.replay (writer);
+//! @endcode
+
+class encode_snapshot
+{
+public:
+
+  //! @param format output format of the replay, @c "json", @c "cbor", or
+  //!               @c "msgpack".
+
+  explicit encode_snapshot (const std::string& format = "json")
+    : m_typed_arrays (format == "cbor"), m_msgpack (format == "msgpack")
+  { }
+
+  //! @return @c true if numeric vectors are recorded as typed arrays of
+  //! CBOR, see @ref encode_numeric_vector.
+
+  bool typed_arrays (void) const { return m_typed_arrays; }
+
+  bool Null (void) { value (); m_events.push_back (null); return true; }
+
+  bool Bool (bool b)
+  {
+    value ();
+    m_events.push_back (b ? true_value : false_value);
+    return true;
+  }
+
+  bool Int64 (int64_t i)
+  {
+    value ();
+    m_events.push_back (integer);
+    m_integers.push_back (i);
+    return true;
+  }
+
+  bool Double (double d)
+  {
+    value ();
+    m_events.push_back (number);
+    m_numbers.push_back (d);
+    return true;
+  }
+
+  bool String (const char *str)
+  {
+    return String (str, std::strlen (str));
+  }
+
+  bool String (const char *str, rapidjson::SizeType length, bool = false)
+  {
+    value ();
+    text (string, str, length);
+    return true;
+  }
+
+  bool Key (const char *str)
+  {
+    return Key (str, std::strlen (str));
+  }
+
+  bool Key (const char *str, rapidjson::SizeType length, bool = false)
+  {
+    m_counts.back ()++;
+    text (key, str, length);
+    return true;
+  }
+
+  bool StartArray (void) { open (start_array); return true; }
+
+  bool EndArray (rapidjson::SizeType = 0) { close (end_array); return true; }
+
+  bool StartObject (void) { open (start_object); return true; }
+
+  bool EndObject (rapidjson::SizeType = 0)
+  {
+    close (end_object);
+    return true;
+  }
+
+  //! Records @p n doubles, which are written as one typed array of CBOR.
+
+  bool Float64Array (const double *data, std::size_t n)
+  {
+    value ();
+    m_events.push_back (float64_array);
+    m_lengths.push_back (n);
+    m_numbers.insert (m_numbers.end (), data, data + n);
+    return true;
+  }
+
+  //! Sends the recorded calls to @p writer.  No Octave function is called.
+
+  template <typename T>
+  void replay (T& writer) const
+  {
+    std::size_t next_integer = 0;
+    std::size_t next_number = 0;
+    std::size_t next_length = 0;
+    std::size_t next_text = 0;
+
+    for (event e : m_events)
+      switch (e)
+        {
+        case null:
+          writer.Null ();
+          break;
+        case false_value:
+        case true_value:
+          writer.Bool (e == true_value);
+          break;
+        case integer:
+          writer.Int64 (m_integers[next_integer++]);
+          break;
+        case number:
+          writer.Double (m_numbers[next_number++]);
+          break;
+        case string:
+        case key:
+          {
+            std::size_t len = m_lengths[next_length++];
+            const char *str = m_text.data () + next_text;
+            next_text += len;
+            if (e == key)
+              writer.Key (str, static_cast<rapidjson::SizeType> (len));
+            else
+              writer.String (str, static_cast<rapidjson::SizeType> (len));
+            break;
+          }
+        case start_array:
+          writer.StartArray ();
+          break;
+        case end_array:
+          writer.EndArray ();
+          break;
+        case start_object:
+          writer.StartObject ();
+          break;
+        case end_object:
+          writer.EndObject ();
+          break;
+        case float64_array:
+          {
+            std::size_t n = m_lengths[next_length++];
+            write_float64_array (writer, m_numbers.data () + next_number, n);
+            next_number += n;
+            break;
+          }
+        }
+  }
+
+private:
+
+  enum event : uint8_t
+  {
+    null, false_value, true_value, integer, number, string, key,
+    start_array, end_array, start_object, end_object, float64_array
+  };
+
+  //! Counts a new element of the enclosing array.
+
+  void value (void)
+  {
+    if (! m_counts.empty () && m_events[m_starts.back ()] == start_array)
+      m_counts.back ()++;
+  }
+
+  void open (event e)
+  {
+    value ();
+    m_starts.push_back (m_events.size ());
+    m_counts.push_back (0);
+    m_events.push_back (e);
+  }
+
+  void close (event e)
+  {
+    if (m_msgpack && m_counts.back () > 0xffffffff)
+      error ("jsonencode: MessagePack containers are limited to 2^32-1 "
+             "elements");
+    m_starts.pop_back ();
+    m_counts.pop_back ();
+    m_events.push_back (e);
+  }
+
+  void text (event e, const char *str, std::size_t len)
+  {
+    m_events.push_back (e);
+    m_lengths.push_back (len);
+    m_text.append (str, len);
+  }
+
+  template <typename T>
+  static void write_float64_array (T& writer, const double *data,
+                                   std::size_t n)
+  {
+    writer.StartArray ();
+    for (std::size_t i = 0; i < n; ++i)
+      writer.Double (data[i]);
+    writer.EndArray ();
+  }
+
+  static void write_float64_array (cbor_writer& writer, const double *data,
+                                   std::size_t n)
+  {
+    writer.Float64Array (data, n);
+  }
+
+  bool m_typed_arrays;
+  bool m_msgpack;
+
+  std::vector<event> m_events;
+  std::vector<int64_t> m_integers;
+  std::vector<double> m_numbers;
+  //! Lengths of the strings, keys, and typed arrays.
+  std::vector<std::size_t> m_lengths;
+  //! Characters of all strings and keys.
+  std::string m_text;
+
+  //! Open containers: index of their start event and number of elements.
+  std::vector<std::size_t> m_starts;
+  std::vector<uint64_t> m_counts;
+};
+
 //! Encodes a scalar Octave value into a numerical JSON value.
 //!
 //! @param writer RapidJSON's writer that is responsible for generating JSON.
 //! @param obj scalar Octave value.
-//! @param ConvertInfAndNaN @c bool that converts @c Inf and @c NaN to @c null.
+//! @param options @ref encode_options of this jsonencode call.
 //!
 //! @b Example:
 //!
 //! @code{.cc}
 //! octave_value obj (7);
-//! encode_numeric (writer, obj, true);
+//! encode_numeric (writer, obj, encode_options ());
 //! @endcode
 
 template <typename T> void
 encode_numeric (T& writer, const octave_value& obj,
-                const bool& ConvertInfAndNaN)
+                const encode_options& options)
 {
   double value = obj.scalar_value ();
 
@@ -70,7 +730,7 @@ encode_numeric (T& writer, const octave_value& obj,
            && value <= 999999 && value >= -999999)
     writer.Int64 (value);
   // Possibly write NULL for non-finite values (-Inf, Inf, NaN, NA)
-  else if (ConvertInfAndNaN && ! octave::math::isfinite (value))
+  else if (options.convert_inf_and_nan && ! octave::math::isfinite (value))
     writer.Null ();
   else if (obj.is_double_type ())
     writer.Double (value);
@@ -78,6 +738,271 @@ encode_numeric (T& writer, const octave_value& obj,
     error ("jsonencode: unsupported type");
 }
 
+//! Encodes a numeric or logical vector into a JSON array of numbers.
+//!
+//! @param writer RapidJSON's writer that is responsible for generating JSON.
+//! @param array numeric vector.
+//! @param options @ref encode_options of this jsonencode call.
+//! @param is_logical @c bool that indicates if the array is logical.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! NDArray array (dim_vector (1, 3), 1.0);
+//! encode_numeric_vector (writer, array, encode_options (), false);
+//! @endcode
+
+template <typename T> void
+encode_numeric_vector (T& writer, const NDArray& array,
+                       const encode_options& options, bool is_logical)
+{
+  writer.StartArray ();
+  for (octave_idx_type i = 0; i < array.numel (); ++i)
+    {
+      if (is_logical)
+        encode_numeric (writer, bool (array(i)), options);
+      else
+        encode_numeric (writer, array(i), options);
+    }
+  writer.EndArray ();
+}
+
+//! Encodes a numeric vector into a CBOR typed array.  Non-finite values
+//! become @c NaN if @c convert_inf_and_nan is true, as @c null in a numeric
+//! array decodes to @c NaN.  Logical vectors remain arrays of Booleans.
+
+template <typename T> void
+encode_typed_vector (T& writer, const NDArray& array,
+                     const encode_options& options, bool is_logical)
+{
+  if (is_logical)
+    {
+      encode_numeric_vector<T> (writer, array, options, is_logical);
+      return;
+    }
+
+  if (options.convert_inf_and_nan && array.any_element_is_inf_or_nan ())
+    {
+      NDArray finite = array;
+      double *data = finite.fortran_vec ();
+      for (octave_idx_type i = 0; i < finite.numel (); ++i)
+        if (! octave::math::isfinite (data[i]))
+          data[i] = octave_NaN;
+      writer.Float64Array (finite.data (), finite.numel ());
+    }
+  else
+    writer.Float64Array (array.data (), array.numel ());
+}
+
+void
+encode_numeric_vector (cbor_writer& writer, const NDArray& array,
+                       const encode_options& options, bool is_logical)
+{
+  encode_typed_vector (writer, array, options, is_logical);
+}
+
+//! Records a numeric vector like the writer of the snapshot's format.
+
+void
+encode_numeric_vector (encode_snapshot& writer, const NDArray& array,
+                       const encode_options& options, bool is_logical)
+{
+  if (writer.typed_arrays ())
+    encode_typed_vector (writer, array, options, is_logical);
+  else
+    encode_numeric_vector<encode_snapshot> (writer, array, options,
+                                            is_logical);
+}
+
+//! Encodes bytes as base64 (RFC 4648) text with padding.
+//!
+//! Six bytes are loaded as one 64-bit big-endian word and split into
+//! eight characters per iteration.  The byte-wise load is recognized by
+//! compilers as a single load and byte swap.
+//!
+//! @param in bytes to encode.
+//! @param len number of bytes of @p in.
+//!
+//! @return base64 text.
+
+std::string
+base64_encode (const uint8_t *in, std::size_t len)
+{
+  static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                                 "abcdefghijklmnopqrstuvwxyz0123456789+/";
+
+  std::string retval ((len + 2) / 3 * 4, '=');
+  char *out = &retval[0];
+
+  std::size_t i = 0;
+  // Reading a 64-bit word needs two bytes beyond the six encoded ones.
+  for (; i + 8 <= len; i += 6)
+    {
+      uint64_t word = 0;
+      for (int k = 0; k < 8; ++k)
+        word = (word << 8) | in[i+k];
+      for (int k = 0; k < 8; ++k)
+        *out++ = alphabet[(word >> (58 - 6 * k)) & 0x3f];
+    }
+
+  for (; i + 3 <= len; i += 3)
+    {
+      uint32_t word = (in[i] << 16) | (in[i+1] << 8) | in[i+2];
+      for (int k = 0; k < 4; ++k)
+        *out++ = alphabet[(word >> (18 - 6 * k)) & 0x3f];
+    }
+
+  if (i < len)
+    {
+      uint32_t word = in[i] << 16;
+      if (i + 1 < len)
+        word |= in[i+1] << 8;
+      *out++ = alphabet[(word >> 18) & 0x3f];
+      *out++ = alphabet[(word >> 12) & 0x3f];
+      if (i + 1 < len)
+        *out++ = alphabet[(word >> 6) & 0x3f];
+    }
+
+  return retval;
+}
+
+//! Encodes the elements of @p array as little-endian bytes in base64.
+
+template <typename A> std::string
+base64_encode_array (const A& array)
+{
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *> (array.data ());
+  std::size_t elem_size = sizeof (*array.data ());
+  std::size_t nbytes = array.numel () * elem_size;
+
+  static const bool big_endian = octave::mach_info::words_big_endian ();
+  if (! big_endian || elem_size == 1)
+    return base64_encode (bytes, nbytes);
+
+  std::vector<uint8_t> swapped (bytes, bytes + nbytes);
+  for (std::size_t i = 0; i < nbytes; i += elem_size)
+    std::reverse (swapped.begin () + i, swapped.begin () + i + elem_size);
+  return base64_encode (swapped.data (), nbytes);
+}
+
+//! Encodes a numeric or logical Octave array into a JSON object with the
+//! keys @c dtype (class), @c shape (dimensions), and @c data (elements in
+//! column-major order as little-endian bytes in base64).
+//!
+//! @param writer RapidJSON's writer that is responsible for generating JSON.
+//! @param obj numeric or logical Octave array.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! octave_value obj (uint8NDArray (dim_vector (1, 3), 1));
+//! encode_base64_array (writer, obj);
+//! @endcode
+
+template <typename T> void
+encode_base64_array (T& writer, const octave_value& obj)
+{
+  if (obj.iscomplex ())
+    error ("jsonencode: unsupported type");
+
+  std::string dtype;
+  std::string data;
+  switch (obj.builtin_type ())
+    {
+    case btyp_double:
+      dtype = "float64";
+      data = base64_encode_array (obj.array_value ());
+      break;
+    case btyp_float:
+      dtype = "float32";
+      data = base64_encode_array (obj.float_array_value ());
+      break;
+    case btyp_int8:
+      dtype = "int8";
+      data = base64_encode_array (obj.int8_array_value ());
+      break;
+    case btyp_int16:
+      dtype = "int16";
+      data = base64_encode_array (obj.int16_array_value ());
+      break;
+    case btyp_int32:
+      dtype = "int32";
+      data = base64_encode_array (obj.int32_array_value ());
+      break;
+    case btyp_int64:
+      dtype = "int64";
+      data = base64_encode_array (obj.int64_array_value ());
+      break;
+    case btyp_uint8:
+      dtype = "uint8";
+      data = base64_encode_array (obj.uint8_array_value ());
+      break;
+    case btyp_uint16:
+      dtype = "uint16";
+      data = base64_encode_array (obj.uint16_array_value ());
+      break;
+    case btyp_uint32:
+      dtype = "uint32";
+      data = base64_encode_array (obj.uint32_array_value ());
+      break;
+    case btyp_uint64:
+      dtype = "uint64";
+      data = base64_encode_array (obj.uint64_array_value ());
+      break;
+    case btyp_bool:
+      dtype = "bool";
+      data = base64_encode_array (obj.bool_array_value ());
+      break;
+    default:
+      error ("jsonencode: unsupported type");
+    }
+
+  dim_vector dims = obj.dims ();
+
+  writer.StartObject ();
+  writer.Key ("dtype");
+  writer.String (dtype.c_str ());
+  writer.Key ("shape");
+  writer.StartArray ();
+  for (int i = 0; i < dims.ndims (); ++i)
+    writer.Int64 (dims(i));
+  writer.EndArray ();
+  writer.Key ("data");
+  writer.String (data.c_str (), data.size ());
+  writer.EndObject ();
+}
+
+//! Writes a character vector as one JSON string, straight from its data.
+//!
+//! As for the C strings written before, the string ends at the first null
+//! character.
+//!
+//! @param writer RapidJSON's writer that is responsible for generating JSON.
+//! @param array character vector.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! encode_chars (writer, charNDArray (std::string ("foo")));
+//! @endcode
+
+template <typename T> void
+encode_chars (T& writer, const charNDArray& array)
+{
+  const char *data = array.data ();
+  std::size_t len = array.numel ();
+  if (len == 0)
+    {
+      writer.String ("");
+      return;
+    }
+
+  const void *null = std::memchr (data, '\0', len);
+  if (null)
+    len = static_cast<const char *> (null) - data;
+  writer.String (data, len);
+}
+
 //! Encodes character vectors and arrays into JSON strings.
 //!
 //! @param writer RapidJSON's writer that is responsible for generating JSON.
@@ -106,12 +1031,7 @@ encode_string (T& writer, const octave_value& obj,
       // 2 dimensions (e.g. cat (8, ['a'], ['c'])).  In this case, we don't
       // split the inner vectors of the input; we merge them into one.
       if (level == 0)
-        {
-          std::string char_vector = "";
-          for (octave_idx_type i = 0; i < array.numel (); ++i)
-            char_vector += array(i);
-          writer.String (char_vector.c_str ());
-        }
+        encode_chars (writer, array);
       else
         for (octave_idx_type i = 0; i < array.numel () / original_dims(1); ++i)
           {
@@ -196,77 +1116,279 @@ encode_string (T& writer, const octave_value& obj,
     }
 }
 
-//! Encodes a struct Octave value into a JSON object or a JSON array depending
-//! on the type of the struct (scalar struct or struct array.)
-//!
-//! @param writer RapidJSON's writer that is responsible for generating JSON.
-//! @param obj struct Octave value.
-//! @param ConvertInfAndNaN @c bool that converts @c Inf and @c NaN to @c null.
+//! Cell array or struct on the explicit stack of @ref encode, whose
+//! elements are being encoded.
 //!
-//! @b Example:
-//!
-//! @code{.cc}
-//! octave_value obj (octave_map ());
-//! encode_struct (writer, obj,true);
-//! @endcode
+//! A Cell is encoded into a JSON array of its elements.  A struct is encoded
+//! into a JSON object, or a JSON array of objects for struct arrays.  The
+//! structural tokens are written by @ref next, which returns the elements
+//! one after another.
 
-template <typename T> void
-encode_struct (T& writer, const octave_value& obj, const bool& ConvertInfAndNaN)
+class encode_frame
 {
-  octave_map struct_array = obj.map_value ();
-  octave_idx_type numel = struct_array.numel ();
-  bool is_array = (numel > 1);
-  string_vector keys = struct_array.keys ();
+public:
 
-  if (is_array)
-    writer.StartArray ();
+  encode_frame (const Cell& cell)
+    : m_is_cell (true), m_cell (cell), m_numel (cell.numel ())
+  { }
 
-  for (octave_idx_type i = 0; i < numel; ++i)
-    {
-      writer.StartObject ();
-      for (octave_idx_type k = 0; k < keys.numel (); ++k)
-        {
-          writer.Key (keys(k).c_str ());
-          encode (writer, struct_array(i).getfield (keys(k)), ConvertInfAndNaN);
-        }
-      writer.EndObject ();
+  encode_frame (const octave_map& map)
+    : m_is_cell (false), m_keys (map.keys ()), m_numel (map.numel ())
+  {
+    m_values.reserve (m_keys.numel ());
+    for (octave_idx_type k = 0; k < m_keys.numel (); ++k)
+      m_values.push_back (map.contents (m_keys(k)));
+  }
+
+  //! Writes the tokens in front of the next element and returns it.
+  //!
+  //! @param writer RapidJSON's writer that is responsible for generating
+  //! JSON.
+  //! @param[out] elem next element to encode.
+  //!
+  //! @return @c false if all elements are encoded and the closing tokens
+  //! have been written.
+
+  template <typename T> bool
+  next (T& writer, octave_value& elem)
+  {
+    if (m_is_cell)
+      {
+        if (! m_started)
+          writer.StartArray ();
+        m_started = true;
+
+        if (m_index < m_numel)
+          {
+            elem = m_cell(m_index++);
+            return true;
+          }
+
+        writer.EndArray ();
+        return false;
+      }
+
+    bool is_array = (m_numel > 1);
+    if (! m_started && is_array)
+      writer.StartArray ();
+    m_started = true;
+
+    while (m_index < m_numel)
+      {
+        if (m_key == 0)
+          writer.StartObject ();
+
+        if (m_key < m_keys.numel ())
+          {
+            writer.Key (m_keys(m_key).c_str ());
+            elem = m_values[m_key++](m_index);
+            return true;
+          }
+
+        writer.EndObject ();
+        m_key = 0;
+        m_index++;
+      }
+
+    if (is_array)
+      writer.EndArray ();
+    return false;
+  }
+
+private:
+
+  bool m_is_cell;
+  Cell m_cell;
+  string_vector m_keys;
+  //! Field values of the struct, one Cell per key.
+  std::vector<Cell> m_values;
+  octave_idx_type m_numel;
+
+  bool m_started = false;
+  //! Index of the current element.
+  octave_idx_type m_index = 0;
+  //! Index of the next key of the current struct element.
+  octave_idx_type m_key = 0;
+};
+
+//! Encodes a Cell of character row vectors and real scalars, e.g. a
+//! cellstr, into a JSON array in one loop.
+//!
+//! The elements are written straight from their data, without the type
+//! dispatch of @ref encode_value and without a frame on the stack of
+//! @ref encode.  The output is the same.
+//!
+//! @param writer RapidJSON's writer that is responsible for generating JSON.
+//! @param cell Cell array.
+//! @param options @ref encode_options of this jsonencode call.
+//!
+//! @return @c false if @p cell has other elements, then nothing is written.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! bool done = encode_flat_cell (writer, Cell (ovl ("a", 1)),
+//!                               encode_options ());
+//! @endcode
+
+template <typename T> bool
+encode_flat_cell (T& writer, const Cell& cell, const encode_options& options)
+{
+  const octave_value *elem = cell.data ();
+  octave_idx_type n = cell.numel ();
+
+  for (octave_idx_type i = 0; i < n; ++i)
+    {
+      if (elem[i].is_string ())
+        {
+          if (elem[i].ndims () != 2
+              || (elem[i].rows () != 1 && ! elem[i].isempty ()))
+            return false;
+        }
+      else if (! elem[i].is_real_scalar ())
+        return false;
     }
 
-  if (is_array)
-    writer.EndArray ();
+  writer.StartArray ();
+  for (octave_idx_type i = 0; i < n; ++i)
+    {
+      if (elem[i].is_string ())
+        encode_chars (writer, elem[i].char_array_value ());
+      else
+        encode_numeric (writer, elem[i], options);
+    }
+  writer.EndArray ();
+
+  return true;
 }
 
-//! Encodes a Cell Octave value into a JSON array
+//! Encodes a sparse matrix into the same JSON array as its full matrix.
+//!
+//! The nonzero elements are read directly from the compressed column
+//! storage, the full matrix is never created.  Vectors are written in
+//! column-major order, matrices row by row with one cursor per column that
+//! points to the next nonzero element of that column.
 //!
 //! @param writer RapidJSON's writer that is responsible for generating JSON.
-//! @param obj Cell Octave value.
-//! @param ConvertInfAndNaN @c bool that converts @c Inf and @c NaN to @c null.
+//! @param sm sparse matrix.
+//! @param options @ref encode_options of this jsonencode call.
 //!
 //! @b Example:
 //!
 //! @code{.cc}
-//! octave_value obj (cell ());
-//! encode_cell (writer, obj,true);
+//! SparseMatrix sm (3, 3, 1.0);
+//! encode_sparse (writer, sm, encode_options ());
 //! @endcode
 
-template <typename T> void
-encode_cell (T& writer, const octave_value& obj, const bool& ConvertInfAndNaN)
+template <typename T, typename E> void
+encode_sparse (T& writer, const Sparse<E>& sm, const encode_options& options)
 {
-  Cell cell = obj.cell_value ();
+  octave_idx_type nr = sm.rows ();
+  octave_idx_type nc = sm.cols ();
+  const E zero = E ();
 
   writer.StartArray ();
 
-  for (octave_idx_type i = 0; i < cell.numel (); ++i)
-    encode (writer, cell(i), ConvertInfAndNaN);
+  if (nr == 1 || nc == 1)
+    {
+      for (octave_idx_type c = 0; c < nc; ++c)
+        {
+          octave_idx_type r = 0;
+          for (octave_idx_type k = sm.cidx (c); k < sm.cidx (c+1); ++k)
+            {
+              for (; r < sm.ridx (k); ++r)
+                encode_numeric (writer, zero, options);
+              encode_numeric (writer, sm.data (k), options);
+              ++r;
+            }
+          for (; r < nr; ++r)
+            encode_numeric (writer, zero, options);
+        }
+    }
+  else if (nr > 0 && nc > 0)
+    {
+      std::vector<octave_idx_type> next (nc);
+      for (octave_idx_type c = 0; c < nc; ++c)
+        next[c] = sm.cidx (c);
+
+      for (octave_idx_type r = 0; r < nr; ++r)
+        {
+          writer.StartArray ();
+          for (octave_idx_type c = 0; c < nc; ++c)
+            {
+              octave_idx_type k = next[c];
+              if (k < sm.cidx (c+1) && sm.ridx (k) == r)
+                {
+                  encode_numeric (writer, sm.data (k), options);
+                  next[c] = k + 1;
+                }
+              else
+                encode_numeric (writer, zero, options);
+            }
+          writer.EndArray ();
+        }
+    }
+
+  writer.EndArray ();
+}
+
+//! Encodes a sparse matrix into a JSON object with the keys @c sparse
+//! (@c true), @c size, @c i, @c j (one-based row and column indices), and
+//! @c v (values of the nonzero elements in column-major order).
+//!
+//! @param writer RapidJSON's writer that is responsible for generating JSON.
+//! @param sm sparse matrix.
+//! @param options @ref encode_options of this jsonencode call.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! SparseMatrix sm (3, 3, 1.0);
+//! encode_sparse_compact (writer, sm, encode_options ());
+//! @endcode
+
+template <typename T, typename E> void
+encode_sparse_compact (T& writer, const Sparse<E>& sm,
+                       const encode_options& options)
+{
+  octave_idx_type nc = sm.cols ();
+
+  writer.StartObject ();
+  writer.Key ("sparse");
+  writer.Bool (true);
+  writer.Key ("size");
+  writer.StartArray ();
+  writer.Int64 (sm.rows ());
+  writer.Int64 (nc);
+  writer.EndArray ();
 
+  writer.Key ("i");
+  writer.StartArray ();
+  for (octave_idx_type k = 0; k < sm.nnz (); ++k)
+    writer.Int64 (sm.ridx (k) + 1);
   writer.EndArray ();
+
+  writer.Key ("j");
+  writer.StartArray ();
+  for (octave_idx_type c = 0; c < nc; ++c)
+    for (octave_idx_type k = sm.cidx (c); k < sm.cidx (c+1); ++k)
+      writer.Int64 (c + 1);
+  writer.EndArray ();
+
+  writer.Key ("v");
+  writer.StartArray ();
+  for (octave_idx_type k = 0; k < sm.nnz (); ++k)
+    encode_numeric (writer, sm.data (k), options);
+  writer.EndArray ();
+
+  writer.EndObject ();
 }
 
 //! Encodes a numeric or logical Octave array into a JSON array
 //!
 //! @param writer RapidJSON's writer that is responsible for generating JSON.
 //! @param obj numeric or logical Octave array.
-//! @param ConvertInfAndNaN @c bool that converts @c Inf and @c NaN to @c null.
+//! @param options @ref encode_options of this jsonencode call.
 //! @param original_dims The original dimensions of the array being encoded.
 //! @param level The level of recursion for the function.
 //! @param is_logical optional @c bool that indicates if the array is logical.
@@ -275,13 +1397,13 @@ encode_cell (T& writer, const octave_value& obj, const bool& ConvertInfAndNaN)
 //!
 //! @code{.cc}
 //! octave_value obj (NDArray ());
-//! encode_array (writer, obj,true);
+//! encode_array (writer, obj, encode_options (), obj.dims ());
 //! @endcode
 
 template <typename T> void
-encode_array (T& writer, const octave_value& obj, const bool& ConvertInfAndNaN,
-              const dim_vector& original_dims, int level = 0,
-              bool is_logical = false)
+encode_array (T& writer, const octave_value& obj,
+              const encode_options& options, const dim_vector& original_dims,
+              int level = 0, bool is_logical = false)
 {
   NDArray array = obj.array_value ();
   // is_logical is assigned at level 0.  I think this is better than changing
@@ -295,17 +1417,7 @@ encode_array (T& writer, const octave_value& obj, const bool& ConvertInfAndNaN,
       writer.EndArray ();
     }
   else if (array.isvector ())
-    {
-      writer.StartArray ();
-      for (octave_idx_type i = 0; i < array.numel (); ++i)
-        {
-          if (is_logical)
-            encode_numeric (writer, bool (array(i)), ConvertInfAndNaN);
-          else
-            encode_numeric (writer, array(i), ConvertInfAndNaN);
-        }
-      writer.EndArray ();
-    }
+    encode_numeric_vector (writer, array, options, is_logical);
   else
     {
       octave_idx_type idx;
@@ -325,7 +1437,7 @@ encode_array (T& writer, const octave_value& obj, const bool& ConvertInfAndNaN,
             for (int i = level; i < ndims - 1; ++i)
               writer.StartArray ();
 
-          encode_array (writer, array.as_row (), ConvertInfAndNaN,
+          encode_array (writer, array.as_row (), options,
                         original_dims, level + 1, is_logical);
 
           if (level != 0)
@@ -340,7 +1452,7 @@ encode_array (T& writer, const octave_value& obj, const bool& ConvertInfAndNaN,
           if (original_dims (level) == 1)
           {
             writer.StartArray ();
-            encode_array (writer, array, ConvertInfAndNaN,
+            encode_array (writer, array, options,
                           original_dims, level + 1, is_logical);
             writer.EndArray ();
           }
@@ -362,79 +1474,842 @@ encode_array (T& writer, const octave_value& obj, const bool& ConvertInfAndNaN,
               for (octave_idx_type i = idx ; i < ndims - 1; ++i)
                 conversion_dims(i) = i + 2;
 
-              octave_value_list args (obj);
-              args.append (conversion_dims);
+              octave_value_list args (obj);
+              args.append (conversion_dims);
+
+              Cell sub_arrays = Fnum2cell (args)(0).cell_value ();
+
+              writer.StartArray ();
+
+              for (octave_idx_type i = 0; i < sub_arrays.numel (); ++i)
+                encode_array (writer, sub_arrays(i), options,
+                              original_dims, level + 1, is_logical);
+
+              writer.EndArray ();
+            }
+        }
+    }
+}
+
+//! Encodes any Octave object, except that Cells and structs are not
+//! encoded, but pushed on the stack of @ref encode.  This function only
+//! serves as an interface by choosing which function to call from the
+//! previous functions.
+//!
+//! @param writer RapidJSON's writer that is responsible for generating JSON.
+//! @param obj any @ref octave_value that is supported.
+//! @param options @ref encode_options of this jsonencode call.
+//! @param stack stack of Cells and structs that are being encoded.
+
+template <typename T> void
+encode_value (T& writer, const octave_value& obj,
+              const encode_options& options, std::vector<encode_frame>& stack)
+{
+  if (obj.is_real_scalar ())
+    encode_numeric (writer, obj, options);
+  // As I checked for scalars, this will detect numeric & logical arrays
+  else if (obj.issparse ())
+    {
+      if (obj.iscomplex ())
+        error ("jsonencode: unsupported type");
+
+      if (obj.islogical ())
+        {
+          if (options.compact_sparse)
+            encode_sparse_compact (writer, obj.sparse_bool_matrix_value (),
+                                   options);
+          else
+            encode_sparse (writer, obj.sparse_bool_matrix_value (), options);
+        }
+      else
+        {
+          if (options.compact_sparse)
+            encode_sparse_compact (writer, obj.sparse_matrix_value (),
+                                   options);
+          else
+            encode_sparse (writer, obj.sparse_matrix_value (), options);
+        }
+    }
+  else if (obj.isnumeric () || obj.islogical ())
+    {
+      if (options.base64_arrays)
+        encode_base64_array (writer, obj);
+      else
+        encode_array (writer, obj, options, obj.dims ());
+    }
+  else if (obj.is_string ())
+    encode_string (writer, obj, obj.dims ());
+  else if (obj.isstruct ())
+    stack.emplace_back (obj.map_value ());
+  else if (obj.iscell ())
+    {
+      Cell cell = obj.cell_value ();
+      if (! encode_flat_cell (writer, cell, options))
+        stack.emplace_back (cell);
+    }
+  else if (obj.class_name () == "containers.Map")
+    // To extract the data in containers.Map, convert it to a struct.
+    // The struct will have a "map" field whose value is a struct that
+    // contains the desired data.
+    // To avoid warnings due to that conversion, disable the
+    // "Octave:classdef-to-struct" warning and re-enable it.
+    {
+      octave::unwind_action restore_warning_state
+        ([] (const octave_value_list& old_warning_state)
+         {
+           set_warning_state (old_warning_state);
+         }, set_warning_state ("Octave:classdef-to-struct", "off"));
+
+      stack.emplace_back (obj.scalar_map_value ().getfield ("map")
+                             .map_value ());
+    }
+  else if (obj.isobject ())
+    {
+      octave::unwind_action restore_warning_state
+        ([] (const octave_value_list& old_warning_state)
+         {
+           set_warning_state (old_warning_state);
+         }, set_warning_state ("Octave:classdef-to-struct", "off"));
+
+      stack.emplace_back (octave_map (obj.scalar_map_value ()));
+    }
+  else
+    error ("jsonencode: unsupported type");
+}
+
+template <typename T> void
+encode_rows (T& writer, const octave_value& obj,
+             const encode_options& options);
+
+//! Encodes any Octave object.
+//!
+//! Nested Cells and structs are traversed with an explicit stack on the
+//! heap instead of recursive function calls, so arbitrarily deep values
+//! cannot overflow the call stack of the Octave process.
+//!
+//! @param writer RapidJSON's writer that is responsible for generating JSON.
+//! @param obj any @ref octave_value that is supported.
+//! @param options @ref encode_options of this jsonencode call.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! octave_value obj (true);
+//! encode (writer, obj, encode_options ());
+//! @endcode
+
+template <typename T> void
+encode (T& writer, const octave_value& obj, const encode_options& options)
+{
+  if (options.rows)
+    {
+      encode_rows (writer, obj, options);
+      return;
+    }
+
+  std::vector<encode_frame> stack;
+  encode_value (writer, obj, options, stack);
+
+  octave_value elem;
+  while (! stack.empty ())
+    {
+      if (stack.back ().next (writer, elem))
+        encode_value (writer, elem, options, stack);
+      else
+        stack.pop_back ();
+    }
+}
+
+//! Numeric or logical column of @ref encode_rows, read in place.
+//!
+//! The native array of the column is kept, whatever its class, and its
+//! elements are converted to double one at a time.  Thus no copy of the
+//! column is made.
+
+class number_column
+{
+public:
+
+  //! Reads @p col, which must be a real numeric or logical array.
+
+  void assign (const octave_value& col)
+  {
+    switch (col.builtin_type ())
+      {
+      case btyp_double:
+        keep (col.array_value ());
+        break;
+      case btyp_float:
+        keep (col.float_array_value ());
+        break;
+      case btyp_bool:
+        keep (col.bool_array_value ());
+        break;
+      case btyp_int8:
+        keep (col.int8_array_value ());
+        break;
+      case btyp_int16:
+        keep (col.int16_array_value ());
+        break;
+      case btyp_int32:
+        keep (col.int32_array_value ());
+        break;
+      case btyp_int64:
+        keep (col.int64_array_value ());
+        break;
+      case btyp_uint8:
+        keep (col.uint8_array_value ());
+        break;
+      case btyp_uint16:
+        keep (col.uint16_array_value ());
+        break;
+      case btyp_uint32:
+        keep (col.uint32_array_value ());
+        break;
+      case btyp_uint64:
+        keep (col.uint64_array_value ());
+        break;
+      default:
+        error ("jsonencode: unsupported numeric class '%s'",
+               col.class_name ().c_str ());
+      }
+  }
+
+  //! @return element @p i converted to double.
+
+  double operator () (octave_idx_type i) const { return m_get (m_data, i); }
+
+private:
+
+  template <typename E>
+  static double get (const void *data, octave_idx_type i)
+  {
+    return static_cast<double> (static_cast<const E *> (data)[i]);
+  }
+
+  template <typename ARRAY>
+  void keep (const ARRAY& array)
+  {
+    std::shared_ptr<ARRAY> copy = std::make_shared<ARRAY> (array);
+    m_data = copy->data ();
+    m_get = &get<typename ARRAY::element_type>;
+    m_array = copy;
+  }
+
+  //! Shares the data of the column, so that @c m_data stays valid.
+  std::shared_ptr<const void> m_array;
+  const void *m_data = nullptr;
+  double (*m_get) (const void *, octave_idx_type) = nullptr;
+};
+
+//! Encodes a scalar struct of columns into a JSON array of objects, one
+//! per row.
+//!
+//! The columns are read in place, no struct array, no copy of a column,
+//! and no Octave value per row is created.  Numeric and logical columns
+//! of any class are vectors, char columns are matrices with one string per
+//! row, and Cell columns are vectors whose elements are encoded like any
+//! other value.
+//!
+//! @param writer RapidJSON's writer that is responsible for generating JSON.
+//! @param obj scalar struct of columns with the same number of rows.
+//! @param options @ref encode_options of this jsonencode call.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! octave_scalar_map columns;
+//! columns.assign ("id", NDArray (dim_vector (3, 1), 1.0));
+//! encode_rows (writer, columns, encode_options ());
+//! @endcode
+
+template <typename T> void
+encode_rows (T& writer, const octave_value& obj,
+             const encode_options& options)
+{
+  if (! obj.isstruct () || obj.numel () != 1)
+    error ("jsonencode: 'Rows' requires a scalar struct of columns");
+
+  enum column_kind { number, boolean, string, cell };
+
+  octave_scalar_map columns = obj.scalar_map_value ();
+  string_vector keys = columns.fieldnames ();
+  octave_idx_type nfields = keys.numel ();
+
+  std::vector<column_kind> kinds (nfields);
+  std::vector<number_column> numbers (nfields);
+  std::vector<charMatrix> chars (nfields);
+  std::vector<Cell> cells (nfields);
+  octave_idx_type nrows = 0;
+  for (octave_idx_type k = 0; k < nfields; ++k)
+    {
+      octave_value col = columns.getfield (keys(k));
+      octave_idx_type rows;
+      if (col.is_string ())
+        {
+          kinds[k] = string;
+          chars[k] = col.char_matrix_value ();
+          rows = col.rows ();
+        }
+      else
+        {
+          if (! col.dims ().isvector () && ! col.isempty ())
+            error ("jsonencode: column '%s' must be a vector for 'Rows'",
+                   keys(k).c_str ());
+
+          if (col.iscell ())
+            {
+              kinds[k] = cell;
+              cells[k] = col.cell_value ();
+            }
+          else if ((col.isnumeric () || col.islogical ())
+                   && ! col.iscomplex () && ! col.issparse ())
+            {
+              kinds[k] = col.islogical () ? boolean : number;
+              numbers[k].assign (col);
+            }
+          else
+            error ("jsonencode: unsupported type of column '%s' for 'Rows'",
+                   keys(k).c_str ());
+          rows = col.numel ();
+        }
+
+      if (k == 0)
+        nrows = rows;
+      else if (rows != nrows)
+        error ("jsonencode: all columns must have the same number of rows "
+               "for 'Rows'");
+    }
+
+  // Elements of Cell columns are encoded as usual.
+  encode_options elem_options = options;
+  elem_options.rows = false;
+
+  std::string str;
+  writer.StartArray ();
+  for (octave_idx_type i = 0; i < nrows; ++i)
+    {
+      writer.StartObject ();
+      for (octave_idx_type k = 0; k < nfields; ++k)
+        {
+          writer.Key (keys(k).c_str ());
+          switch (kinds[k])
+            {
+            case boolean:
+              encode_numeric (writer, numbers[k](i) != 0, options);
+              break;
+            case string:
+              str.resize (chars[k].cols ());
+              for (octave_idx_type j = 0; j < chars[k].cols (); ++j)
+                str[j] = chars[k](i, j);
+              writer.String (str.c_str ());
+              break;
+            case cell:
+              encode (writer, cells[k](i), elem_options);
+              break;
+            default:
+              encode_numeric (writer, numbers[k](i), options);
+              break;
+            }
+        }
+      writer.EndObject ();
+    }
+  writer.EndArray ();
+}
+
+//! Escapes the non-ASCII characters of JSON text as @c \\uXXXX.
+//!
+//! Characters beyond U+FFFF are written as UTF-16 surrogate pairs.  As
+//! non-ASCII characters only occur inside strings of JSON text, they are
+//! replaced without parsing the text again.  Runs of ASCII characters are
+//! found by @ref ascii_prefix and copied at once.
+//!
+//! @param json JSON text.
+//! @param len number of bytes of @p json.
+//! @param[out] retval ASCII only JSON text.
+//!
+//! @return @c false if @p json is not valid UTF-8.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! std::string ascii;
+//! bool ok = escape_non_ascii ("\"\xC3\xA9\"", 4, ascii);
+//! @endcode
+
+bool
+escape_non_ascii (const char *json, std::size_t len, std::string& retval)
+{
+  std::size_t i = ascii_prefix (json, len);
+  retval.assign (json, i);
+  if (i == len)
+    return true;
+
+  retval.reserve (len + len / 2);
+
+  // Buffer for "\uXXXX" (+1 for null terminator).
+  char escape[7];
+  while (i < len)
+    {
+      uint32_t codepoint;
+      std::size_t n = decode_utf8 (json + i, len - i, codepoint);
+      if (n == 0)
+        return false;
+      i += n;
+
+      if (codepoint >= 0x10000)
+        {
+          codepoint -= 0x10000;
+          std::snprintf (escape, sizeof (escape), "\\u%04X",
+                         0xD800 + (codepoint >> 10));
+          retval += escape;
+          codepoint = 0xDC00 + (codepoint & 0x3FF);
+        }
+      std::snprintf (escape, sizeof (escape), "\\u%04X", codepoint);
+      retval += escape;
+
+      n = ascii_prefix (json + i, len - i);
+      retval.append (json + i, n);
+      i += n;
+    }
+
+  return true;
+}
+
+//! @return ASCII only JSON text of @p json, see above.
+
+std::string
+escape_non_ascii (const char *json, std::size_t len)
+{
+  std::string retval;
+  if (! escape_non_ascii (json, len, retval))
+    error ("jsonencode: strings must be valid UTF-8 for 'ASCII'");
+  return retval;
+}
+
+//! Encodes each element of a Cell or struct array into its own JSON text.
+//!
+//! The output buffer and the writer are reused for all elements, only the
+//! finished texts are copied into the result.  The fields of a struct array
+//! are looked up once, the elements are never converted to scalar structs.
+//!
+//! @param writer RapidJSON's writer that writes into @p json.
+//! @param json output buffer of @p writer.
+//! @param obj Cell or struct array.
+//! @param options @ref encode_options of this jsonencode call.
+//!
+//! @return cellstr with the dimensions of @p obj.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! rapidjson::StringBuffer json;
+//! rapidjson::Writer<rapidjson::StringBuffer> writer (json);
+//! Cell texts = encode_elements (writer, json, Cell (ovl (1, "a")),
+//!                               encode_options ());
+//! @endcode
+
+template <typename T> Cell
+encode_elements (T& writer, rapidjson::StringBuffer& json,
+                 const octave_value& obj, const encode_options& options)
+{
+  Cell retval (obj.dims ());
+
+  Cell cell;
+  string_vector keys;
+  std::vector<Cell> values;
+  if (obj.iscell ())
+    cell = obj.cell_value ();
+  else
+    {
+      octave_map map = obj.map_value ();
+      keys = map.keys ();
+      for (octave_idx_type k = 0; k < keys.numel (); ++k)
+        values.push_back (map.contents (keys(k)));
+    }
+
+  for (octave_idx_type i = 0; i < retval.numel (); ++i)
+    {
+      json.Clear ();
+      writer.Reset (json);
+
+      if (obj.iscell ())
+        encode (writer, cell(i), options);
+      else
+        {
+          writer.StartObject ();
+          for (octave_idx_type k = 0; k < keys.numel (); ++k)
+            {
+              writer.Key (keys(k).c_str ());
+              encode (writer, values[k](i), options);
+            }
+          writer.EndObject ();
+        }
+
+      if (options.ascii)
+        retval(i) = escape_non_ascii (json.GetString (), json.GetSize ());
+      else
+        retval(i) = std::string (json.GetString (), json.GetSize ());
+    }
+
+  return retval;
+}
+
+//! Options of a jsonencode call, parsed once from its arguments.
+
+struct jsonencode_settings
+{
+  jsonencode_settings (const octave_value_list& args, int first);
+
+  //! @return options for the encode functions.
+
+  encode_options options (void) const
+  {
+    encode_options retval;
+    retval.convert_inf_and_nan = convert_inf_and_nan;
+    retval.base64_arrays = (numeric_encoding == "base64");
+    retval.compact_sparse = (sparse_encoding == "compact");
+    retval.rows = rows;
+    retval.ascii = ascii;
+    return retval;
+  }
+
+  bool convert_inf_and_nan = true;
+  bool pretty_print = false;
+  bool per_element = false;
+  bool rows = false;
+  bool ascii = false;
+  std::string format = "json";
+  std::string numeric_encoding = "text";
+  std::string sparse_encoding = "dense";
+};
+
+//! Parses the options of a jsonencode call.
+//!
+//! @param args arguments of the jsonencode call.
+//! @param first index of the first option in @p args.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! jsonencode_settings settings (ovl (1, "PrettyPrint", true), 1);
+//! @endcode
+
+jsonencode_settings::jsonencode_settings (const octave_value_list& args,
+                                          int first)
+{
+  for (octave_idx_type i = first; i < args.length (); ++i)
+    {
+      if (! args(i).is_string ())
+        error ("jsonencode: option must be a string");
+
+      std::string option_name = args(i++).string_value ();
+      if (octave::string::strcmpi (option_name, "Format"))
+        {
+          format = args(i).xstring_value ("jsonencode: "
+                                          "'Format' value must be a string");
+          std::transform (format.begin (), format.end (), format.begin (),
+                          ::tolower);
+          if (format != "json" && format != "cbor" && format != "msgpack")
+            error ("jsonencode: "
+                   R"('Format' must be "json", "cbor", or "msgpack")");
+          continue;
+        }
+      else if (octave::string::strcmpi (option_name, "NumericEncoding"))
+        {
+          numeric_encoding = args(i).xstring_value ("jsonencode: "
+            "'NumericEncoding' value must be a string");
+          std::transform (numeric_encoding.begin (), numeric_encoding.end (),
+                          numeric_encoding.begin (), ::tolower);
+          if (numeric_encoding != "text" && numeric_encoding != "base64")
+            error ("jsonencode: "
+                   R"('NumericEncoding' must be "text" or "base64")");
+          continue;
+        }
+      else if (octave::string::strcmpi (option_name, "SparseEncoding"))
+        {
+          sparse_encoding = args(i).xstring_value ("jsonencode: "
+            "'SparseEncoding' value must be a string");
+          std::transform (sparse_encoding.begin (), sparse_encoding.end (),
+                          sparse_encoding.begin (), ::tolower);
+          if (sparse_encoding != "dense" && sparse_encoding != "compact")
+            error ("jsonencode: "
+                   R"('SparseEncoding' must be "dense" or "compact")");
+          continue;
+        }
+
+      if (! args(i).is_bool_scalar ())
+        error ("jsonencode: option value must be a logical scalar");
+
+      if (octave::string::strcmpi (option_name, "ConvertInfAndNaN"))
+        convert_inf_and_nan = args(i).bool_value ();
+      else if (octave::string::strcmpi (option_name, "PrettyPrint"))
+        pretty_print = args(i).bool_value ();
+      else if (octave::string::strcmpi (option_name, "PerElement"))
+        per_element = args(i).bool_value ();
+      else if (octave::string::strcmpi (option_name, "Rows"))
+        rows = args(i).bool_value ();
+      else if (octave::string::strcmpi (option_name, "ASCII"))
+        ascii = args(i).bool_value ();
+      else
+        error ("jsonencode: "
+               R"(Valid options are "ConvertInfAndNaN", "PrettyPrint", )"
+               R"("PerElement", "Rows", "ASCII", "Format", )"
+               R"("NumericEncoding", and "SparseEncoding")");
+    }
+
+  if (ascii && format != "json")
+    error ("jsonencode: 'ASCII' requires 'Format' \"json\"");
+
+  if (per_element)
+    {
+      if (rows)
+        error ("jsonencode: the 'PerElement' and 'Rows' options cannot be "
+               "combined");
+      if (format != "json")
+        error ("jsonencode: 'PerElement' requires 'Format' \"json\"");
+    }
+
+# if ! defined (HAVE_RAPIDJSON_PRETTYWRITER)
+  if (pretty_print)
+    {
+      warn_disabled_feature ("jsonencode",
+                             R"(the "PrettyPrint" option of RapidJSON)");
+      pretty_print = false;
+    }
+# endif
+}
+
+//! Writes the JSON text of @p snapshot into @p stream.
+
+template <typename Stream> void
+write_json (Stream& stream, const encode_snapshot& snapshot, bool pretty_print)
+{
+  if (pretty_print)
+    {
+# if defined (HAVE_RAPIDJSON_PRETTYWRITER)
+      rapidjson::PrettyWriter<Stream, rapidjson::UTF8<>, rapidjson::UTF8<>,
+                              rapidjson::CrtAllocator,
+                              rapidjson::kWriteNanAndInfFlag> writer (stream);
+      writer.SetIndent (' ', 2);
+      snapshot.replay (writer);
+# endif
+    }
+  else
+    {
+      rapidjson::Writer<Stream, rapidjson::UTF8<>, rapidjson::UTF8<>,
+                        rapidjson::CrtAllocator,
+                        rapidjson::kWriteNanAndInfFlag> writer (stream);
+      snapshot.replay (writer);
+    }
+}
+
+//! Encoding of jsonencode_async in a background thread.
+//!
+//! The Octave value has been recorded into an @ref encode_snapshot by the
+//! interpreter thread.  The background thread replays it into the writer
+//! of the output format, and into a compressed file with @c "ToFile".  It
+//! makes no Octave calls, errors are kept as messages.  The Octave value
+//! of the output is created by @ref fetch in the interpreter thread.
+
+class async_encode
+{
+public:
+
+  //! Starts writing @p snapshot in a background thread.
+  //!
+  //! @param settings parsed options of the jsonencode_async call.
+  //! @param snapshot recorded Octave value.
+  //! @param filename output file, or empty for a return value.
+
+  async_encode (const jsonencode_settings& settings, encode_snapshot snapshot,
+                std::string filename)
+    : m_settings (settings), m_snapshot (std::move (snapshot)),
+      m_filename (std::move (filename))
+  {
+    m_task = std::async (std::launch::async, [this] (void) { run (); });
+  }
+
+  // No copying!
+
+  async_encode (const async_encode&) = delete;
+
+  async_encode& operator = (const async_encode&) = delete;
+
+  //! @return @c true if formatting and writing are finished.
+
+  bool ready (void) const
+  {
+    return m_finished
+           || (m_task.wait_for (std::chrono::seconds (0))
+               == std::future_status::ready);
+  }
+
+  //! Waits for the background thread and returns its output.
+  //!
+  //! The output is converted once, further calls return it again.
+  //!
+  //! @return JSON text as char array, binary data as uint8 array, or an
+  //! empty value if the output has been written to a file.
+
+  octave_value fetch (void)
+  {
+    if (! m_finished)
+      {
+        m_finished = true;
+        m_task.get ();
+      }
+
+    if (! m_error.empty ())
+      error ("%s", m_error.c_str ());
+
+    if (m_value.is_undefined ())
+      {
+        if (! m_filename.empty ())
+          m_value = Matrix ();
+        else if (m_settings.format != "json")
+          {
+            uint8NDArray bytes (dim_vector (1, m_output.size ()));
+            std::memcpy (bytes.fortran_vec (), m_output.data (),
+                         m_output.size ());
+            m_value = bytes;
+          }
+        else
+          m_value = m_output;
+
+        // The output is not needed anymore.
+        std::string ().swap (m_output);
+      }
+
+    return m_value;
+  }
+
+private:
+
+  //! Body of the background thread.
+
+  void run (void)
+  {
+    if (! m_filename.empty ())
+      {
+        // The text is compressed while it is written.
+        json_file_writer file (m_filename,
+                               compression_by_extension (m_filename));
+        if (file.error ().empty ())
+          write_json (file, m_snapshot, m_settings.pretty_print);
+        if (! file.close ())
+          m_error = "jsonencode_async: " + file.error ();
+      }
+    else if (m_settings.format == "cbor")
+      {
+        cbor_writer writer;
+        m_snapshot.replay (writer);
+        m_output = writer.data ();
+      }
+    else if (m_settings.format == "msgpack")
+      {
+        msgpack_writer writer;
+        m_snapshot.replay (writer);
+        m_output = writer.data ();
+      }
+    else
+      {
+        rapidjson::StringBuffer json;
+        write_json (json, m_snapshot, m_settings.pretty_print);
+        if (! m_settings.ascii)
+          m_output.assign (json.GetString (), json.GetSize ());
+        else if (! escape_non_ascii (json.GetString (), json.GetSize (),
+                                     m_output))
+          m_error = "jsonencode_async: strings must be valid UTF-8 for "
+                    "'ASCII'";
+      }
+
+    // The snapshot is not needed anymore.
+    m_snapshot = encode_snapshot ();
+  }
+
+  jsonencode_settings m_settings;
+  encode_snapshot m_snapshot;
+  std::string m_filename;
+
+  std::string m_output;
+  std::string m_error;
+
+  octave_value m_value;
+  bool m_finished = false;
+
+  //! Declared last, so that it is destroyed first: the destructor of the
+  //! future waits for the background thread, which uses the other members.
+  std::future<void> m_task;
+};
+
+//! Handle to an @ref async_encode returned by @c jsonencode_async.
+
+class octave_json_encode_future : public octave_base_value
+{
+public:
+
+  octave_json_encode_future (void) = default;
+
+  octave_json_encode_future (const jsonencode_settings& settings,
+                             encode_snapshot snapshot, std::string filename)
+    : m_task (std::make_shared<async_encode> (settings, std::move (snapshot),
+                                              std::move (filename)))
+  { }
+
+  octave_base_value * clone (void) const
+  { return new octave_json_encode_future (*this); }
+
+  octave_base_value * empty_clone (void) const
+  { return new octave_json_encode_future (); }
+
+  async_encode& task (void) const { return *m_task; }
 
-              Cell sub_arrays = Fnum2cell (args)(0).cell_value ();
+  bool is_defined (void) const { return true; }
 
-              writer.StartArray ();
+  dim_vector dims (void) const { return dim_vector (1, 1); }
 
-              for (octave_idx_type i = 0; i < sub_arrays.numel (); ++i)
-                encode_array (writer, sub_arrays(i), ConvertInfAndNaN,
-                              original_dims, level + 1, is_logical);
+  bool print_as_scalar (void) const { return true; }
 
-              writer.EndArray ();
-            }
-        }
-    }
-}
+  void print (std::ostream& os, bool pr_as_read_syntax = false)
+  {
+    print_raw (os, pr_as_read_syntax);
+    newline (os);
+  }
 
-//! Encodes any Octave object. This function only serves as an interface
-//! by choosing which function to call from the previous functions.
-//!
-//! @param writer RapidJSON's writer that is responsible for generating JSON.
-//! @param obj any @ref octave_value that is supported.
-//! @param ConvertInfAndNaN @c bool that converts @c Inf and @c NaN to @c null.
-//!
-//! @b Example:
+  void print_raw (std::ostream& os, bool = false) const
+  {
+    indent (os);
+    os << "<json_encode_future: "
+       << (m_task && m_task->ready () ? "ready" : "pending") << ">";
+  }
+
+private:
+
+  std::shared_ptr<async_encode> m_task;
+
+  DECLARE_OV_TYPEID_FUNCTIONS_AND_DATA
+};
+
+DEFINE_OV_TYPEID_FUNCTIONS_AND_DATA (octave_json_encode_future,
+                                     "json_encode_future",
+                                     "json_encode_future");
+
+//! Registers the Octave value type @p T on first use.
 //!
-//! @code{.cc}
-//! octave_value obj (true);
-//! encode (writer, obj,true);
-//! @endcode
+//! The oct-file is locked, because values of the type must not outlive
+//! the code of their class.
 
 template <typename T> void
-encode (T& writer, const octave_value& obj, const bool& ConvertInfAndNaN)
+register_type_once (octave::interpreter& interp)
 {
-  if (obj.is_real_scalar ())
-    encode_numeric (writer, obj, ConvertInfAndNaN);
-  // As I checked for scalars, this will detect numeric & logical arrays
-  else if (obj.isnumeric () || obj.islogical ())
-    encode_array (writer, obj, ConvertInfAndNaN, obj.dims ());
-  else if (obj.is_string ())
-    encode_string (writer, obj, obj.dims ());
-  else if (obj.isstruct ())
-    encode_struct (writer, obj, ConvertInfAndNaN);
-  else if (obj.iscell ())
-    encode_cell (writer, obj, ConvertInfAndNaN);
-  else if (obj.class_name () == "containers.Map")
-    // To extract the data in containers.Map, convert it to a struct.
-    // The struct will have a "map" field whose value is a struct that
-    // contains the desired data.
-    // To avoid warnings due to that conversion, disable the
-    // "Octave:classdef-to-struct" warning and re-enable it.
-    {
-      octave::unwind_action restore_warning_state
-        ([] (const octave_value_list& old_warning_state)
-         {
-           set_warning_state (old_warning_state);
-         }, set_warning_state ("Octave:classdef-to-struct", "off"));
-
-      encode_struct (writer, obj.scalar_map_value ().getfield ("map"),
-                     ConvertInfAndNaN);
-    }
-  else if (obj.isobject ())
+  static bool type_loaded = false;
+  if (! type_loaded)
     {
-      octave::unwind_action restore_warning_state
-        ([] (const octave_value_list& old_warning_state)
-         {
-           set_warning_state (old_warning_state);
-         }, set_warning_state ("Octave:classdef-to-struct", "off"));
-
-      encode_struct (writer, obj.scalar_map_value (), ConvertInfAndNaN);
+      T::register_type ();
+      interp.mlock ();
+      type_loaded = true;
     }
-  else
-    error ("jsonencode: unsupported type");
 }
 
 #endif
@@ -444,6 +2319,12 @@ DEFUN_DLD (jsonencode, args, ,
 @deftypefn  {} {@var{JSON_txt} =} jsonencode (@var{object})                  \n\
 @deftypefnx {} {@var{JSON_txt} =} jsonencode (@dots{}, \"ConvertInfAndNaN\", @var{TF}) \n\
 @deftypefnx {} {@var{JSON_txt} =} jsonencode (@dots{}, \"PrettyPrint\", @var{TF}) \n\
+@deftypefnx {} {@var{bytes} =} jsonencode (@dots{}, \"Format\", @var{fmt}) \n\
+@deftypefnx {} {@var{JSON_txt} =} jsonencode (@dots{}, \"NumericEncoding\", @var{enc}) \n\
+@deftypefnx {} {@var{JSON_txt} =} jsonencode (@dots{}, \"SparseEncoding\", @var{enc}) \n\
+@deftypefnx {} {@var{C} =} jsonencode (@dots{}, \"PerElement\", @var{TF})    \n\
+@deftypefnx {} {@var{JSON_txt} =} jsonencode (@dots{}, \"Rows\", @var{TF})   \n\
+@deftypefnx {} {@var{JSON_txt} =} jsonencode (@dots{}, \"ASCII\", @var{TF})  \n\
                                                                              \n\
 Encode Octave data types into JSON text.                                     \n\
                                                                              \n\
@@ -461,6 +2342,46 @@ If the value of the option @qcode{\"PrettyPrint\"} is true, the output text will
 have indentations and line feeds.  If it is false, the output will be condensed \n\
 and written without whitespace.  The default value for this option is false. \n\
                                                                              \n\
+The option @qcode{\"Format\"} selects the output format: @qcode{\"json\"}  \n\
+(default) returns JSON text, @qcode{\"cbor\"} and @qcode{\"msgpack\"} return  \n\
+a @code{uint8} row vector @var{bytes} with the same data encoded as CBOR    \n\
+(RFC 8949) or MessagePack.  In CBOR, numeric vectors are written as typed   \n\
+arrays of float64 (RFC 8746).  @qcode{\"PrettyPrint\"} has no effect on     \n\
+binary formats.                                                              \n\
+                                                                             \n\
+If the value of the option @qcode{\"NumericEncoding\"} is @qcode{\"base64\"}, \n\
+every non-scalar numeric or logical array is written as an object         \n\
+@code{@{\"dtype\":@dots{},\"shape\":[@dots{}],\"data\":\"@dots{}\"@}} where    \n\
+@qcode{\"data\"} is the base64 encoded little-endian column-major memory of \n\
+the array.  This is much faster and exact for large arrays, and can be read  \n\
+back with @code{jsondecode (@dots{}, \"NumericEncoding\", \"base64\")}.      \n\
+The default value @qcode{\"text\"} writes numbers as JSON text.              \n\
+                                                                             \n\
+Sparse matrices are written as their full matrices by default              \n\
+(@qcode{\"SparseEncoding\"} @qcode{\"dense\"}) without creating the full   \n\
+matrix in memory.  If the value of the option is @qcode{\"compact\"}, they  \n\
+are written as objects                                                       \n\
+@code{@{\"sparse\":true,\"size\":[m,n],\"i\":[@dots{}],\"j\":[@dots{}],\"v\":[@dots{}]@}} \n\
+of the one-based indices and values of the nonzero elements, which can be  \n\
+read back with @code{jsondecode (@dots{}, \"SparseEncoding\", \"compact\")}. \n\
+                                                                             \n\
+If the value of the option @qcode{\"PerElement\"} is true, each element of  \n\
+the cell or struct array @var{object} is encoded into its own JSON text and  \n\
+the output @var{C} is a cell array of strings of the same size.  This is     \n\
+much faster than calling @code{jsonencode} for every element.                \n\
+                                                                             \n\
+If the value of the option @qcode{\"ASCII\"} is true, all non-ASCII         \n\
+characters of the JSON text are written as escape sequences @code{\\uXXXX}, \n\
+with surrogate pairs for characters beyond U+FFFF, for consumers that only   \n\
+accept 7-bit text.  Strings must then be valid UTF-8.                        \n\
+                                                                             \n\
+If the value of the option @qcode{\"Rows\"} is true, @var{object} must be a \n\
+scalar struct of columns with the same number of rows, e.g. as returned by   \n\
+@code{jsondecode (@dots{}, \"ArrayOfObjects\", \"columns\")}.  It is encoded \n\
+into a JSON array with one object per row, without creating a struct array. \n\
+Numeric, logical, and cell columns must be vectors; char columns are         \n\
+matrices with one string per row.                                            \n\
+                                                                             \n\
 Programming Notes:                                                           \n\
                                                                              \n\
 @itemize @bullet                                                             \n\
@@ -581,49 +2502,50 @@ jsonencode (containers.Map(@{'foo'; 'bar'; 'baz'@}, [1, 2, 3]))              \n\
 #if defined (HAVE_RAPIDJSON)
 
   int nargin = args.length ();
-  // jsonencode has two options 'ConvertInfAndNaN' and 'PrettyPrint'
-  if (nargin != 1 && nargin != 3 && nargin != 5)
+  // jsonencode options are pairs, the number of arguments must be odd.
+  if (! (nargin % 2))
     print_usage ();
 
-  // Initialize options with their default values
-  bool ConvertInfAndNaN = true;
-  bool PrettyPrint = false;
+  jsonencode_settings settings (args, 1);
+  encode_options options = settings.options ();
 
-  for (octave_idx_type i = 1; i < nargin; ++i)
-    {
-      if (! args(i).is_string ())
-        error ("jsonencode: option must be a string");
-      if (! args(i+1).is_bool_scalar ())
-        error ("jsonencode: option value must be a logical scalar");
+  if (settings.per_element && ! args(0).iscell () && ! args(0).isstruct ())
+    error ("jsonencode: 'PerElement' requires a cell or struct array");
 
-      std::string option_name = args(i++).string_value ();
-      if (octave::string::strcmpi (option_name, "ConvertInfAndNaN"))
-        ConvertInfAndNaN = args(i).bool_value ();
-      else if (octave::string::strcmpi (option_name, "PrettyPrint"))
-        PrettyPrint = args(i).bool_value ();
+  if (settings.format != "json")
+    {
+      // The binary formats have no whitespace, "PrettyPrint" is ignored.
+      std::string bytes;
+      if (settings.format == "cbor")
+        {
+          cbor_writer writer;
+          encode (writer, args(0), options);
+          bytes = writer.data ();
+        }
       else
-        error ("jsonencode: "
-               R"(Valid options are "ConvertInfAndNaN" and "PrettyPrint")");
-    }
+        {
+          msgpack_writer writer;
+          encode (writer, args(0), options);
+          bytes = writer.data ();
+        }
 
-# if ! defined (HAVE_RAPIDJSON_PRETTYWRITER)
-  if (PrettyPrint)
-    {
-      warn_disabled_feature ("jsonencode",
-                             R"(the "PrettyPrint" option of RapidJSON)");
-      PrettyPrint = false;
+      uint8NDArray retval (dim_vector (1, bytes.size ()));
+      std::memcpy (retval.fortran_vec (), bytes.data (), bytes.size ());
+      return octave_value (retval);
     }
-# endif
 
   rapidjson::StringBuffer json;
-  if (PrettyPrint)
+  if (settings.pretty_print)
     {
 # if defined (HAVE_RAPIDJSON_PRETTYWRITER)
       rapidjson::PrettyWriter<rapidjson::StringBuffer, rapidjson::UTF8<>,
                               rapidjson::UTF8<>, rapidjson::CrtAllocator,
                               rapidjson::kWriteNanAndInfFlag> writer (json);
       writer.SetIndent (' ', 2);
-      encode (writer, args(0), ConvertInfAndNaN);
+      if (settings.per_element)
+        return octave_value (encode_elements (writer, json, args(0),
+                                              options));
+      encode (writer, args(0), options);
 # endif
     }
   else
@@ -631,9 +2553,16 @@ jsonencode (containers.Map(@{'foo'; 'bar'; 'baz'@}, [1, 2, 3]))              \n\
       rapidjson::Writer<rapidjson::StringBuffer, rapidjson::UTF8<>,
                         rapidjson::UTF8<>, rapidjson::CrtAllocator,
                         rapidjson::kWriteNanAndInfFlag> writer (json);
-      encode (writer, args(0), ConvertInfAndNaN);
+      if (settings.per_element)
+        return octave_value (encode_elements (writer, json, args(0),
+                                              options));
+      encode (writer, args(0), options);
     }
 
+  if (settings.ascii)
+    return octave_value (escape_non_ascii (json.GetString (),
+                                           json.GetSize ()));
+
   return octave_value (json.GetString ());
 
 #else
@@ -659,5 +2588,570 @@ Functional BIST tests are located in test/json/jsonencode_BIST.tst
 %!       "option value must be a logical scalar");
 %! fail ("jsonencode (1, 'foobar', true)", ...
 %!       'Valid options are "ConvertInfAndNaN"');
+%! fail ("jsonencode (1, 'Format', true)", "'Format' value must be a string");
+%! fail ("jsonencode (1, 'Format', 'bson')", "'Format' must be");
+
+## Binary formats
+%!test
+%! assert (jsonencode (true, 'Format', 'cbor'), uint8 (245));
+%! assert (jsonencode (NaN, 'Format', 'cbor'), uint8 (246));
+%! assert (jsonencode (-500, 'Format', 'cbor'), uint8 ([57, 1, 243]));
+%! assert (jsonencode (0.5, 'Format', 'cbor'), uint8 ([251, 63, 224, 0, 0, 0, 0, 0, 0]));
+%! assert (jsonencode ('ab', 'Format', 'cbor'), uint8 ([98, 97, 98]));
+%! assert (jsonencode ({1, 'a'}, 'Format', 'cbor'), uint8 ([130, 1, 97, 97]));
+%! assert (jsonencode (struct ('a', 1), 'Format', 'cbor'), uint8 ([161, 97, 97, 1]));
+
+%!test
+%! bytes = jsonencode ([1.5, 2, Inf], 'Format', 'cbor');
+%! assert (bytes(1), uint8 (216));
+%! assert (any (bytes(2) == [82, 86]));
+%! assert (bytes(3:4), uint8 ([88, 24]));
+%! if (bytes(2) == 86)
+%!   assert (typecast (bytes(5:end), 'double'), [1.5, 2, NaN]);
+%! endif
+
+%!test
+%! assert (jsonencode (true, 'Format', 'msgpack'), uint8 (195));
+%! assert (jsonencode (-500, 'Format', 'msgpack'), uint8 ([209, 254, 12]));
+%! assert (jsonencode ('ab', 'Format', 'msgpack'), uint8 ([162, 97, 98]));
+%! assert (jsonencode (struct ('a', 1), 'Format', 'msgpack'), ...
+%!         uint8 ([129, 161, 97, 1]));
+%! assert (jsonencode ([1, 2], 'Format', 'msgpack'), uint8 ([146, 1, 2]));
+%! assert (jsonencode (num2cell (ones (1, 30)), 'Format', 'msgpack'), ...
+%!         uint8 ([220, 0, 30, ones(1, 30)]));
+
+%!test
+%! fail ("jsonencode (1, 'NumericEncoding', 1)", ...
+%!       "'NumericEncoding' value must be a string");
+%! fail ("jsonencode (1, 'NumericEncoding', 'hex')", ...
+%!       "'NumericEncoding' must be");
+%! fail ("jsonencode ([1i, 2], 'NumericEncoding', 'base64')", ...
+%!       "unsupported type");
+
+%!test
+%! assert (jsonencode (uint8 ([1, 2, 3]), 'NumericEncoding', 'base64'), ...
+%!         '{"dtype":"uint8","shape":[1,3],"data":"AQID"}');
+%! assert (jsonencode (int16 ([1; -1]), 'NumericEncoding', 'base64'), ...
+%!         '{"dtype":"int16","shape":[2,1],"data":"AQD//w=="}');
+%! assert (jsonencode ([1, 2, 3], 'NumericEncoding', 'base64'), ...
+%!         '{"dtype":"float64","shape":[1,3],"data":"AAAAAAAA8D8AAAAAAAAAQAAAAAAAAAhA"}');
+%! assert (jsonencode (uint8 (0:19), 'NumericEncoding', 'base64'), ...
+%!         '{"dtype":"uint8","shape":[1,20],"data":"AAECAwQFBgcICQoLDA0ODxAREhM="}');
+%! assert (jsonencode (struct ('a', [true, false]), 'NumericEncoding', 'base64'), ...
+%!         '{"a":{"dtype":"bool","shape":[1,2],"data":"AQA="}}');
+%! assert (jsonencode ({1, 'a'}, 'NumericEncoding', 'base64'), '[1,"a"]');
+%! assert (jsonencode ({'ab', zeros(0, 2, 'single')}, 'NumericEncoding', 'base64'), ...
+%!         '["ab",{"dtype":"float32","shape":[0,2],"data":""}]');
+
+%!test
+%! x = 1;
+%! for i = 1:10000
+%!   x = {x};
+%! endfor
+%! assert (jsonencode (x), [repmat('[', 1, 10000), '1', repmat(']', 1, 10000)]);
+%! s = struct ('a', {1, 2}, 'b', {struct(), 'x'});
+%! assert (jsonencode (s), '[{"a":1,"b":{}},{"a":2,"b":"x"}]');
+
+%!test
+%! fail ("jsonencode (1, 'SparseEncoding', 'coo')", "'SparseEncoding' must be");
+%! fail ("jsonencode (sparse ([1i, 0]))", "unsupported type");
+
+%!test
+%! assert (jsonencode (sparse ([1, 0; 0, 2])), '[[1,0],[0,2]]');
+%! assert (jsonencode (sparse ([0, 3, 0])), '[0,3,0]');
+%! assert (jsonencode (sparse ([0; 0; 1.5])), '[0,0,1.5]');
+%! assert (jsonencode (sparse ([true, false])), '[true,false]');
+%! assert (jsonencode (sparse (0, 3)), '[]');
+%! S = sprand (7, 5, 0.3);
+%! assert (jsonencode (S), jsonencode (full (S)));
+%! S = sprand (1, 9, 0.3) > 0;
+%! assert (jsonencode (S), jsonencode (full (S)));
+
+%!test
+%! assert (jsonencode (sparse ([0, 2; 3, 0]), 'SparseEncoding', 'compact'), ...
+%!         '{"sparse":true,"size":[2,2],"i":[2,1],"j":[1,2],"v":[3,2]}');
+%! assert (jsonencode (sparse ([false; true]), 'SparseEncoding', 'compact'), ...
+%!         '{"sparse":true,"size":[2,1],"i":[2],"j":[1],"v":[true]}');
+%! assert (jsonencode (sparse (2, 3), 'SparseEncoding', 'compact'), ...
+%!         '{"sparse":true,"size":[2,3],"i":[],"j":[],"v":[]}');
+%! assert (jsonencode (sparse (1e6, 1e6), 'SparseEncoding', 'compact'), ...
+%!         '{"sparse":true,"size":[1000000,1000000],"i":[],"j":[],"v":[]}');
+
+## ASCII option
+%!test
+%! s = char ([195, 169]);
+%! assert (jsonencode (s, 'ASCII', true), '"\u00E9"');
+%! x = {['caf', s], 'plain', char([226, 130, 172]), char([240, 159, 152, 128])};
+%! assert (jsonencode (x, 'ASCII', true), ...
+%!         '["caf\u00E9","plain","\u20AC","\uD83D\uDE00"]');
+%! assert (jsondecode (jsonencode (x, 'ASCII', true)), x(:));
+%! assert (jsonencode (x, 'ASCII', true, 'PerElement', true), ...
+%!         {'"caf\u00E9"', '"plain"', '"\u20AC"', '"\uD83D\uDE00"'});
+%! assert (jsonencode (struct ('a', ['long ascii prefix ', s]), 'ASCII', true), ...
+%!         '{"a":"long ascii prefix \u00E9"}');
+%! fail ("jsonencode (char (255), 'ASCII', true)", "must be valid UTF-8");
+%! fail ("jsonencode ('a', 'ASCII', true, 'Format', 'cbor')", ...
+%!       "'ASCII' requires 'Format'");
+
+## Rows option
+%!test
+%! t = struct ('id', [1; 2; 3], 'ok', [true; false; true], ...
+%!             'name', ['ab'; 'cd'; 'ef'], 'v', {{[1, 2]; 'x'; struct('a', 1)}});
+%! assert (jsonencode (t, 'Rows', true), ...
+%!         ['[{"id":1,"ok":true,"name":"ab","v":[1,2]},' ...
+%!          '{"id":2,"ok":false,"name":"cd","v":"x"},' ...
+%!          '{"id":3,"ok":true,"name":"ef","v":{"a":1}}]']);
+%! c = struct ('a', [1; 2; NaN], 'c', {{'x'; ''; 'y'}});
+%! assert (jsonencode (c, 'Rows', true), ...
+%!         '[{"a":1,"c":"x"},{"a":2,"c":""},{"a":null,"c":"y"}]');
+%! assert (jsonencode (struct ('a', int8 ([1, 2])), 'Rows', true), ...
+%!         '[{"a":1},{"a":2}]');
+%! assert (jsonencode (struct ('a', zeros (0, 1)), 'Rows', true), '[]');
+%! assert (jsonencode (struct ('a', {{1}}), 'Rows', true, 'Format', 'cbor'), ...
+%!         uint8 ([129, 161, 97, 97, 1]));
+%! c = struct ('ok', logical ([1; 0; 1]), 'n', int32 ([-7; 0; 123456]), ...
+%!             'u', uint64 ([0; 5; 3]), 'f', single ([0; 1; -2]));
+%! r = struct ('ok', {true; false; true}, 'n', {int32(-7); int32(0); ...
+%!             int32(123456)}, 'u', {uint64(0); uint64(5); uint64(3)}, ...
+%!             'f', {single(0); single(1); single(-2)});
+%! assert (jsonencode (c, 'Rows', true), jsonencode (r));
+%! assert (jsonencode (c, 'Rows', true, 'Format', 'cbor'), ...
+%!         jsonencode (r, 'Format', 'cbor'));
+%! t = jsondecode ('[{"a":1,"b":"x"},{"a":2,"b":"y"}]', 'ArrayOfObjects', 'columns');
+%! assert (jsonencode (t, 'Rows', true), '[{"a":1,"b":"x"},{"a":2,"b":"y"}]');
+
+%!test
+%! fail ("jsonencode ({1}, 'Rows', true)", "'Rows' requires a scalar struct");
+%! fail ("jsonencode (struct ('a', [1; 2], 'b', 1), 'Rows', true)", ...
+%!       "same number of rows");
+%! fail ("jsonencode (struct ('a', ones (2)), 'Rows', true)", ...
+%!       "column 'a' must be a vector");
+%! fail ("jsonencode (struct ('a', 1i), 'Rows', true)", ...
+%!       "unsupported type of column 'a'");
+%! fail ("jsonencode (struct ('a', 1), 'Rows', true, 'PerElement', true)", ...
+%!       "cannot be combined");
+
+## Cells of strings and scalars
+%!test
+%! assert (jsonencode ({'a', 'bc'; 'd', ''}), '["a","d","bc",""]');
+%! assert (jsonencode ({'x', 1, true, NaN, int8(-3), 1.5, zeros(1, 0, 'char')}), ...
+%!         '["x",1,true,null,-3,1.5,""]');
+%! assert (jsonencode ({Inf}, 'ConvertInfAndNaN', false), '[Infinity]');
+%! assert (jsonencode ({['a', char(0), 'b']}), jsonencode (['a', char(0), 'b']));
+%! assert (jsonencode ({'ab'; ['cd'; 'ef']}), '["ab",["cd","ef"]]');
+%! assert (jsonencode ({'a', {'b', 2}}), '["a",["b",2]]');
+%! assert (jsonencode ({'a', [1, 2]}), '["a",[1,2]]');
+%! assert (jsondecode (jsonencode ({'a', 1}, 'Format', 'cbor'), ...
+%!                     'Format', 'cbor'), {'a'; 1});
+
+## PerElement option
+%!test
+%! s = struct ('id', {1, 2; 3, 4}, 'v', {'a', [1, 2]; {}, struct()});
+%! c = jsonencode (s, 'PerElement', true);
+%! assert (c, {'{"id":1,"v":"a"}', '{"id":2,"v":[1,2]}';
+%!             '{"id":3,"v":[]}', '{"id":4,"v":{}}'});
+%! assert (c{1}, jsonencode (s(1)));
+%! assert (jsonencode ({1; 'x'; {NaN}}, 'PerElement', true), ...
+%!         {'1'; '"x"'; '[null]'});
+%! assert (jsonencode ({Inf}, 'PerElement', true, 'ConvertInfAndNaN', false), ...
+%!         {'Infinity'});
+%! assert (jsonencode (struct ('a', {}), 'PerElement', true), cell (0, 0));
+%! assert (jsonencode ({}, 'PerElement', false), '[]');
+%! fail ("jsonencode ([1, 2], 'PerElement', true)", ...
+%!       "'PerElement' requires a cell or struct array");
+%! fail ("jsonencode ({1}, 'PerElement', true, 'Format', 'cbor')", ...
+%!       "'PerElement' requires 'Format'");
+
+*/
+
+// PKG_ADD: autoload ("jsonencodefile", "jsonencode.oct");
+// PKG_DEL: autoload ("jsonencodefile", which ("jsonencode"), "remove");
+
+DEFUN_DLD (jsonencodefile, args, ,
+           "-*- texinfo -*-\n\
+@deftypefn  {} {} jsonencodefile (@var{object}, @var{filename})              \n\
+@deftypefnx {} {} jsonencodefile (@dots{}, @var{option}, @var{value}, @dots{}) \n\
+                                                                             \n\
+Encode Octave data types into JSON text and write it to the file            \n\
+@var{filename}.                                                              \n\
+                                                                             \n\
+If @var{filename} ends with @file{.gz} or @file{.zst}, the text is          \n\
+compressed with gzip or zstd.  The text is compressed and written while it  \n\
+is encoded, the whole text is never held in memory.  Read the file with     \n\
+@code{jsondecodefile}.  zstd is only supported if the package has been       \n\
+built with it.                                                               \n\
+                                                                             \n\
+The options are the same as for @code{jsonencode}, except                   \n\
+@qcode{\"PerElement\"}, @qcode{\"ASCII\"}, and @qcode{\"Format\"}, which are \n\
+not supported.                                                               \n\
+                                                                             \n\
+Example:                                                                     \n\
+                                                                             \n\
+@example                                                                     \n\
+@group                                                                       \n\
+jsonencodefile (struct (\"a\", 1:3), \"data.json.gz\");                       \n\
+jsondecodefile (\"data.json.gz\")                                            \n\
+    @result{} ans = scalar structure containing the fields:                  \n\
+         a =                                                                 \n\
+            1                                                                \n\
+            2                                                                \n\
+            3                                                                \n\
+@end group                                                                   \n\
+@end example                                                                 \n\
+                                                                             \n\
+@seealso{jsonencode, jsondecodefile}                                         \n\
+@end deftypefn")
+{
+#if defined (HAVE_RAPIDJSON)
+
+  int nargin = args.length ();
+  // Options are pairs, the number of arguments must be even.
+  if (nargin < 2 || nargin % 2)
+    print_usage ();
 
+  std::string filename = octave::sys::file_ops::tilde_expand
+    (args(1).xstring_value ("jsonencodefile: FILENAME must be a character "
+                            "string"));
+
+  jsonencode_settings settings (args, 2);
+  if (settings.per_element || settings.ascii || settings.format != "json")
+    error ("jsonencodefile: the 'PerElement', 'ASCII', and 'Format' options "
+           "are not supported");
+
+  json_file_writer file (filename, compression_by_extension (filename));
+  if (! file.error ().empty ())
+    error ("jsonencodefile: %s", file.error ().c_str ());
+
+  if (settings.pretty_print)
+    {
+# if defined (HAVE_RAPIDJSON_PRETTYWRITER)
+      rapidjson::PrettyWriter<json_file_writer, rapidjson::UTF8<>,
+                              rapidjson::UTF8<>, rapidjson::CrtAllocator,
+                              rapidjson::kWriteNanAndInfFlag> writer (file);
+      writer.SetIndent (' ', 2);
+      encode (writer, args(0), settings.options ());
+# endif
+    }
+  else
+    {
+      rapidjson::Writer<json_file_writer, rapidjson::UTF8<>,
+                        rapidjson::UTF8<>, rapidjson::CrtAllocator,
+                        rapidjson::kWriteNanAndInfFlag> writer (file);
+      encode (writer, args(0), settings.options ());
+    }
+
+  if (! file.close ())
+    error ("jsonencodefile: %s", file.error ().c_str ());
+
+  return ovl ();
+
+#else
+
+  octave_unused_parameter (args);
+
+  err_disabled_feature ("jsonencodefile", "JSON encoding through RapidJSON");
+
+#endif
+}
+
+/*
+%!test
+%! data = struct ('a', {1, 'x'}, 'b', {[1, 2; 3, 4], {true, NaN}});
+%! fname = tempname ();
+%! unwind_protect
+%!   ## zstd is optional, see the Makefile.
+%!   exts = {'.json', '.json.gz', '.json.zst'};
+%!   try
+%!     jsonencodefile (1, [fname, '.json.zst']);
+%!   catch err
+%!     assert (err.message, ['jsonencodefile: zstd support not compiled ', ...
+%!                           'in, unable to write ''', fname, '.json.zst''']);
+%!     assert (! exist ([fname, '.json.zst'], 'file'));
+%!     exts(end) = [];
+%!   end_try_catch
+%!   for ext = exts
+%!     jsonencodefile (data, [fname, ext{1}]);
+%!     assert (jsondecodefile ([fname, ext{1}]), jsondecode (jsonencode (data)));
+%!   endfor
+%!   assert (fileread ([fname, '.json']), jsonencode (data));
+%!   fid = fopen ([fname, '.json.gz'], 'r');
+%!   assert (fread (fid, 2)', [31, 139]);
+%!   fclose (fid);
+%!   if (numel (exts) == 3)
+%!     fid = fopen ([fname, '.json.zst'], 'r');
+%!     assert (fread (fid, 4)', [40, 181, 47, 253]);
+%!     fclose (fid);
+%!   endif
+%!   jsonencodefile ([1, NaN], [fname, '.json'], 'ConvertInfAndNaN', false);
+%!   assert (fileread ([fname, '.json']), '[1,NaN]');
+%!   jsonencodefile ([true; false], [fname, '.json'], 'PrettyPrint', true);
+%!   assert (fileread ([fname, '.json']), jsonencode ([true; false], 'PrettyPrint', true));
+%! unwind_protect_cleanup
+%!   for ext = {'.json', '.json.gz', '.json.zst'}
+%!     if (exist ([fname, ext{1}], 'file'))
+%!       delete ([fname, ext{1}]);
+%!     endif
+%!   endfor
+%! end_unwind_protect
+
+%!test
+%! fail ("jsonencodefile (1)");
+%! fail ("jsonencodefile (1, 2)", "FILENAME must be a character string");
+%! fail ("jsonencodefile (1, 'x.json', 'ASCII', true)", "not supported");
+%! fail ("jsonencodefile (1, 'x.json', 'Format', 'cbor')", "not supported");
+%! fail ("jsonencodefile (1, fullfile (tempname (), 'x.json'))", ...
+%!       "unable to open file");
+*/
+
+// PKG_ADD: autoload ("jsonencode_async", "jsonencode.oct");
+// PKG_DEL: autoload ("jsonencode_async", which ("jsonencode"), "remove");
+
+DEFMETHOD_DLD (jsonencode_async, interp, args, ,
+               "-*- texinfo -*-\n\
+@deftypefn  {} {@var{f} =} jsonencode_async (@var{object})                   \n\
+@deftypefnx {} {@var{f} =} jsonencode_async (@var{object}, \"ToFile\", @var{filename}) \n\
+@deftypefnx {} {@var{f} =} jsonencode_async (@dots{}, @var{option}, @var{value}, @dots{}) \n\
+                                                                             \n\
+Start encoding Octave data types in a background thread.                     \n\
+                                                                             \n\
+@var{object} is recorded into plain numbers and strings in the calling       \n\
+thread, which is the only part that reads Octave values.  Errors about       \n\
+unsupported types are reported here.  The function then returns              \n\
+immediately.  Formatting the numbers, escaping the strings, and writing      \n\
+the output run concurrently with the following Octave code.  With the        \n\
+option @qcode{\"ToFile\"}, the output is written to the file                   \n\
+@var{filename} in the background thread as well, compressed as for           \n\
+@code{jsonencodefile}.                                                       \n\
+                                                                             \n\
+@code{jsonencode_isready (@var{f})} tells whether the background work is     \n\
+finished, @code{jsonencode_fetch (@var{f})} waits for it and returns the     \n\
+output.  Errors, e.g. a file that cannot be written, are reported by         \n\
+@code{jsonencode_fetch}.                                                     \n\
+                                                                             \n\
+The other options are the same as for @code{jsonencode}.  The option         \n\
+@qcode{\"PerElement\"} is not supported.  With @qcode{\"ToFile\"}, the           \n\
+options @qcode{\"ASCII\"} and @qcode{\"Format\"} are not supported               \n\
+either.                                                                      \n\
+                                                                             \n\
+Example:                                                                     \n\
+                                                                             \n\
+@example                                                                     \n\
+@group                                                                       \n\
+f = jsonencode_async (struct (\"a\", 1:3));                                    \n\
+## @dots{} other work @dots{}                                                \n\
+jsonencode_fetch (f)                                                         \n\
+    @result{} @{\"a\":[1,2,3]@}                                                \n\
+@end group                                                                   \n\
+@end example                                                                 \n\
+                                                                             \n\
+@seealso{jsonencode_isready, jsonencode_fetch, jsonencode, jsonencodefile}   \n\
+@end deftypefn")
+{
+#if defined (HAVE_RAPIDJSON)
+
+  int nargin = args.length ();
+
+  // Options are pairs, the number of arguments must be odd.
+  if (! (nargin % 2))
+    print_usage ();
+
+  // "ToFile" is handled here, the other options by jsonencode_settings.
+  std::string filename;
+  octave_value_list options;
+  for (int i = 1; i < nargin; i += 2)
+    {
+      if (args(i).is_string ()
+          && octave::string::strcmpi (args(i).string_value (), "ToFile"))
+        {
+          filename = octave::sys::file_ops::tilde_expand
+            (args(i + 1).xstring_value ("jsonencode_async: 'ToFile' value "
+                                        "must be a character string"));
+          if (filename.empty ())
+            error ("jsonencode_async: 'ToFile' value must not be empty");
+        }
+      else
+        options.append (args.slice (i, 2));
+    }
+
+  jsonencode_settings settings (options, 0);
+  if (settings.per_element)
+    error ("jsonencode_async: the 'PerElement' option is not supported");
+  if (! filename.empty () && (settings.ascii || settings.format != "json"))
+    error ("jsonencode_async: the 'ASCII' and 'Format' options are not "
+           "supported with 'ToFile'");
+
+  encode_snapshot snapshot (settings.format);
+  encode (snapshot, args(0), settings.options ());
+
+  register_type_once<octave_json_encode_future> (interp);
+
+  return octave_value (new octave_json_encode_future
+                         (settings, std::move (snapshot),
+                          std::move (filename)));
+
+#else
+
+  octave_unused_parameter (interp);
+  octave_unused_parameter (args);
+
+  err_disabled_feature ("jsonencode_async", "JSON encoding through RapidJSON");
+
+#endif
+}
+
+/*
+%!test
+%! data = struct ('a', {1, 'x'}, 'b', {[1, 2; 3, 4], {true, NaN, 1e10}});
+%! f = jsonencode_async (data);
+%! assert (class (f), 'json_encode_future');
+%! assert (jsonencode_fetch (f), jsonencode (data));
+%! assert (jsonencode_isready (f));
+%! assert (jsonencode_fetch (f), jsonencode (data));
+
+%!test
+%! data = {[1.5, NaN; -Inf, 4], 'str', {}, struct(), int8([1, 2]), true};
+%! for opts = {{}, {'ConvertInfAndNaN', false}, {'PrettyPrint', true}, ...
+%!             {'NumericEncoding', 'base64'}, {'Format', 'cbor'}, ...
+%!             {'Format', 'msgpack'}, {'Format', 'cbor', 'ConvertInfAndNaN', false}}
+%!   f = jsonencode_async (data, opts{1}{:});
+%!   while (! jsonencode_isready (f))
+%!     pause (0.01);
+%!   endwhile
+%!   assert (jsonencode_fetch (f), jsonencode (data, opts{1}{:}));
+%! endfor
+%! x = (1:100000) / 7;
+%! assert (jsonencode_fetch (jsonencode_async (x, 'Format', 'cbor')), ...
+%!         jsonencode (x, 'Format', 'cbor'));
+%! assert (jsonencode_fetch (jsonencode_async (char ([195, 169]), 'ASCII', true)), ...
+%!         '"\u00E9"');
+%! s = struct ('id', int32 ([1; 2]), 'name', ['ab'; 'cd']);
+%! assert (jsonencode_fetch (jsonencode_async (s, 'Rows', true)), ...
+%!         jsonencode (s, 'Rows', true));
+
+%!test
+%! data = struct ('a', {1, 'x'}, 'b', {[1, 2; 3, 4], {true, NaN}});
+%! fname = tempname ();
+%! unwind_protect
+%!   for ext = {'.json', '.json.gz'}
+%!     f = jsonencode_async (data, 'ToFile', [fname, ext{1}]);
+%!     assert (jsonencode_fetch (f), []);
+%!     assert (jsondecodefile ([fname, ext{1}]), jsondecode (jsonencode (data)));
+%!   endfor
+%!   assert (fileread ([fname, '.json']), jsonencode (data));
+%!   f = jsonencode_async (data, 'ToFile', [fname, '.json'], 'PrettyPrint', true);
+%!   jsonencode_fetch (f);
+%!   assert (fileread ([fname, '.json']), jsonencode (data, 'PrettyPrint', true));
+%! unwind_protect_cleanup
+%!   for ext = {'.json', '.json.gz'}
+%!     if (exist ([fname, ext{1}], 'file'))
+%!       delete ([fname, ext{1}]);
+%!     endif
+%!   endfor
+%! end_unwind_protect
+
+%!test
+%! f = jsonencode_async (char ([34, 255]), 'ASCII', true);
+%! fail ("jsonencode_fetch (f)", "strings must be valid UTF-8 for 'ASCII'");
+%! f = jsonencode_async (1, 'ToFile', fullfile (tempname (), 'x.json'));
+%! fail ("jsonencode_fetch (f)", "unable to open file");
+%! fail ("jsonencode_fetch (f)", "unable to open file");
+
+%!test
+%! fail ("jsonencode_async ()");
+%! fail ("jsonencode_async (1, 'ToFile')");
+%! fail ("jsonencode_async (1, 'ToFile', 2)", "'ToFile' value must be a character string");
+%! fail ("jsonencode_async ({1}, 'PerElement', true)", "'PerElement' option is not supported");
+%! fail ("jsonencode_async (1, 'ToFile', 'x.json', 'Format', 'cbor')", "not supported with 'ToFile'");
+%! fail ("jsonencode_async (1i)", "unsupported type");
+*/
+
+// PKG_ADD: autoload ("jsonencode_isready", "jsonencode.oct");
+// PKG_DEL: autoload ("jsonencode_isready", which ("jsonencode"), "remove");
+
+DEFUN_DLD (jsonencode_isready, args, ,
+           "-*- texinfo -*-\n\
+@deftypefn {} {@var{tf} =} jsonencode_isready (@var{f})                      \n\
+                                                                             \n\
+Return true if the background encoding of @var{f} is finished.               \n\
+                                                                             \n\
+@var{f} is returned by @code{jsonencode_async}.  If @var{tf} is true,        \n\
+@code{jsonencode_fetch (@var{f})} does not wait.                             \n\
+                                                                             \n\
+@seealso{jsonencode_async, jsonencode_fetch}                                 \n\
+@end deftypefn")
+{
+#if defined (HAVE_RAPIDJSON)
+
+  if (args.length () != 1)
+    print_usage ();
+
+  if (args(0).type_id () != octave_json_encode_future::static_type_id ())
+    error ("jsonencode_isready: F must be returned by jsonencode_async");
+
+  const octave_json_encode_future& f
+    = dynamic_cast<const octave_json_encode_future&> (args(0).get_rep ());
+
+  return ovl (f.task ().ready ());
+
+#else
+
+  octave_unused_parameter (args);
+
+  err_disabled_feature ("jsonencode_isready",
+                        "JSON encoding through RapidJSON");
+
+#endif
+}
+
+/*
+%!test
+%! fail ("jsonencode_isready ()");
+%! fail ("jsonencode_isready (1)", "F must be returned by jsonencode_async");
+*/
+
+// PKG_ADD: autoload ("jsonencode_fetch", "jsonencode.oct");
+// PKG_DEL: autoload ("jsonencode_fetch", which ("jsonencode"), "remove");
+
+DEFUN_DLD (jsonencode_fetch, args, ,
+           "-*- texinfo -*-\n\
+@deftypefn {} {@var{JSON_txt} =} jsonencode_fetch (@var{f})                  \n\
+                                                                             \n\
+Wait for the background encoding of @var{f} and return its output.           \n\
+                                                                             \n\
+@var{f} is returned by @code{jsonencode_async}.  The output is a             \n\
+character string of JSON text, or a @code{uint8} array for the binary        \n\
+formats.  It is empty if it has been written to a file.  Errors of           \n\
+formatting or writing the output are reported here.  Further calls return    \n\
+the output again.                                                            \n\
+                                                                             \n\
+@seealso{jsonencode_async, jsonencode_isready}                               \n\
+@end deftypefn")
+{
+#if defined (HAVE_RAPIDJSON)
+
+  if (args.length () != 1)
+    print_usage ();
+
+  if (args(0).type_id () != octave_json_encode_future::static_type_id ())
+    error ("jsonencode_fetch: F must be returned by jsonencode_async");
+
+  const octave_json_encode_future& f
+    = dynamic_cast<const octave_json_encode_future&> (args(0).get_rep ());
+
+  return ovl (f.task ().fetch ());
+
+#else
+
+  octave_unused_parameter (args);
+
+  err_disabled_feature ("jsonencode_fetch",
+                        "JSON encoding through RapidJSON");
+
+#endif
+}
+
+/*
+%!test
+%! fail ("jsonencode_fetch ()");
+%! fail ("jsonencode_fetch (1)", "F must be returned by jsonencode_async");
 */
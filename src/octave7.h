@@ -135,21 +135,24 @@ namespace octave
         const std::string permitted_chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
                                             "abcdefghijklmnopqrstuvwxyz"
                                             "_0123456789";
-        // Get the first non-permitted char.
-        size_t pos = str.find_first_not_of (permitted_chars);
         // Buffer for hex string "0xFF" (+1 for null terminator).
         char hex_str[5];
-        // Repeat until end of string.
-        while (pos != std::string::npos)
+        // Build the result in one pass, replacing in place would take
+        // quadratic time for long names.
+        std::string retval;
+        retval.reserve (str.size ());
+        for (char c : str)
           {
-            // Replace non-permitted char by it's hex value.
-            std::snprintf (hex_str, sizeof (hex_str), "0x%02X", str[pos]);
-            str.replace (pos, 1, hex_str);
-            // Get the next occurrence from the last position.
-            // (-1 for null terminator)
-            pos = str.find_first_not_of (permitted_chars,
-                                         pos + sizeof (hex_str) - 1);
+            if (permitted_chars.find (c) != std::string::npos)
+              retval += c;
+            else
+              {
+                // Replace non-permitted char by it's hex value.
+                std::snprintf (hex_str, sizeof (hex_str), "0x%02X", c);
+                retval += hex_str;
+              }
           }
+        str = std::move (retval);
       }
 
     return true;